@@ -0,0 +1,105 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_ACTUATOR_HEALTH_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_ACTUATOR_HEALTH_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+
+#include <layered_hardware_dynamixel/common_namespaces.hpp>
+#include <layered_hardware_dynamixel/dynamixel_actuator_data.hpp>
+#include <layered_hardware_dynamixel/error_log.hpp>
+#include <ros/duration.h>
+#include <ros/time.h>
+
+namespace layered_hardware_dynamixel {
+
+// judges the health of an actuator by failed transactions in each cycle.
+// after the max number of consecutive failed cycles, the actuator is taken offline
+// so that the bus stops operating it, then it is pinged with exponential backoff
+// until it responds again.
+class ActuatorHealth {
+public:
+  ActuatorHealth() : data_(NULL), max_failures_(0), last_n_errors_(0) {}
+
+  virtual ~ActuatorHealth() {}
+
+  void init(DynamixelActuatorData *const data, const int max_failures,
+            const ros::Duration &ping_interval, const ros::Duration &max_ping_interval) {
+    data_ = data;
+    max_failures_ = max_failures;
+    min_ping_interval_ = ping_interval;
+    max_ping_interval_ = max_ping_interval;
+    last_n_errors_ = data_->n_errors;
+  }
+
+  // returns true if the actuator should be operated in the present cycle.
+  // pings the offline actuator if the ping is due.
+  bool poll(const ros::Time &time) {
+    if (!data_->is_offline) {
+      return true;
+    }
+    if (time < next_ping_time_) {
+      return false;
+    }
+    if (!data_->dxl_wb->ping(data_->id)) {
+      // back off
+      ping_interval_ = std::min(ping_interval_ * 2., max_ping_interval_);
+      next_ping_time_ = time + ping_interval_;
+      return false;
+    }
+    ErrorLog::report(data_->error_log,
+                     ErrorEntry("ActuatorHealth::poll", "Responded to a health ping again", NULL,
+                                data_->name.c_str(), data_->id, -1, NULL));
+    data_->is_offline = false;
+    data_->is_available = true;
+    data_->health_status = HEALTH_OK;
+    data_->consecutive_failures = 0;
+    last_n_errors_ = data_->n_errors;
+    return true;
+  }
+
+  // judge the present cycle by failed transactions since the last call
+  void update(const ros::Time &time) {
+    if (data_->is_offline) {
+      return;
+    }
+    const bool has_failed(data_->n_errors != last_n_errors_);
+    last_n_errors_ = data_->n_errors;
+    if (!has_failed) {
+      data_->consecutive_failures = 0;
+      data_->health_status = HEALTH_OK;
+      return;
+    }
+    ++data_->consecutive_failures;
+    data_->health_status = HEALTH_FAILING;
+    // the reboot mode manages availability by itself while rebooting
+    if (data_->consecutive_failures < max_failures_ || data_->reboot_status == REBOOTING) {
+      return;
+    }
+    ErrorLog::report(data_->error_log,
+                     ErrorEntry("ActuatorHealth::update",
+                                "Taken offline after consecutive failed cycles", NULL,
+                                data_->name.c_str(), data_->id, -1, NULL));
+    data_->is_offline = true;
+    data_->is_available = false;
+    data_->has_prefetched_states = false;
+    // the actuator may be power-cycled before it is back
+    data_->forgetControlTable();
+    data_->health_status = HEALTH_OFFLINE;
+    ping_interval_ = min_ping_interval_;
+    next_ping_time_ = time + ping_interval_;
+  }
+
+private:
+  DynamixelActuatorData *data_;
+  int max_failures_;
+  ros::Duration min_ping_interval_, max_ping_interval_, ping_interval_;
+  ros::Time next_ping_time_;
+  std::uint32_t last_n_errors_;
+};
+
+typedef std::shared_ptr< ActuatorHealth > ActuatorHealthPtr;
+typedef std::shared_ptr< const ActuatorHealth > ActuatorHealthConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_BUS_BACKEND_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_BUS_BACKEND_HPP
+
+#include <cstdint>
+#include <memory>
+
+#include <dynamixel_workbench_toolbox/dynamixel_workbench.h>
+
+namespace layered_hardware_dynamixel {
+
+// instructions & model lookups on a bus which actuators, operating modes & group I/O rely on.
+// signatures follow DynamixelWorkbench so that the real bus simply forwards them
+// (WorkbenchBackend) and a simulated bus can replace it (SimulatedBackend).
+// functions return false on failure with the reason in *log if log is not NULL.
+class BusBackend {
+public:
+  virtual ~BusBackend() {}
+
+  //
+  // the link & models
+  //
+
+  virtual bool init(const char *device_name, std::uint32_t baud_rate, const char **log = NULL) = 0;
+
+  virtual float getProtocolVersion() = 0;
+
+  // NULL if the model of the actuator is unknown (i.e. never pinged)
+  virtual const char *getModelName(std::uint8_t id, const char **log = NULL) = 0;
+
+  // the model number answered by the last ping, or 0 if never pinged
+  virtual std::uint16_t getModelNumber(std::uint8_t id, const char **log = NULL) = 0;
+
+  virtual const ControlItem *getItemInfo(std::uint8_t id, const char *item_name,
+                                         const char **log = NULL) = 0;
+
+  virtual const ModelInfo *getModelInfo(std::uint8_t id, const char **log = NULL) = 0;
+
+  //
+  // unit conversions by the model
+  //
+
+  virtual std::int32_t convertRadian2Value(std::uint8_t id, float radian) = 0;
+
+  virtual float convertValue2Radian(std::uint8_t id, std::int32_t value) = 0;
+
+  virtual std::int32_t convertVelocity2Value(std::uint8_t id, float velocity) = 0;
+
+  virtual float convertValue2Velocity(std::uint8_t id, std::int32_t value) = 0;
+
+  // current in mA
+  virtual std::int16_t convertCurrent2Value(std::uint8_t id, float current) = 0;
+
+  virtual float convertValue2Current(std::uint8_t id, std::int16_t value) = 0;
+
+  //
+  // instructions to an actuator
+  //
+
+  virtual bool ping(std::uint8_t id, std::uint16_t *get_model_number, const char **log = NULL) = 0;
+
+  virtual bool ping(std::uint8_t id, const char **log = NULL) = 0;
+
+  // find actuators with ids up to range, and learn their models as ping() does.
+  // DynamixelWorkbench sends one broadcast ping on Protocol 2.0.
+  virtual bool scan(std::uint8_t *get_id, std::uint8_t *get_the_number_of_id,
+                    std::uint8_t range = 253, const char **log = NULL) = 0;
+
+  virtual bool reboot(std::uint8_t id, const char **log = NULL) = 0;
+
+  virtual bool clearMultiTurn(std::uint8_t id, const char **log = NULL) = 0;
+
+  // read a block of up to 4 bytes as one little endian value
+  virtual bool readRegister(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                            std::uint32_t *data, const char **log = NULL) = 0;
+
+  virtual bool readRegister(std::uint8_t id, const char *item_name, std::int32_t *data,
+                            const char **log = NULL) = 0;
+
+  virtual bool writeRegister(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                             std::uint8_t *data, const char **log = NULL) = 0;
+
+  virtual bool itemRead(std::uint8_t id, const char *item_name, std::int32_t *data,
+                        const char **log = NULL) = 0;
+
+  virtual bool itemWrite(std::uint8_t id, const char *item_name, std::int32_t data,
+                         const char **log = NULL) = 0;
+
+  virtual bool torqueOn(std::uint8_t id, const char **log = NULL) = 0;
+
+  virtual bool torqueOff(std::uint8_t id, const char **log = NULL) = 0;
+
+  virtual bool setCurrentControlMode(std::uint8_t id, const char **log = NULL) = 0;
+
+  virtual bool setVelocityControlMode(std::uint8_t id, const char **log = NULL) = 0;
+
+  virtual bool setPositionControlMode(std::uint8_t id, const char **log = NULL) = 0;
+
+  virtual bool setExtendedPositionControlMode(std::uint8_t id, const char **log = NULL) = 0;
+
+  virtual bool setCurrentBasedPositionControlMode(std::uint8_t id, const char **log = NULL) = 0;
+
+  virtual bool setPWMControlMode(std::uint8_t id, const char **log = NULL) = 0;
+
+  //
+  // group instructions
+  //
+
+  virtual std::uint8_t getTheNumberOfSyncWriteHandler() = 0;
+
+  virtual bool addSyncWriteHandler(std::uint16_t address, std::uint16_t length,
+                                   const char **log = NULL) = 0;
+
+  // each value in data is written as little endian bytes of the handler's length
+  virtual bool syncWrite(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                         std::int32_t *data, std::uint8_t data_num_for_each_id,
+                         const char **log = NULL) = 0;
+
+  virtual std::uint8_t getTheNumberOfSyncReadHandler() = 0;
+
+  virtual bool addSyncReadHandler(std::uint16_t address, std::uint16_t length,
+                                  const char **log = NULL) = 0;
+
+  virtual bool syncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                        const char **log = NULL) = 0;
+
+  // Fast Sync Read with the same handler & received data as SyncRead (optional)
+  virtual bool supportsFastSyncRead() { return false; }
+
+  virtual bool fastSyncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                            const char **log = NULL) {
+    if (log) {
+      *log = "[BusBackend] Fast Sync Read is not supported by the backend";
+    }
+    return false;
+  }
+
+  // SyncRead in two phases (optional). begin*() sends the instruction and returns immediately,
+  // and finishSyncRead() receives the status packets into the handler as syncRead() does.
+  // the caller may do other work meanwhile but must not send any other instruction.
+  virtual bool supportsSplitSyncRead() { return false; }
+
+  virtual bool beginSyncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                             const char **log = NULL) {
+    if (log) {
+      *log = "[BusBackend] Split SyncRead is not supported by the backend";
+    }
+    return false;
+  }
+
+  virtual bool beginFastSyncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                                 const char **log = NULL) {
+    if (log) {
+      *log = "[BusBackend] Split SyncRead is not supported by the backend";
+    }
+    return false;
+  }
+
+  virtual bool finishSyncRead(std::uint8_t index, const char **log = NULL) {
+    if (log) {
+      *log = "[BusBackend] Split SyncRead is not supported by the backend";
+    }
+    return false;
+  }
+
+  virtual bool getSyncReadData(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                               std::uint16_t address, std::uint16_t length, std::int32_t *data,
+                               const char **log = NULL) = 0;
+
+  virtual bool initBulkRead(const char **log = NULL) = 0;
+
+  virtual bool addBulkReadParam(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                                const char **log = NULL) = 0;
+
+  virtual bool bulkRead(const char **log = NULL) = 0;
+
+  virtual bool getBulkReadData(std::uint8_t *id, std::uint8_t id_num, std::uint16_t *address,
+                               std::uint16_t *length, std::int32_t *data,
+                               const char **log = NULL) = 0;
+
+  virtual bool clearBulkReadParam() = 0;
+
+  virtual bool initBulkWrite(const char **log = NULL) = 0;
+
+  virtual bool addBulkWriteParam(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                                 std::int32_t data, const char **log = NULL) = 0;
+
+  virtual bool bulkWrite(const char **log = NULL) = 0;
+};
+
+typedef std::shared_ptr< BusBackend > BusBackendPtr;
+typedef std::shared_ptr< const BusBackend > BusBackendConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
@@ -0,0 +1,462 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_BUS_LOG_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_BUS_LOG_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ros/console.h>
+
+namespace layered_hardware_dynamixel {
+
+//
+// binary log of bus traffic, which RecordingBackend writes and ReplayBackend reads.
+// the file is a header followed by records in the order of calls to the backend:
+//   header: magic "LHDXBUS1" (8 bytes), start of the recording in ns since the unix epoch (u64)
+//   record: time in ns since the start (u64, monotonic), duration of the call in ns (u32),
+//           op (u8), flags (u8), input length (u16), output length (u16),
+//           then the input & output payloads
+// the input payload holds the arguments of the call (e.g. id, address & data of an instruction)
+// and the output payload holds its results (e.g. received data of a status packet),
+// or the log string of the backend if the call failed.
+// all values are in the native byte order.
+//
+
+// calls to BusBackend
+enum BusLogOp {
+  BUS_LOG_INIT = 1,
+  BUS_LOG_GET_PROTOCOL_VERSION,
+  BUS_LOG_GET_MODEL_NAME,
+  BUS_LOG_GET_ITEM_INFO,
+  BUS_LOG_GET_MODEL_INFO,
+  BUS_LOG_CONVERT_RADIAN_TO_VALUE,
+  BUS_LOG_CONVERT_VALUE_TO_RADIAN,
+  BUS_LOG_CONVERT_VELOCITY_TO_VALUE,
+  BUS_LOG_CONVERT_VALUE_TO_VELOCITY,
+  BUS_LOG_CONVERT_CURRENT_TO_VALUE,
+  BUS_LOG_CONVERT_VALUE_TO_CURRENT,
+  BUS_LOG_PING,
+  BUS_LOG_REBOOT,
+  BUS_LOG_CLEAR_MULTI_TURN,
+  BUS_LOG_READ_REGISTER,
+  BUS_LOG_READ_ITEM_REGISTER,
+  BUS_LOG_WRITE_REGISTER,
+  BUS_LOG_ITEM_READ,
+  BUS_LOG_ITEM_WRITE,
+  BUS_LOG_TORQUE_ON,
+  BUS_LOG_TORQUE_OFF,
+  BUS_LOG_SET_CURRENT_CONTROL_MODE,
+  BUS_LOG_SET_VELOCITY_CONTROL_MODE,
+  BUS_LOG_SET_POSITION_CONTROL_MODE,
+  BUS_LOG_SET_EXTENDED_POSITION_CONTROL_MODE,
+  BUS_LOG_SET_CURRENT_BASED_POSITION_CONTROL_MODE,
+  BUS_LOG_SET_PWM_CONTROL_MODE,
+  BUS_LOG_GET_NUMBER_OF_SYNC_WRITE_HANDLERS,
+  BUS_LOG_ADD_SYNC_WRITE_HANDLER,
+  BUS_LOG_SYNC_WRITE,
+  BUS_LOG_GET_NUMBER_OF_SYNC_READ_HANDLERS,
+  BUS_LOG_ADD_SYNC_READ_HANDLER,
+  BUS_LOG_SYNC_READ,
+  BUS_LOG_SUPPORTS_FAST_SYNC_READ,
+  BUS_LOG_FAST_SYNC_READ,
+  BUS_LOG_GET_SYNC_READ_DATA,
+  BUS_LOG_INIT_BULK_READ,
+  BUS_LOG_ADD_BULK_READ_PARAM,
+  BUS_LOG_BULK_READ,
+  BUS_LOG_GET_BULK_READ_DATA,
+  BUS_LOG_CLEAR_BULK_READ_PARAM,
+  BUS_LOG_INIT_BULK_WRITE,
+  BUS_LOG_ADD_BULK_WRITE_PARAM,
+  BUS_LOG_BULK_WRITE,
+  BUS_LOG_SUPPORTS_SPLIT_SYNC_READ,
+  BUS_LOG_BEGIN_SYNC_READ,
+  BUS_LOG_BEGIN_FAST_SYNC_READ,
+  BUS_LOG_FINISH_SYNC_READ,
+  BUS_LOG_SCAN,
+  BUS_LOG_GET_MODEL_NUMBER,
+  // records were dropped before this because the buffer was full. the input is the number.
+  BUS_LOG_DROPPED = 255
+};
+
+// flags of a record
+enum BusLogFlag {
+  // the call succeeded (or returned a value)
+  BUS_LOG_SUCCEEDED = 0x1,
+  // the payload did not fit in the record and was cut
+  BUS_LOG_TRUNCATED = 0x2
+};
+
+// a record with the fixed-size payload so that recording never allocates memory
+struct BusLogRecord {
+  BusLogRecord(const std::uint8_t _op = 0) { clear(_op); }
+
+  void clear(const std::uint8_t _op) {
+    time = 0;
+    duration = 0;
+    op = _op;
+    flags = 0;
+    input_length = output_length = 0;
+    is_output = false;
+    n_dropped_before = 0;
+  }
+
+  //
+  // payload construction. values are appended to the input until endInput(),
+  // and to the output after it.
+  //
+
+  template < typename T > void put(const T &value) { putBytes(&value, sizeof(T)); }
+
+  void putBytes(const void *const bytes, const std::size_t length) {
+    const std::size_t pos(input_length + output_length);
+    if (pos + length > PAYLOAD_LENGTH) {
+      flags |= BUS_LOG_TRUNCATED;
+      return;
+    }
+    std::memcpy(payload + pos, bytes, length);
+    (is_output ? output_length : input_length) += length;
+  }
+
+  // a string with the prefixed length, or the empty one if NULL
+  void putString(const char *const str) {
+    const std::uint16_t length(str ? std::strlen(str) : 0);
+    put(length);
+    putBytes(str, length);
+  }
+
+  void endInput() { is_output = true; }
+
+  void setSucceeded(const bool succeeded) {
+    flags = succeeded ? (flags | BUS_LOG_SUCCEEDED) : (flags & ~BUS_LOG_SUCCEEDED);
+  }
+
+  bool hasSucceeded() const { return flags & BUS_LOG_SUCCEEDED; }
+
+  static const std::size_t HEADER_LENGTH = 18;
+  static const std::size_t PAYLOAD_LENGTH = 1024;
+
+  std::uint64_t time;
+  std::uint32_t duration;
+  std::uint8_t op, flags;
+  std::uint16_t input_length, output_length;
+  std::uint8_t payload[PAYLOAD_LENGTH];
+  // not in the file. true while constructing the output,
+  // and the number of records dropped just before this.
+  bool is_output;
+  std::uint64_t n_dropped_before;
+};
+
+// sequential decoder of a payload
+class BusLogReader {
+public:
+  BusLogReader() : data_(NULL), length_(0), pos_(0) {}
+
+  BusLogReader(const std::uint8_t *const data, const std::size_t length)
+      : data_(data), length_(length), pos_(0) {}
+
+  template < typename T > bool get(T *const value) { return getBytes(value, sizeof(T)); }
+
+  bool getBytes(void *const bytes, const std::size_t length) {
+    if (pos_ + length > length_) {
+      return false;
+    }
+    std::memcpy(bytes, data_ + pos_, length);
+    pos_ += length;
+    return true;
+  }
+
+  bool getString(std::string *const str) {
+    std::uint16_t length;
+    if (!get(&length) || pos_ + length > length_) {
+      return false;
+    }
+    str->assign(reinterpret_cast< const char * >(data_ + pos_), length);
+    pos_ += length;
+    return true;
+  }
+
+private:
+  const std::uint8_t *data_;
+  std::size_t length_, pos_;
+};
+
+// the recording side. records are taken & committed by the thread calling the backend
+// (one at a time), and appended to the file by a background thread,
+// so that calls on bus cycles never do file I/O. records are dropped if the buffer is full.
+class BusLogWriter {
+public:
+  BusLogWriter(const std::size_t capacity = 4096)
+      : slots_(roundUpToPowerOf2(capacity)), mask_(slots_.size() - 1), push_pos_(0),
+        pop_pos_(0), n_dropped_(0), file_(NULL), is_stopping_(false) {}
+
+  virtual ~BusLogWriter() { stop(); }
+
+  bool open(const std::string &path) {
+    stop();
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_) {
+      ROS_ERROR_STREAM("BusLogWriter::open(): Failed to open '" << path << "' to write");
+      return false;
+    }
+    start_ = std::chrono::steady_clock::now();
+    const std::uint64_t wall_start(std::chrono::duration_cast< std::chrono::nanoseconds >(
+                                       std::chrono::system_clock::now().time_since_epoch())
+                                       .count());
+    if (std::fwrite(magic(), 1, MAGIC_LENGTH, file_) != MAGIC_LENGTH ||
+        std::fwrite(&wall_start, sizeof(wall_start), 1, file_) != 1) {
+      ROS_ERROR_STREAM("BusLogWriter::open(): Failed to write the header to '" << path << "'");
+      std::fclose(file_);
+      file_ = NULL;
+      return false;
+    }
+    return true;
+  }
+
+  //
+  // recording side
+  //
+
+  // the next free record. if the buffer is full, the scratch record which is never committed.
+  BusLogRecord *take(const std::uint8_t op) {
+    const std::size_t pos(push_pos_.load(std::memory_order_relaxed));
+    if (pos - pop_pos_.load(std::memory_order_acquire) >= slots_.size()) {
+      n_dropped_.fetch_add(1, std::memory_order_relaxed);
+      scratch_.clear(op);
+      return &scratch_;
+    }
+    BusLogRecord &record(slots_[pos & mask_]);
+    record.clear(op);
+    record.n_dropped_before = n_dropped_.exchange(0, std::memory_order_relaxed);
+    record.time = std::chrono::duration_cast< std::chrono::nanoseconds >(
+                      std::chrono::steady_clock::now() - start_)
+                      .count();
+    return &record;
+  }
+
+  // publish the record taken last, with the duration since it was taken
+  void commit(BusLogRecord *const record) {
+    if (record == &scratch_) {
+      return;
+    }
+    record->duration = std::chrono::duration_cast< std::chrono::nanoseconds >(
+                           std::chrono::steady_clock::now() - start_)
+                           .count() -
+                       record->time;
+    push_pos_.store(push_pos_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  //
+  // writing side (the background thread only)
+  //
+
+  // append all committed records to the file. returns the number of written records.
+  std::size_t flush() {
+    std::size_t n_written(0);
+    const std::size_t push_pos(push_pos_.load(std::memory_order_acquire));
+    std::size_t pop_pos(pop_pos_.load(std::memory_order_relaxed));
+    for (; pop_pos != push_pos; ++pop_pos) {
+      const BusLogRecord &record(slots_[pop_pos & mask_]);
+      writeGap(record.n_dropped_before);
+      write(record);
+      pop_pos_.store(pop_pos + 1, std::memory_order_release);
+      ++n_written;
+    }
+    if (file_) {
+      std::fflush(file_);
+    }
+    return n_written;
+  }
+
+  // flush the buffer periodically on a dedicated thread
+  void start(const double period = 0.1) {
+    stopThread();
+    is_stopping_ = false;
+    thread_ = std::thread([this, period]() {
+      std::unique_lock< std::mutex > lock(mutex_);
+      while (!is_stopping_) {
+        cond_.wait_for(lock, std::chrono::duration< double >(period));
+        lock.unlock();
+        flush();
+        lock.lock();
+      }
+    });
+  }
+
+  // flush remaining records and close the file
+  void stop() {
+    stopThread();
+    if (file_) {
+      flush();
+      // mark drops after the last record
+      writeGap(n_dropped_.exchange(0, std::memory_order_relaxed));
+      std::fclose(file_);
+      file_ = NULL;
+    }
+  }
+
+  // the magic to identify the format & its version
+  static const char *magic() { return "LHDXBUS1"; }
+
+  static const std::size_t MAGIC_LENGTH = 8;
+
+private:
+  void stopThread() {
+    if (!thread_.joinable()) {
+      return;
+    }
+    {
+      std::lock_guard< std::mutex > lock(mutex_);
+      is_stopping_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+  }
+
+  void writeGap(const std::uint64_t n_dropped) {
+    if (n_dropped > 0) {
+      BusLogRecord gap(BUS_LOG_DROPPED);
+      gap.put(n_dropped);
+      write(gap);
+    }
+  }
+
+  void write(const BusLogRecord &record) {
+    if (!file_) {
+      return;
+    }
+    std::uint8_t header[BusLogRecord::HEADER_LENGTH];
+    std::memcpy(header, &record.time, 8);
+    std::memcpy(header + 8, &record.duration, 4);
+    header[12] = record.op;
+    header[13] = record.flags;
+    std::memcpy(header + 14, &record.input_length, 2);
+    std::memcpy(header + 16, &record.output_length, 2);
+    std::fwrite(header, 1, sizeof(header), file_);
+    std::fwrite(record.payload, 1, record.input_length + record.output_length, file_);
+  }
+
+  static std::size_t roundUpToPowerOf2(const std::size_t n) {
+    std::size_t p(1);
+    while (p < n) {
+      p <<= 1;
+    }
+    return p;
+  }
+
+private:
+  std::vector< BusLogRecord > slots_;
+  BusLogRecord scratch_;
+  const std::size_t mask_;
+  std::atomic< std::size_t > push_pos_, pop_pos_;
+  // records dropped since the last taken record
+  std::atomic< std::uint64_t > n_dropped_;
+
+  std::FILE *file_;
+  std::chrono::steady_clock::time_point start_;
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool is_stopping_;
+};
+
+// the reading side, which loads the whole log into memory.
+// records keep their headers, and their payloads are packed in one array.
+class BusLogFile {
+public:
+  struct Entry {
+    std::uint64_t time;
+    std::uint32_t duration;
+    std::uint8_t op, flags;
+    std::uint16_t input_length, output_length;
+    // location of the payload
+    std::size_t offset;
+  };
+
+  bool load(const std::string &path) {
+    entries_.clear();
+    payloads_.clear();
+    std::FILE *const file(std::fopen(path.c_str(), "rb"));
+    if (!file) {
+      ROS_ERROR_STREAM("BusLogFile::load(): Failed to open '" << path << "' to read");
+      return false;
+    }
+    char magic[BusLogWriter::MAGIC_LENGTH];
+    std::uint64_t wall_start;
+    if (std::fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+        std::memcmp(magic, BusLogWriter::magic(), sizeof(magic)) != 0 ||
+        std::fread(&wall_start, sizeof(wall_start), 1, file) != 1) {
+      ROS_ERROR_STREAM("BusLogFile::load(): '" << path << "' is not a bus log");
+      std::fclose(file);
+      return false;
+    }
+    while (true) {
+      std::uint8_t header[BusLogRecord::HEADER_LENGTH];
+      const std::size_t n_read(std::fread(header, 1, sizeof(header), file));
+      if (n_read == 0) {
+        break;
+      }
+      Entry entry;
+      std::memcpy(&entry.time, header, 8);
+      std::memcpy(&entry.duration, header + 8, 4);
+      entry.op = header[12];
+      entry.flags = header[13];
+      std::memcpy(&entry.input_length, header + 14, 2);
+      std::memcpy(&entry.output_length, header + 16, 2);
+      entry.offset = payloads_.size();
+      const std::size_t length(entry.input_length + entry.output_length);
+      payloads_.resize(entry.offset + length);
+      if (n_read != sizeof(header) ||
+          std::fread(payloads_.data() + entry.offset, 1, length, file) != length) {
+        // the recording may have been killed while writing
+        ROS_WARN_STREAM("BusLogFile::load(): Ignored the incomplete record at the end of '"
+                        << path << "'");
+        payloads_.resize(entry.offset);
+        break;
+      }
+      entries_.push_back(entry);
+    }
+    std::fclose(file);
+    return true;
+  }
+
+  const std::vector< Entry > &getEntries() const { return entries_; }
+
+  // true if the entry is the call of the record with the same input
+  bool hasSameInput(const std::size_t i, const BusLogRecord &record) const {
+    const Entry &entry(entries_[i]);
+    return entry.op == record.op && entry.input_length == record.input_length &&
+           std::memcmp(payloads_.data() + entry.offset, record.payload, record.input_length) ==
+               0;
+  }
+
+  BusLogReader getInput(const std::size_t i) const {
+    const Entry &entry(entries_[i]);
+    return BusLogReader(payloads_.data() + entry.offset, entry.input_length);
+  }
+
+  BusLogReader getOutput(const std::size_t i) const {
+    const Entry &entry(entries_[i]);
+    return BusLogReader(payloads_.data() + entry.offset + entry.input_length,
+                        entry.output_length);
+  }
+
+private:
+  std::vector< Entry > entries_;
+  std::vector< std::uint8_t > payloads_;
+};
+
+typedef std::shared_ptr< BusLogWriter > BusLogWriterPtr;
+typedef std::shared_ptr< const BusLogWriter > BusLogWriterConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
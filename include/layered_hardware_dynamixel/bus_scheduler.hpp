@@ -0,0 +1,189 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_BUS_SCHEDULER_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_BUS_SCHEDULER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <layered_hardware_dynamixel/bus_timing.hpp>
+#include <layered_hardware_dynamixel/common_namespaces.hpp>
+#include <layered_hardware_dynamixel/dynamixel_actuator_data.hpp>
+
+namespace layered_hardware_dynamixel {
+
+// fits the work of each cycle on a bus into a time budget by the estimated airtime.
+// commands are always written, then core states and additional states are read
+// in this priority while they fit in the rest of the budget. deferred reads are
+// forced once they have been deferred for the max number of cycles so that their staleness
+// is bounded. cycles which take longer than the budget in practice are counted as overruns.
+class BusScheduler {
+public:
+  BusScheduler()
+      : budget_(0.), max_stale_cycles_(0), use_group_read_(false), use_group_write_(false),
+        stale_core_cycles_(0), n_overruns_(0) {}
+
+  virtual ~BusScheduler() {}
+
+  void init(const BusTiming &timing, const double budget, const int max_stale_cycles,
+            const std::vector< DynamixelActuatorDataPtr > &data_list, const bool use_group_read,
+            const bool use_group_write) {
+    timing_ = timing;
+    budget_ = budget;
+    max_stale_cycles_ = max_stale_cycles;
+    data_list_ = data_list;
+    use_group_read_ = use_group_read;
+    use_group_write_ = use_group_write;
+    stale_core_cycles_ = 0;
+    n_overruns_ = 0;
+  }
+
+  // decide reads in the present cycle. call after additional states due in the cycle are marked.
+  void plan() {
+    // reserve the budget for commands first
+    double rest(budget_ - estimateCommands());
+
+    // core states of all actuators as a whole
+    const double core_time(estimateCoreStates());
+    const bool reads_core(core_time <= rest || stale_core_cycles_ >= max_stale_cycles_);
+    if (reads_core) {
+      rest -= core_time;
+      stale_core_cycles_ = 0;
+    } else {
+      ++stale_core_cycles_;
+    }
+    for (const DynamixelActuatorDataPtr &data : data_list_) {
+      data->defers_core_states = !reads_core;
+    }
+
+    // additional states one by one. a group read covers all additional states at once
+    // to keep its layout, so the first one pays for the whole blocks and the rest are free.
+    double group_time(use_group_read_
+                          ? std::max(estimateBlocks(true) - (reads_core ? core_time : 0.), 0.)
+                          : 0.);
+    for (const DynamixelActuatorDataPtr &data : data_list_) {
+      if (!data->is_available || !(data->read_mask & READ_ADDITIONAL_STATES)) {
+        continue;
+      }
+      for (Int32StateItem &state : data->additional_states) {
+        if (!state.is_due) {
+          continue;
+        }
+        const double state_time(use_group_read_ ? group_time : timing_.read(state.info.length));
+        if (state_time <= rest || state.stale_cycles >= max_stale_cycles_) {
+          rest -= state_time;
+          group_time = 0.;
+          state.is_deferred = false;
+          state.stale_cycles = 0;
+        } else {
+          // retry in the next cycle
+          state.is_due = false;
+          state.is_deferred = true;
+          ++state.stale_cycles;
+        }
+      }
+    }
+  }
+
+  // check the measured time of the cycle. returns true on an overrun.
+  bool finish(const double elapsed) {
+    if (elapsed <= budget_) {
+      return false;
+    }
+    ++n_overruns_;
+    return true;
+  }
+
+  std::uint64_t getOverruns() const { return n_overruns_; }
+
+private:
+  // one goal value for each actuator
+  double estimateCommands() const {
+    static const std::size_t GOAL_LENGTH(4);
+    std::size_t n_actuators(0);
+    for (const DynamixelActuatorDataPtr &data : data_list_) {
+      if (data->is_available && data->read_mask != READ_NONE) {
+        ++n_actuators;
+      }
+    }
+    if (n_actuators == 0) {
+      return 0.;
+    }
+    return use_group_write_ ? timing_.syncWrite(n_actuators, GOAL_LENGTH)
+                            : n_actuators * timing_.write(GOAL_LENGTH);
+  }
+
+  // present position, velocity & current in the read masks
+  double estimateCoreStates() const {
+    double individual_time(0.);
+    for (const DynamixelActuatorDataPtr &data : data_list_) {
+      if (!data->is_available) {
+        continue;
+      }
+      const ItemInfo *const items[] = {&data->present_pos_item, &data->present_vel_item,
+                                       &data->present_eff_item};
+      const std::uint8_t masks[] = {READ_POSITION, READ_VELOCITY, READ_EFFORT};
+      for (int i = 0; i < 3; ++i) {
+        if ((data->read_mask & masks[i]) && items[i]->isAvailable()) {
+          individual_time += timing_.read(items[i]->length);
+        }
+      }
+    }
+    return use_group_read_ ? estimateBlocks(false) : individual_time;
+  }
+
+  // a group read of the blocks covering core states (and all additional states) in the read masks
+  double estimateBlocks(const bool with_additional_states) const {
+    std::size_t n_actuators(0), total_length(0);
+    for (const DynamixelActuatorDataPtr &data : data_list_) {
+      if (!data->is_available) {
+        continue;
+      }
+      std::uint16_t start(0), end(0);
+      const ItemInfo *const core_items[] = {&data->present_pos_item, &data->present_vel_item,
+                                            &data->present_eff_item};
+      const std::uint8_t masks[] = {READ_POSITION, READ_VELOCITY, READ_EFFORT};
+      for (int i = 0; i < 3; ++i) {
+        if ((data->read_mask & masks[i]) && core_items[i]->isAvailable()) {
+          extend(*core_items[i], &start, &end);
+        }
+      }
+      if (with_additional_states && (data->read_mask & READ_ADDITIONAL_STATES)) {
+        for (const Int32StateItem &state : data->additional_states) {
+          extend(state.info, &start, &end);
+        }
+      }
+      if (end > start) {
+        ++n_actuators;
+        total_length += end - start;
+      }
+    }
+    return n_actuators > 0 ? timing_.bulkRead(n_actuators, total_length) : 0.;
+  }
+
+  static void extend(const ItemInfo &item, std::uint16_t *const start, std::uint16_t *const end) {
+    if (*start == *end) {
+      *start = item.address;
+      *end = item.address + item.length;
+    } else {
+      *start = std::min(*start, item.address);
+      *end = std::max< std::uint16_t >(*end, item.address + item.length);
+    }
+  }
+
+private:
+  BusTiming timing_;
+  double budget_;
+  int max_stale_cycles_;
+  std::vector< DynamixelActuatorDataPtr > data_list_;
+  bool use_group_read_, use_group_write_;
+  int stale_core_cycles_;
+  std::uint64_t n_overruns_;
+};
+
+typedef std::shared_ptr< BusScheduler > BusSchedulerPtr;
+typedef std::shared_ptr< const BusScheduler > BusSchedulerConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
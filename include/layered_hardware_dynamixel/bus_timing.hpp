@@ -0,0 +1,73 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_BUS_TIMING_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_BUS_TIMING_HPP
+
+#include <cstddef>
+
+namespace layered_hardware_dynamixel {
+
+// estimates airtime of transactions on a bus from packet lengths & the baudrate.
+// a byte takes 10 bits on the wire (start, 8 data & stop bits).
+// each status packet also waits for the latency of the actuator to respond
+// (Return_Delay_Time & turnaround of the half-duplex line).
+class BusTiming {
+public:
+  BusTiming(const int baudrate = 1000000, const bool is_protocol2 = true,
+            const double status_latency = 0.)
+      : byte_time_(10. / baudrate), is_protocol2_(is_protocol2),
+        status_latency_(status_latency) {}
+
+  // time for the bytes on the wire
+  double bytes(const std::size_t n_bytes) const { return n_bytes * byte_time_; }
+
+  // instruction packet with the parameter bytes
+  double instruction(const std::size_t n_params) const {
+    // Protocol 2.0: header(3) + reserved(1) + id(1) + length(2) + instruction(1) + crc(2)
+    // Protocol 1.0: header(2) + id(1) + length(1) + instruction(1) + checksum(1)
+    return bytes((is_protocol2_ ? 10 : 6) + n_params);
+  }
+
+  // status packet with the data bytes & the response latency
+  double status(const std::size_t n_data) const {
+    // Protocol 2.0 inserts the error byte after the instruction byte (0x55)
+    return bytes((is_protocol2_ ? 11 : 6) + n_data) + status_latency_;
+  }
+
+  //
+  // transactions
+  //
+
+  // Read of one block: address & length in params
+  double read(const std::size_t length) const {
+    return instruction(is_protocol2_ ? 4 : 2) + status(length);
+  }
+
+  // Write of one block: address & data in params
+  double write(const std::size_t length) const {
+    return instruction((is_protocol2_ ? 2 : 1) + length) + status(0);
+  }
+
+  // SyncRead of the same block from actuators: address, length & ids in params
+  double syncRead(const std::size_t n_actuators, const std::size_t length) const {
+    return instruction(4 + n_actuators) + n_actuators * status(length);
+  }
+
+  // BulkRead with the total length of blocks: id, address & length for each actuator
+  double bulkRead(const std::size_t n_actuators, const std::size_t total_length) const {
+    return instruction((is_protocol2_ ? 5 : 3) * n_actuators) + n_actuators * status(0) +
+           bytes(total_length);
+  }
+
+  // SyncWrite of the same block to actuators: address, length, ids & data in params.
+  // no status packets are returned.
+  double syncWrite(const std::size_t n_actuators, const std::size_t length) const {
+    return instruction((is_protocol2_ ? 4 : 2) + n_actuators * (1 + length));
+  }
+
+private:
+  double byte_time_;
+  bool is_protocol2_;
+  double status_latency_;
+};
+} // namespace layered_hardware_dynamixel
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_CAPABILITY_CACHE_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_CAPABILITY_CACHE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include <ros/console.h>
+
+namespace layered_hardware_dynamixel {
+
+// unit scales of raw values, resolved from the control table or DynamixelWorkbench's model info
+struct UnitScales {
+  UnitScales()
+      : pos_zero_value(0.), pos_scale_plus(0.), pos_scale_minus(0.), vel_scale(0.),
+        current_scale(0.) {}
+
+  // position: raw values [min, zero] & [zero, max] map to [min_radian, 0] & [0, max_radian].
+  // velocity in rad/s & current in mA per raw value.
+  double pos_zero_value, pos_scale_plus, pos_scale_minus, vel_scale, current_scale;
+};
+
+// capabilities of actuators resolved on init (control table layouts & unit scales),
+// kept in a file across restarts so that actuators of the same model & firmware
+// skip resolving them again. the file is a plain text with lines like
+//   actuator <port> <id> <model_number> <firmware_version>
+//   item <name> <address> <length>
+//   scales <pos_zero_value> <pos_scale_plus> <pos_scale_minus> <vel_scale> <current_scale>
+// where items & scales belong to the last actuator line, "no_scales" means the actuator
+// has no linear scales, and items of length 0 are unavailable on the model.
+class CapabilityCache {
+public:
+  // addresses & lengths of items by name
+  typedef std::map< std::string, std::pair< std::uint16_t, std::uint16_t > > Items;
+
+  struct Capability {
+    Capability() : has_scales(false), uses_scales(false), is_modified(true) {}
+
+    // including unavailable ones
+    Items items;
+    // true if the scales have been resolved, and if they are valid
+    bool has_scales, uses_scales;
+    UnitScales scales;
+    // true if the capability has been resolved in this run and should be saved
+    bool is_modified;
+  };
+
+  CapabilityCache() {}
+
+  virtual ~CapabilityCache() {}
+
+  // load capabilities from the file. a missing file is an empty cache.
+  // a malformed file is discarded so that capabilities are resolved again.
+  bool load(const std::string &path) {
+    path_ = path;
+    capabilities_.clear();
+    std::ifstream file(path_.c_str());
+    if (!file) {
+      ROS_INFO_STREAM("CapabilityCache::load(): No cache file '" << path_
+                                                                 << "'. Starting with no entry.");
+      return true;
+    }
+    Capability *capability(NULL);
+    std::string line;
+    for (int n_lines = 1; std::getline(file, line); ++n_lines) {
+      std::istringstream tokens(line);
+      std::string tag;
+      if (!(tokens >> tag) || tag[0] == '#') {
+        continue;
+      }
+      bool is_valid(false);
+      if (tag == "actuator") {
+        std::string port;
+        int id, model_number, firmware_version;
+        if (tokens >> port >> id >> model_number >> firmware_version) {
+          capability = &capabilities_[makeKey(port, id, model_number, firmware_version)];
+          capability->is_modified = false;
+          is_valid = true;
+        }
+      } else if (tag == "item" && capability) {
+        std::string name;
+        std::uint16_t address, length;
+        if (tokens >> name >> address >> length) {
+          capability->items[name] = std::make_pair(address, length);
+          is_valid = true;
+        }
+      } else if (tag == "scales" && capability) {
+        UnitScales &scales(capability->scales);
+        if (tokens >> scales.pos_zero_value >> scales.pos_scale_plus >> scales.pos_scale_minus >>
+            scales.vel_scale >> scales.current_scale) {
+          capability->has_scales = capability->uses_scales = true;
+          is_valid = true;
+        }
+      } else if (tag == "no_scales" && capability) {
+        capability->has_scales = true;
+        capability->uses_scales = false;
+        is_valid = true;
+      }
+      if (!is_valid) {
+        ROS_WARN_STREAM("CapabilityCache::load(): Malformed line "
+                        << n_lines << " in the cache file '" << path_
+                        << "'. Discarding all entries.");
+        capabilities_.clear();
+        return false;
+      }
+    }
+    ROS_INFO_STREAM("CapabilityCache::load(): Loaded " << capabilities_.size()
+                                                       << " entries from the cache file '"
+                                                       << path_ << "'");
+    return true;
+  }
+
+  // write all capabilities to the file if any of them has been resolved in this run.
+  // the file is replaced at once so that a crash on writing never leaves a partial cache.
+  bool save() {
+    bool is_modified(false);
+    for (const Capabilities::value_type &capability : capabilities_) {
+      is_modified = is_modified || capability.second.is_modified;
+    }
+    if (!is_modified) {
+      return true;
+    }
+
+    const std::string tmp_path(path_ + ".tmp");
+    {
+      std::ofstream file(tmp_path.c_str());
+      file << "# capabilities of dynamixel actuators cached by layered_hardware_dynamixel\n"
+           << std::setprecision(std::numeric_limits< double >::max_digits10);
+      for (const Capabilities::value_type &capability : capabilities_) {
+        file << "actuator " << capability.first << "\n";
+        for (const Items::value_type &item : capability.second.items) {
+          file << "item " << item.first << " " << item.second.first << " " << item.second.second
+               << "\n";
+        }
+        if (!capability.second.has_scales) {
+          continue;
+        }
+        if (!capability.second.uses_scales) {
+          file << "no_scales\n";
+          continue;
+        }
+        const UnitScales &scales(capability.second.scales);
+        file << "scales " << scales.pos_zero_value << " " << scales.pos_scale_plus << " "
+             << scales.pos_scale_minus << " " << scales.vel_scale << " " << scales.current_scale
+             << "\n";
+      }
+      if (!file.flush()) {
+        ROS_ERROR_STREAM("CapabilityCache::save(): Failed to write the cache file '" << tmp_path
+                                                                                     << "'");
+        return false;
+      }
+    }
+    if (std::rename(tmp_path.c_str(), path_.c_str()) != 0) {
+      ROS_ERROR_STREAM("CapabilityCache::save(): Failed to replace the cache file '"
+                       << path_ << "' with '" << tmp_path << "'");
+      return false;
+    }
+    for (Capabilities::value_type &capability : capabilities_) {
+      capability.second.is_modified = false;
+    }
+    ROS_INFO_STREAM("CapabilityCache::save(): Saved " << capabilities_.size()
+                                                      << " entries to the cache file '" << path_
+                                                      << "'");
+    return true;
+  }
+
+  // the capability of the actuator, or an empty one to be resolved if never cached.
+  // the returned entry stays valid as long as the cache.
+  Capability *get(const std::string &port, const int id, const int model_number,
+                  const int firmware_version, bool *const is_cached) {
+    const std::string key(makeKey(port, id, model_number, firmware_version));
+    const Capabilities::iterator it(capabilities_.find(key));
+    *is_cached = (it != capabilities_.end());
+    return *is_cached ? &it->second : &capabilities_[key];
+  }
+
+private:
+  typedef std::map< std::string, Capability > Capabilities;
+
+  static std::string makeKey(const std::string &port, const int id, const int model_number,
+                             const int firmware_version) {
+    std::ostringstream key;
+    key << port << " " << id << " " << model_number << " " << firmware_version;
+    return key.str();
+  }
+
+private:
+  std::string path_;
+  Capabilities capabilities_;
+};
+
+typedef std::shared_ptr< CapabilityCache > CapabilityCachePtr;
+typedef std::shared_ptr< const CapabilityCache > CapabilityCacheConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
@@ -13,7 +13,7 @@ namespace layered_hardware_dynamixel {
 class ClearMultiTurnMode : public OperatingModeBase {
 public:
   ClearMultiTurnMode(const DynamixelActuatorDataPtr &data)
-      : OperatingModeBase("clear_multi_turn", data) {}
+      : OperatingModeBase("clear_multi_turn", data, READ_NONE) {}
 
   virtual void starting() override { clearMultiTurn(); }
 
@@ -0,0 +1,39 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_COMMAND_CACHE_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_COMMAND_CACHE_HPP
+
+#include <cmath>
+#include <cstdint>
+
+namespace layered_hardware_dynamixel {
+
+// the last command written to a control table item, in the raw value & the source value.
+// operating modes share caches of an actuator so that they write a command only when
+// its raw value changes, and optionally only when the source value moves beyond a dead-band.
+class CachedCommand {
+public:
+  CachedCommand() : is_valid_(false), value_(0), source_(0.) {}
+
+  // true if the raw value differs from the last written one and the source value has moved
+  // by more than the dead-band since then. always true if nothing has been written.
+  bool needsWrite(const std::int32_t value, const double source = 0.,
+                  const double dead_band = 0.) const {
+    return !is_valid_ || (value != value_ && !(std::abs(source - source_) <= dead_band));
+  }
+
+  void update(const std::int32_t value, const double source = 0.) {
+    is_valid_ = true;
+    value_ = value;
+    source_ = source;
+  }
+
+  // force the next write
+  void invalidate() { is_valid_ = false; }
+
+private:
+  bool is_valid_;
+  std::int32_t value_;
+  double source_;
+};
+} // namespace layered_hardware_dynamixel
+
+#endif
@@ -0,0 +1,294 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_COMMAND_MERGER_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_COMMAND_MERGER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <layered_hardware_dynamixel/bus_backend.hpp>
+#include <layered_hardware_dynamixel/common_namespaces.hpp>
+#include <layered_hardware_dynamixel/dynamixel_actuator_data.hpp>
+#include <layered_hardware_dynamixel/error_log.hpp>
+
+namespace layered_hardware_dynamixel {
+
+// merges commands staged by operating modes of each actuator into contiguous blocks
+// so that a block is written with one instruction instead of one per item
+// (e.g. Goal_Current, Profile_Velocity & Goal_Position of the current-based position mode).
+// a small gap between staged items is bridged by rewriting the bytes in the gap
+// with their known values. the merger keeps the bytes last written or read by itself
+// as the shadow of the control table, and reads unknown bytes in a gap once.
+// once a merged block fails to be written to an actuator, its commands are written item by
+// item until the shadow is invalidated, because the bridged bytes may be the cause
+// (e.g. they are changed by others or rejected by the actuator) and the retry fails likewise.
+class CommandMerger {
+public:
+  // the max bytes of a gap to be bridged, which covers Goal_Velocity & Profile_Acceleration
+  // between Goal_Current & Profile_Velocity of X-series
+  static const std::uint16_t MAX_GAP = 8;
+  static const std::uint16_t MAX_LENGTH = 32;
+  static const std::uint8_t MAX_ITEMS = 8;
+
+  // a contiguous block of commands as little endian bytes of the control table
+  struct Block {
+    std::uint16_t address, length;
+    std::uint8_t bytes[MAX_LENGTH];
+    // the merged commands to write them separately if the block cannot be written at once
+    std::uint8_t n_items;
+    StagedItem items[MAX_ITEMS];
+  };
+
+  CommandMerger() : dxl_wb_(NULL), error_log_(NULL) {}
+
+  virtual ~CommandMerger() {}
+
+  bool init(BusBackend *const dxl_wb, const std::vector< DynamixelActuatorDataPtr > &data_list) {
+    dxl_wb_ = dxl_wb;
+    data_list_ = data_list;
+    shadows_.assign(data_list_.size(), Shadow());
+    blocks_.reserve(4);
+
+    // the shadow of each actuator spans all items of commands it may stage
+    for (std::size_t i = 0; i < data_list_.size(); ++i) {
+      DynamixelActuatorData &data(*data_list_[i]);
+      std::uint16_t start(0), end(0);
+      cover(data.goal_pos_item, &start, &end);
+      cover(data.goal_vel_item, &start, &end);
+      cover(data.goal_eff_item, &start, &end);
+      cover(data.profile_vel_item, &start, &end);
+      for (const Int32Item &cmd : data.additional_cmds) {
+        cover(cmd.info, &start, &end);
+      }
+      Shadow &shadow(shadows_[i]);
+      shadow.start = start;
+      shadow.bytes.assign(end - start, 0);
+      shadow.is_known.assign(end - start, false);
+
+      // let operating modes stage commands instead of writing them immediately
+      data.stages_cmds = true;
+      data.staged_cmds.clear();
+      data.staged_cmds.reserve(4 + data.additional_cmds.size());
+    }
+    return true;
+  }
+
+  // report errors to the log instead of logging them immediately
+  void setErrorLog(ErrorLog *const error_log) { error_log_ = error_log; }
+
+  // forget all known bytes because other writes (e.g. on switching modes) may change them.
+  // actuators given up merging try again.
+  void invalidate() {
+    for (Shadow &shadow : shadows_) {
+      std::fill(shadow.is_known.begin(), shadow.is_known.end(), false);
+      shadow.merges = true;
+    }
+  }
+
+  // merge commands staged for the i-th actuator into blocks in the order of addresses,
+  // then clear them. commands to an unavailable actuator are discarded.
+  void merge(const std::size_t i, std::vector< Block > *const blocks) {
+    DynamixelActuatorData &data(*data_list_[i]);
+    Shadow &shadow(shadows_[i]);
+    blocks->clear();
+    if (!data.is_available) {
+      // the actuator may be rebooted or power-cycled before it becomes available again
+      std::fill(shadow.is_known.begin(), shadow.is_known.end(), false);
+      data.staged_cmds.clear();
+      return;
+    }
+
+    sortStaged(&data.staged_cmds);
+    for (const StagedItem &item : data.staged_cmds) {
+      ItemInfo info;
+      info.address = item.address;
+      info.length = item.length;
+      if (!blocks->empty()) {
+        Block &last(blocks->back());
+        StagedItem &last_item(last.items[last.n_items - 1]);
+        // the later one of the same item wins
+        if (item.address == last_item.address && item.length == last_item.length) {
+          info.encode(item.value, last.bytes + (item.address - last.address));
+          last_item.value = item.value;
+          continue;
+        }
+        // adjacent items join the block, and so do ones after a gap with known bytes
+        const std::uint16_t end(last.address + last.length);
+        if (shadow.merges && item.address >= end &&
+            item.address + item.length - last.address <= MAX_LENGTH && last.n_items < MAX_ITEMS &&
+            (item.address == end ||
+             (item.address - end <= MAX_GAP &&
+              fillGap(i, end, item.address - end, last.bytes + last.length)))) {
+          info.encode(item.value, last.bytes + (item.address - last.address));
+          last.length = item.address + item.length - last.address;
+          last.items[last.n_items++] = item;
+          continue;
+        }
+      }
+      blocks->push_back(Block());
+      Block &block(blocks->back());
+      block.address = item.address;
+      block.length = item.length;
+      info.encode(item.value, block.bytes);
+      block.n_items = 1;
+      block.items[0] = item;
+    }
+    data.staged_cmds.clear();
+  }
+
+  // update the shadow by the result of writing the block to the i-th actuator
+  void commit(const std::size_t i, const Block &block, const bool is_written) {
+    Shadow &shadow(shadows_[i]);
+    if (!is_written && block.n_items > 1 && shadow.merges) {
+      ErrorLog::report(error_log_,
+                       ErrorEntry("CommandMerger::commit",
+                                  "Writing commands item by item after failing to write a block",
+                                  NULL, data_list_[i]->name.c_str(), data_list_[i]->id,
+                                  block.address, NULL));
+      shadow.merges = false;
+    }
+    for (std::uint16_t j = 0; j < block.length; ++j) {
+      const std::uint16_t address(block.address + j);
+      if (address < shadow.start || address >= shadow.start + shadow.bytes.size()) {
+        continue;
+      }
+      // the control table is unknown after a failed write
+      shadow.bytes[address - shadow.start] = block.bytes[j];
+      shadow.is_known[address - shadow.start] = is_written;
+    }
+  }
+
+  // write merged commands of each actuator individually. used without the group write.
+  // commands in a block failed to be written are written again item by item.
+  bool flush() {
+    bool result(true);
+    for (std::size_t i = 0; i < data_list_.size(); ++i) {
+      merge(i, &blocks_);
+      for (Block &block : blocks_) {
+        if (writeBlock(i, &block) || block.n_items <= 1) {
+          continue;
+        }
+        for (std::uint8_t j = 0; j < block.n_items; ++j) {
+          const StagedItem &item(block.items[j]);
+          Block item_block;
+          item_block.address = item.address;
+          item_block.length = item.length;
+          std::copy(block.bytes + (item.address - block.address),
+                    block.bytes + (item.address - block.address + item.length),
+                    item_block.bytes);
+          item_block.n_items = 1;
+          item_block.items[0] = item;
+          result = writeBlock(i, &item_block) && result;
+        }
+      }
+    }
+    return result;
+  }
+
+private:
+  struct Shadow {
+    Shadow() : start(0), merges(true) {}
+
+    std::uint16_t start;
+    std::vector< std::uint8_t > bytes;
+    std::vector< bool > is_known;
+    // false after a merged block has failed to be written
+    bool merges;
+  };
+
+  // stably sort items in the order of addresses so that the later one of the same item wins.
+  // an insertion sort in place because std::stable_sort() allocates a temporary buffer
+  // and an actuator stages only a few items in a cycle.
+  static void sortStaged(std::vector< StagedItem > *const items) {
+    for (std::size_t j = 1; j < items->size(); ++j) {
+      const StagedItem item((*items)[j]);
+      std::size_t k(j);
+      for (; k > 0 && (*items)[k - 1].address > item.address; --k) {
+        (*items)[k] = (*items)[k - 1];
+      }
+      (*items)[k] = item;
+    }
+  }
+
+  // write the block to the i-th actuator. the block is not modified but DynamixelWorkbench
+  // takes a non-const buffer
+  bool writeBlock(const std::size_t i, Block *const block) {
+    DynamixelActuatorData &data(*data_list_[i]);
+    const char *log(NULL);
+    const bool is_written(
+        dxl_wb_->writeRegister(data.id, block->address, block->length, block->bytes, &log));
+    commit(i, *block, is_written);
+    if (!is_written) {
+      ErrorLog::report(error_log_, ErrorEntry("CommandMerger::flush", "Failed to write", NULL,
+                                              data.name.c_str(), data.id, block->address, log));
+      ++data.n_errors;
+      if (data.stats) {
+        data.stats->countError();
+      }
+    }
+    return is_written;
+  }
+
+  // copy the bytes [address, address + length) of the i-th actuator from the shadow.
+  // unknown bytes are read from the actuator in advance.
+  bool fillGap(const std::size_t i, const std::uint16_t address, const std::uint16_t length,
+               std::uint8_t *const bytes) {
+    const DynamixelActuatorData &data(*data_list_[i]);
+    Shadow &shadow(shadows_[i]);
+    if (address < shadow.start || address + length > shadow.start + shadow.bytes.size()) {
+      return false;
+    }
+    // readRegister() reads up to 4 bytes at once
+    for (std::uint16_t j = 0; j < length; j += 4) {
+      const std::uint16_t offset(address - shadow.start + j),
+          n_bytes(std::min< std::uint16_t >(4, length - j));
+      if (std::find(shadow.is_known.begin() + offset, shadow.is_known.begin() + offset + n_bytes,
+                    false) == shadow.is_known.begin() + offset + n_bytes) {
+        continue;
+      }
+      std::uint32_t value;
+      const char *log(NULL);
+      if (!dxl_wb_->readRegister(data.id, address + j, n_bytes, &value, &log)) {
+        ErrorLog::report(error_log_, ErrorEntry("CommandMerger::fillGap",
+                                                "Failed to read bytes between commands", NULL,
+                                                data.name.c_str(), data.id, address + j, log));
+        return false;
+      }
+      for (std::uint16_t k = 0; k < n_bytes; ++k) {
+        shadow.bytes[offset + k] = static_cast< std::uint8_t >((value >> (8 * k)) & 0xFF);
+        shadow.is_known[offset + k] = true;
+      }
+    }
+    std::copy(shadow.bytes.begin() + (address - shadow.start),
+              shadow.bytes.begin() + (address - shadow.start + length), bytes);
+    return true;
+  }
+
+  // extend the range [*start, *end) to cover the item. the range is empty if *start == *end.
+  static void cover(const ItemInfo &item, std::uint16_t *const start, std::uint16_t *const end) {
+    if (!item.isAvailable()) {
+      return;
+    }
+    if (*start == *end) {
+      *start = item.address;
+      *end = item.address + item.length;
+      return;
+    }
+    *start = std::min(*start, item.address);
+    *end = std::max< std::uint16_t >(*end, item.address + item.length);
+  }
+
+private:
+  BusBackend *dxl_wb_;
+  ErrorLog *error_log_;
+  std::vector< DynamixelActuatorDataPtr > data_list_;
+  std::vector< Shadow > shadows_;
+  std::vector< Block > blocks_;
+};
+
+typedef std::shared_ptr< CommandMerger > CommandMergerPtr;
+typedef std::shared_ptr< const CommandMerger > CommandMergerConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_CONTROL_TABLE_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_CONTROL_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace layered_hardware_dynamixel {
+
+// a control table item at the address & length fixed at compile time
+template < std::uint16_t Address, std::uint16_t Length > struct FixedItem {
+  static_assert(Length == 1 || Length == 2 || Length == 4,
+                "FixedItem: the length of an item must be 1, 2 or 4 bytes");
+
+  static constexpr std::uint16_t address = Address;
+  static constexpr std::uint16_t length = Length;
+  // the end of the item to check the layout of blocks at compile time
+  static constexpr std::uint16_t end = Address + Length;
+};
+
+// an entry of the item list of a control table
+struct ControlTableItem {
+  const char *name;
+  std::uint16_t address, length;
+};
+
+// the control table of X-series models on Protocol 2.0, whose current unit is 2.69 mA
+// like DynamixelWorkbench::convertValue2Current() assumes
+// (XM430, XM540 & XH540. XH430 has another current unit).
+// unit scales follow the model info of DynamixelWorkbench for these models.
+struct XSeriesControlTable {
+  // core states & commands
+  typedef FixedItem< 11, 1 > OperatingMode;
+  typedef FixedItem< 64, 1 > TorqueEnable;
+  typedef FixedItem< 102, 2 > GoalCurrent;
+  typedef FixedItem< 104, 4 > GoalVelocity;
+  typedef FixedItem< 112, 4 > ProfileVelocity;
+  typedef FixedItem< 116, 4 > GoalPosition;
+  typedef FixedItem< 126, 2 > PresentCurrent;
+  typedef FixedItem< 128, 4 > PresentVelocity;
+  typedef FixedItem< 132, 4 > PresentPosition;
+
+  // the group read transfers the core states as one block without gaps
+  static_assert(PresentCurrent::end == PresentVelocity::address &&
+                    PresentVelocity::end == PresentPosition::address,
+                "XSeriesControlTable: core states must be contiguous");
+
+  // position: raw values [min, zero] & [zero, max] map to [min_radian, 0] & [0, max_radian]
+  static constexpr double positionZeroValue() { return 2048.; }
+
+  static constexpr double positionScalePlus() {
+    return static_cast< double >(3.14159265f) / (4095. - 2048.);
+  }
+
+  static constexpr double positionScaleMinus() {
+    return static_cast< double >(-3.14159265f) / (0. - 2048.);
+  }
+
+  // velocity: 0.229 rpm per raw value
+  static constexpr double velocityScale() {
+    return static_cast< double >(0.229f) * 2. * 3.14159265358979323846 / 60.;
+  }
+
+  // current: 2.69 mA per raw value
+  static constexpr double currentScale() { return static_cast< double >(2.69f); }
+
+  // items other modules & params may refer to by name
+  static const ControlTableItem *findItem(const char *const name) {
+    static const ControlTableItem items[] = {
+        {"Model_Number", 0, 2},
+        {"Firmware_Version", 6, 1},
+        {"ID", 7, 1},
+        {"Baud_Rate", 8, 1},
+        {"Return_Delay_Time", 9, 1},
+        {"Drive_Mode", 10, 1},
+        {"Operating_Mode", OperatingMode::address, OperatingMode::length},
+        {"Homing_Offset", 20, 4},
+        {"Moving_Threshold", 24, 4},
+        {"Temperature_Limit", 31, 1},
+        {"Max_Voltage_Limit", 32, 2},
+        {"Min_Voltage_Limit", 34, 2},
+        {"PWM_Limit", 36, 2},
+        {"Current_Limit", 38, 2},
+        {"Velocity_Limit", 44, 4},
+        {"Max_Position_Limit", 48, 4},
+        {"Min_Position_Limit", 52, 4},
+        {"Shutdown", 63, 1},
+        {"Torque_Enable", TorqueEnable::address, TorqueEnable::length},
+        {"LED", 65, 1},
+        {"Status_Return_Level", 68, 1},
+        {"Registered_Instruction", 69, 1},
+        {"Hardware_Error_Status", 70, 1},
+        {"Velocity_I_Gain", 76, 2},
+        {"Velocity_P_Gain", 78, 2},
+        {"Position_D_Gain", 80, 2},
+        {"Position_I_Gain", 82, 2},
+        {"Position_P_Gain", 84, 2},
+        {"Feedforward_2nd_Gain", 88, 2},
+        {"Feedforward_1st_Gain", 90, 2},
+        {"Bus_Watchdog", 98, 1},
+        {"Goal_PWM", 100, 2},
+        {"Goal_Current", GoalCurrent::address, GoalCurrent::length},
+        {"Goal_Velocity", GoalVelocity::address, GoalVelocity::length},
+        {"Profile_Acceleration", 108, 4},
+        {"Profile_Velocity", ProfileVelocity::address, ProfileVelocity::length},
+        {"Goal_Position", GoalPosition::address, GoalPosition::length},
+        {"Realtime_Tick", 120, 2},
+        {"Moving", 122, 1},
+        {"Moving_Status", 123, 1},
+        {"Present_PWM", 124, 2},
+        {"Present_Current", PresentCurrent::address, PresentCurrent::length},
+        {"Present_Velocity", PresentVelocity::address, PresentVelocity::length},
+        {"Present_Position", PresentPosition::address, PresentPosition::length},
+        {"Velocity_Trajectory", 136, 4},
+        {"Position_Trajectory", 140, 4},
+        {"Present_Input_Voltage", 144, 2},
+        {"Present_Temperature", 146, 1},
+        {"Indirect_Address_1", 168, 2},
+        {"Indirect_Data_1", 224, 1}};
+    for (const ControlTableItem &item : items) {
+      if (std::strcmp(item.name, name) == 0) {
+        return &item;
+      }
+    }
+    return NULL;
+  }
+
+  static bool hasModel(const char *const model_name) {
+    static const char *const names[] = {"XM430-W210", "XM430-W350", "XM540-W150",
+                                        "XM540-W270", "XH540-W150", "XH540-W270",
+                                        "XH540-V150", "XH540-V270"};
+    for (const char *const name : names) {
+      if (std::strcmp(name, model_name) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+// the runtime view of a compile-time control table, which actuators of known models refer to
+// instead of looking up items & unit scales in DynamixelWorkbench's model database
+struct ControlTable {
+  // the table of the model family, or NULL if the model is unknown
+  // and items & scales should be resolved at runtime
+  static const ControlTable *find(const char *const model_name) {
+    if (!model_name) {
+      return NULL;
+    }
+    if (XSeriesControlTable::hasModel(model_name)) {
+      return &of< XSeriesControlTable >("X-series");
+    }
+    return NULL;
+  }
+
+  template < typename Table > static const ControlTable &of(const char *const family) {
+    // the scales are constant expressions folded at compile time
+    static const ControlTable table = {family,
+                                       &Table::findItem,
+                                       Table::positionZeroValue(),
+                                       Table::positionScalePlus(),
+                                       Table::positionScaleMinus(),
+                                       Table::velocityScale(),
+                                       Table::currentScale()};
+    return table;
+  }
+
+  const char *family;
+  const ControlTableItem *(*find_item)(const char *);
+  double pos_zero_value, pos_scale_plus, pos_scale_minus, vel_scale, current_scale;
+};
+} // namespace layered_hardware_dynamixel
+
+#endif
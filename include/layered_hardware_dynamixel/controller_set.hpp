@@ -1,55 +1,132 @@
 #ifndef LAYERED_HARDWARE_DYNAMIXEL_CONTROLLER_SET_HPP
 #define LAYERED_HARDWARE_DYNAMIXEL_CONTROLLER_SET_HPP
 
-#include <set>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <hardware_interface/controller_info.h>
 #include <layered_hardware_dynamixel/common_namespaces.hpp>
 
 namespace layered_hardware_dynamixel {
 
-class ControllerSet : public std::set< std::string > {
+// controller names interned to serial ids at init.
+// controllers which no operating mode refers to have no id and never affect mode switching.
+class ControllerIds {
+public:
+  static const int NO_ID = -1;
+
+  // get the id of the name, assigning a new one if unknown. call at init only.
+  int intern(const std::string &name) {
+    const std::pair< std::unordered_map< std::string, int >::iterator, bool > res(
+        ids_.insert(std::make_pair(name, static_cast< int >(ids_.size()))));
+    return res.first->second;
+  }
+
+  int find(const std::string &name) const {
+    const std::unordered_map< std::string, int >::const_iterator it(ids_.find(name));
+    return it != ids_.end() ? it->second : NO_ID;
+  }
+
+  int find(const hi::ControllerInfo &info) const { return find(info.name); }
+
+  std::size_t size() const { return ids_.size(); }
+
 private:
-  typedef std::set< std::string > Base;
+  std::unordered_map< std::string, int > ids_;
+};
+
+typedef std::shared_ptr< ControllerIds > ControllerIdsPtr;
+typedef std::shared_ptr< const ControllerIds > ControllerIdsConstPtr;
 
+// set of controllers as a bitset indexed by interned ids.
+// sets sized with reserve() before use never allocate memory on updates or copies.
+class ControllerSet {
 public:
-  std::pair< iterator, bool > insert(const hi::ControllerInfo &info) {
-    return Base::insert(info.name);
+  ControllerSet() {}
+
+  // make room for ids less than n_ids
+  void reserve(const std::size_t n_ids) {
+    if (words_.size() < wordsFor(n_ids)) {
+      words_.resize(wordsFor(n_ids), 0);
+    }
+  }
+
+  void clear() { words_.assign(words_.size(), 0); }
+
+  void insert(const int id) {
+    if (id < 0) {
+      return;
+    }
+    reserve(id + 1);
+    words_[id / BITS] |= bitOf(id);
   }
 
-  std::size_t erase(const hi::ControllerInfo &info) { return Base::erase(info.name); }
+  void erase(const int id) {
+    if (id < 0 || static_cast< std::size_t >(id / BITS) >= words_.size()) {
+      return;
+    }
+    words_[id / BITS] &= ~bitOf(id);
+  }
 
+  // insert controllers in the start list & erase ones in the stop list
   template < class Container >
-  void update(const Container &start_list, const Container &stop_list) {
+  void update(const ControllerIds &ids, const Container &start_list, const Container &stop_list) {
     for (const auto /* std::string or hi::ControllerInfo */ &info : start_list) {
-      insert(info);
+      insert(ids.find(info));
     }
     for (const auto &info : stop_list) {
-      erase(info);
+      erase(ids.find(info));
     }
   }
 
-  template < class Container >
-  ControllerSet updated(const Container &start_list, const Container &stop_list) const {
-    ControllerSet res(*this);
-    res.update(start_list, stop_list);
-    return res;
+  // copy elements of another set into this set without reallocation if sizes match
+  void assign(const ControllerSet &other) {
+    words_.resize(other.words_.size(), 0);
+    for (std::size_t i = 0; i < words_.size(); ++i) {
+      words_[i] = other.words_[i];
+    }
   }
 
-  bool contains(const std::string &name) const { return find(name) != end(); }
+  bool contains(const int id) const {
+    return id >= 0 && static_cast< std::size_t >(id / BITS) < words_.size() &&
+           (words_[id / BITS] & bitOf(id)) != 0;
+  }
 
-  bool contains(const hi::ControllerInfo &info) const { return contains(info.name); }
+  // true if this set contains all elements of the given set
+  bool contains(const ControllerSet &other) const {
+    for (std::size_t i = 0; i < other.words_.size(); ++i) {
+      const std::uint64_t word(i < words_.size() ? words_[i] : 0);
+      if ((other.words_[i] & ~word) != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
 
-  template < class Container > bool contains(const Container &infos) const {
-    for (const auto /* std::string or hi::ControllerInfo */ &info : infos) {
-      if (!contains(info)) {
+  bool empty() const {
+    for (const std::uint64_t word : words_) {
+      if (word != 0) {
         return false;
       }
     }
     return true;
   }
+
+private:
+  static const int BITS = 64;
+
+  static std::size_t wordsFor(const std::size_t n_ids) { return (n_ids + BITS - 1) / BITS; }
+
+  static std::uint64_t bitOf(const int id) { return std::uint64_t(1) << (id % BITS); }
+
+private:
+  std::vector< std::uint64_t > words_;
 };
 } // namespace layered_hardware_dynamixel
 
-#endif
\ No newline at end of file
+#endif
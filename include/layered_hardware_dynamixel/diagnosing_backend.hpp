@@ -0,0 +1,560 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_DIAGNOSING_BACKEND_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_DIAGNOSING_BACKEND_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <dynamixel_workbench_toolbox/dynamixel_workbench.h>
+#include <hardware_interface_extensions/integer_interface.hpp>
+#include <layered_hardware_dynamixel/bus_backend.hpp>
+#include <layered_hardware_dynamixel/bus_timing.hpp>
+#include <layered_hardware_dynamixel/common_namespaces.hpp>
+#include <layered_hardware_dynamixel/error_log.hpp>
+
+namespace layered_hardware_dynamixel {
+
+// forwards all calls to another backend and diagnoses transactions on the way.
+// round trips of pings, register reads & writes, SyncReads and BulkReads are timed
+// against their airtime estimated from the baudrate, so that an excess latency on every
+// transaction reveals a misconfigured latency timer of the USB serial converter.
+// failures are counted for each actuator and classified by the log of DynamixelSDK
+// into timeouts (no status packet) and corrupt packets (e.g. CRC errors by noisy cabling).
+// recorded on the thread running bus cycles, and summarized on the control thread.
+class DiagnosingBackend : public BusBackend {
+public:
+  DiagnosingBackend(const BusBackendPtr &backend, const double max_excess_latency = 0.004,
+                    const double max_error_rate = 0.01)
+      : backend_(backend), max_excess_latency_(max_excess_latency),
+        max_error_rate_(max_error_rate), n_bulk_read_params_(0), bulk_read_length_(0),
+        n_timed_(0), rtt_sum_us_(0), airtime_sum_us_(0), rtt_us_(0), airtime_us_(0),
+        latency_warning_(0) {}
+
+  virtual ~DiagnosingBackend() {}
+
+  const BusBackendPtr &getBackend() const { return backend_; }
+
+  //
+  // the link & models
+  //
+
+  virtual bool init(const char *device_name, std::uint32_t baud_rate,
+                    const char **log = NULL) override {
+    if (!backend_->init(device_name, baud_rate, log)) {
+      return false;
+    }
+    timing_ = BusTiming(baud_rate, backend_->getProtocolVersion() == 2.0);
+    return true;
+  }
+
+  virtual float getProtocolVersion() override { return backend_->getProtocolVersion(); }
+
+  virtual const char *getModelName(std::uint8_t id, const char **log = NULL) override {
+    return backend_->getModelName(id, log);
+  }
+
+  virtual std::uint16_t getModelNumber(std::uint8_t id, const char **log = NULL) override {
+    return backend_->getModelNumber(id, log);
+  }
+
+  virtual const ControlItem *getItemInfo(std::uint8_t id, const char *item_name,
+                                         const char **log = NULL) override {
+    return backend_->getItemInfo(id, item_name, log);
+  }
+
+  virtual const ModelInfo *getModelInfo(std::uint8_t id, const char **log = NULL) override {
+    return backend_->getModelInfo(id, log);
+  }
+
+  //
+  // unit conversions by the model
+  //
+
+  virtual std::int32_t convertRadian2Value(std::uint8_t id, float radian) override {
+    return backend_->convertRadian2Value(id, radian);
+  }
+
+  virtual float convertValue2Radian(std::uint8_t id, std::int32_t value) override {
+    return backend_->convertValue2Radian(id, value);
+  }
+
+  virtual std::int32_t convertVelocity2Value(std::uint8_t id, float velocity) override {
+    return backend_->convertVelocity2Value(id, velocity);
+  }
+
+  virtual float convertValue2Velocity(std::uint8_t id, std::int32_t value) override {
+    return backend_->convertValue2Velocity(id, value);
+  }
+
+  virtual std::int16_t convertCurrent2Value(std::uint8_t id, float current) override {
+    return backend_->convertCurrent2Value(id, current);
+  }
+
+  virtual float convertValue2Current(std::uint8_t id, std::int16_t value) override {
+    return backend_->convertValue2Current(id, value);
+  }
+
+  //
+  // instructions to an actuator
+  //
+
+  virtual bool ping(std::uint8_t id, std::uint16_t *get_model_number,
+                    const char **log = NULL) override {
+    const Clock::time_point start(Clock::now());
+    const char *call_log(NULL);
+    const bool result(backend_->ping(id, get_model_number, &call_log));
+    // the status packet has the model number & the firmware version
+    finishTimed(id, start, timing_.instruction(0) + timing_.status(3), result, call_log, log);
+    return result;
+  }
+
+  virtual bool ping(std::uint8_t id, const char **log = NULL) override {
+    return ping(id, NULL, log);
+  }
+
+  // not timed because DynamixelSDK waits for a fixed time regardless of answers
+  virtual bool scan(std::uint8_t *get_id, std::uint8_t *get_the_number_of_id,
+                    std::uint8_t range = 253, const char **log = NULL) override {
+    return backend_->scan(get_id, get_the_number_of_id, range, log);
+  }
+
+  virtual bool reboot(std::uint8_t id, const char **log = NULL) override {
+    return instruct(&BusBackend::reboot, id, log);
+  }
+
+  virtual bool clearMultiTurn(std::uint8_t id, const char **log = NULL) override {
+    return instruct(&BusBackend::clearMultiTurn, id, log);
+  }
+
+  virtual bool readRegister(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                            std::uint32_t *data, const char **log = NULL) override {
+    const Clock::time_point start(Clock::now());
+    const char *call_log(NULL);
+    const bool result(backend_->readRegister(id, address, length, data, &call_log));
+    finishTimed(id, start, timing_.read(length), result, call_log, log);
+    return result;
+  }
+
+  virtual bool readRegister(std::uint8_t id, const char *item_name, std::int32_t *data,
+                            const char **log = NULL) override {
+    const char *call_log(NULL);
+    const bool result(backend_->readRegister(id, item_name, data, &call_log));
+    finish(id, result, call_log, log);
+    return result;
+  }
+
+  virtual bool writeRegister(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                             std::uint8_t *data, const char **log = NULL) override {
+    const Clock::time_point start(Clock::now());
+    const char *call_log(NULL);
+    const bool result(backend_->writeRegister(id, address, length, data, &call_log));
+    finishTimed(id, start, timing_.write(length), result, call_log, log);
+    return result;
+  }
+
+  virtual bool itemRead(std::uint8_t id, const char *item_name, std::int32_t *data,
+                        const char **log = NULL) override {
+    const char *call_log(NULL);
+    const bool result(backend_->itemRead(id, item_name, data, &call_log));
+    finish(id, result, call_log, log);
+    return result;
+  }
+
+  virtual bool itemWrite(std::uint8_t id, const char *item_name, std::int32_t data,
+                         const char **log = NULL) override {
+    const char *call_log(NULL);
+    const bool result(backend_->itemWrite(id, item_name, data, &call_log));
+    finish(id, result, call_log, log);
+    return result;
+  }
+
+  virtual bool torqueOn(std::uint8_t id, const char **log = NULL) override {
+    return instruct(&BusBackend::torqueOn, id, log);
+  }
+
+  virtual bool torqueOff(std::uint8_t id, const char **log = NULL) override {
+    return instruct(&BusBackend::torqueOff, id, log);
+  }
+
+  virtual bool setCurrentControlMode(std::uint8_t id, const char **log = NULL) override {
+    return instruct(&BusBackend::setCurrentControlMode, id, log);
+  }
+
+  virtual bool setVelocityControlMode(std::uint8_t id, const char **log = NULL) override {
+    return instruct(&BusBackend::setVelocityControlMode, id, log);
+  }
+
+  virtual bool setPositionControlMode(std::uint8_t id, const char **log = NULL) override {
+    return instruct(&BusBackend::setPositionControlMode, id, log);
+  }
+
+  virtual bool setExtendedPositionControlMode(std::uint8_t id, const char **log = NULL) override {
+    return instruct(&BusBackend::setExtendedPositionControlMode, id, log);
+  }
+
+  virtual bool setCurrentBasedPositionControlMode(std::uint8_t id,
+                                                  const char **log = NULL) override {
+    return instruct(&BusBackend::setCurrentBasedPositionControlMode, id, log);
+  }
+
+  virtual bool setPWMControlMode(std::uint8_t id, const char **log = NULL) override {
+    return instruct(&BusBackend::setPWMControlMode, id, log);
+  }
+
+  //
+  // group instructions. failures are counted for the bus
+  // because DynamixelWorkbench does not tell which actuator has failed.
+  //
+
+  virtual std::uint8_t getTheNumberOfSyncWriteHandler() override {
+    return backend_->getTheNumberOfSyncWriteHandler();
+  }
+
+  virtual bool addSyncWriteHandler(std::uint16_t address, std::uint16_t length,
+                                   const char **log = NULL) override {
+    return backend_->addSyncWriteHandler(address, length, log);
+  }
+
+  // no status packets are returned, so the round trip is not timed
+  virtual bool syncWrite(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                         std::int32_t *data, std::uint8_t data_num_for_each_id,
+                         const char **log = NULL) override {
+    const char *call_log(NULL);
+    const bool result(
+        backend_->syncWrite(index, id, id_num, data, data_num_for_each_id, &call_log));
+    finish(bus_counters_, result, call_log, log);
+    return result;
+  }
+
+  virtual std::uint8_t getTheNumberOfSyncReadHandler() override {
+    return backend_->getTheNumberOfSyncReadHandler();
+  }
+
+  virtual bool addSyncReadHandler(std::uint16_t address, std::uint16_t length,
+                                  const char **log = NULL) override {
+    if (!backend_->addSyncReadHandler(address, length, log)) {
+      return false;
+    }
+    sync_read_lengths_.push_back(length);
+    return true;
+  }
+
+  virtual bool syncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                        const char **log = NULL) override {
+    const Clock::time_point start(Clock::now());
+    const char *call_log(NULL);
+    const bool result(backend_->syncRead(index, id, id_num, &call_log));
+    const std::uint16_t length(index < sync_read_lengths_.size() ? sync_read_lengths_[index]
+                                                                 : 0);
+    finishTimed(bus_counters_, start, timing_.syncRead(id_num, length), result, call_log, log);
+    return result;
+  }
+
+  // Fast Sync Read & split SyncRead are not timed because their status packets
+  // do not follow BusTiming's estimate, or arrive while the caller does other work
+  virtual bool supportsFastSyncRead() override { return backend_->supportsFastSyncRead(); }
+
+  virtual bool fastSyncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                            const char **log = NULL) override {
+    return forward(&BusBackend::fastSyncRead, index, id, id_num, log);
+  }
+
+  virtual bool supportsSplitSyncRead() override { return backend_->supportsSplitSyncRead(); }
+
+  virtual bool beginSyncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                             const char **log = NULL) override {
+    return backend_->beginSyncRead(index, id, id_num, log);
+  }
+
+  virtual bool beginFastSyncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                                 const char **log = NULL) override {
+    return backend_->beginFastSyncRead(index, id, id_num, log);
+  }
+
+  virtual bool finishSyncRead(std::uint8_t index, const char **log = NULL) override {
+    const char *call_log(NULL);
+    const bool result(backend_->finishSyncRead(index, &call_log));
+    finish(bus_counters_, result, call_log, log);
+    return result;
+  }
+
+  virtual bool getSyncReadData(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                               std::uint16_t address, std::uint16_t length, std::int32_t *data,
+                               const char **log = NULL) override {
+    return backend_->getSyncReadData(index, id, id_num, address, length, data, log);
+  }
+
+  virtual bool initBulkRead(const char **log = NULL) override {
+    n_bulk_read_params_ = bulk_read_length_ = 0;
+    return backend_->initBulkRead(log);
+  }
+
+  virtual bool addBulkReadParam(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                                const char **log = NULL) override {
+    if (!backend_->addBulkReadParam(id, address, length, log)) {
+      return false;
+    }
+    ++n_bulk_read_params_;
+    bulk_read_length_ += length;
+    return true;
+  }
+
+  virtual bool bulkRead(const char **log = NULL) override {
+    const Clock::time_point start(Clock::now());
+    const char *call_log(NULL);
+    const bool result(backend_->bulkRead(&call_log));
+    finishTimed(bus_counters_, start, timing_.bulkRead(n_bulk_read_params_, bulk_read_length_),
+                result, call_log, log);
+    return result;
+  }
+
+  virtual bool getBulkReadData(std::uint8_t *id, std::uint8_t id_num, std::uint16_t *address,
+                               std::uint16_t *length, std::int32_t *data,
+                               const char **log = NULL) override {
+    return backend_->getBulkReadData(id, id_num, address, length, data, log);
+  }
+
+  virtual bool clearBulkReadParam() override {
+    n_bulk_read_params_ = bulk_read_length_ = 0;
+    return backend_->clearBulkReadParam();
+  }
+
+  virtual bool initBulkWrite(const char **log = NULL) override {
+    return backend_->initBulkWrite(log);
+  }
+
+  virtual bool addBulkWriteParam(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                                 std::int32_t data, const char **log = NULL) override {
+    return backend_->addBulkWriteParam(id, address, length, data, log);
+  }
+
+  virtual bool bulkWrite(const char **log = NULL) override {
+    const char *call_log(NULL);
+    const bool result(backend_->bulkWrite(&call_log));
+    finish(bus_counters_, result, call_log, log);
+    return result;
+  }
+
+  //
+  // summarizing side
+  //
+
+  // the average round trip & airtime of timed transactions in the last summary
+  std::int32_t getRttUs() const { return rtt_us_; }
+
+  std::int32_t getAirtimeUs() const { return airtime_us_; }
+
+  // register handles of the bus like "<prefix>/rtt_us". call on init.
+  void registerTo(hie::Int32StateInterface *const iface, const std::string &prefix) {
+    iface->registerHandle(hie::Int32StateHandle(prefix + "/rtt_us", &rtt_us_));
+    iface->registerHandle(hie::Int32StateHandle(prefix + "/airtime_us", &airtime_us_));
+    iface->registerHandle(hie::Int32StateHandle(prefix + "/latency_warning", &latency_warning_));
+    bus_summary_.registerTo(iface, prefix);
+  }
+
+  // register handles of the actuator like "<name>/diagnostics/timeouts". call on init.
+  void registerTo(hie::Int32StateInterface *const iface, const std::string &name,
+                  const std::uint8_t id) {
+    Summary &summary(summaries_[id]);
+    summary.name = name;
+    summary.id = id;
+    summary.registerTo(iface, name + "/diagnostics");
+  }
+
+  // update values bound to handles with transactions since the last call.
+  // rising warnings are reported to the log, or logged immediately if NULL.
+  void summarize(ErrorLog *const error_log) {
+    const std::uint64_t n_timed(n_timed_.exchange(0, std::memory_order_relaxed)),
+        rtt_sum_us(rtt_sum_us_.exchange(0, std::memory_order_relaxed)),
+        airtime_sum_us(airtime_sum_us_.exchange(0, std::memory_order_relaxed));
+    if (n_timed > 0) {
+      rtt_us_ = static_cast< std::int32_t >(rtt_sum_us / n_timed);
+      airtime_us_ = static_cast< std::int32_t >(airtime_sum_us / n_timed);
+      const bool is_late(rtt_us_ - airtime_us_ > max_excess_latency_ * 1e6);
+      if (is_late && !latency_warning_) {
+        char log[ErrorEntry::LOG_LENGTH];
+        std::snprintf(log, sizeof(log), "%d us per round trip against %d us of airtime",
+                      rtt_us_, airtime_us_);
+        ErrorLog::report(error_log,
+                         ErrorEntry("DiagnosingBackend::summarize",
+                                    "Round trips take much longer than their airtime. "
+                                    "Check the latency timer of the USB serial converter",
+                                    NULL, NULL, -1, -1, log));
+      }
+      latency_warning_ = is_late ? 1 : 0;
+    }
+
+    bus_summary_.update(bus_counters_, max_error_rate_, error_log);
+    for (std::map< std::uint8_t, Summary >::value_type &summary : summaries_) {
+      summary.second.update(counters_[summary.first], max_error_rate_, error_log);
+    }
+  }
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  // failures of transactions recorded by a call
+  struct Counters {
+    Counters() : n_transactions(0), n_timeouts(0), n_corrupts(0), n_others(0) {}
+
+    void count(const bool result, const char *const log) {
+      n_transactions.fetch_add(1, std::memory_order_relaxed);
+      if (result) {
+        return;
+      }
+      // strings of DynamixelSDK's PacketHandler::getTxRxResult()
+      if (log && std::strstr(log, "There is no status packet")) {
+        n_timeouts.fetch_add(1, std::memory_order_relaxed);
+      } else if (log && std::strstr(log, "Incorrect status packet")) {
+        n_corrupts.fetch_add(1, std::memory_order_relaxed);
+      } else {
+        n_others.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    std::atomic< std::uint32_t > n_transactions, n_timeouts, n_corrupts, n_others;
+  };
+
+  // summarized values bound to hardware handles
+  struct Summary {
+    Summary()
+        : id(-1), transactions(0), timeouts(0), corrupt_packets(0), error_permille(0),
+          error_warning(0), n_last_transactions(0), n_last_errors(0) {}
+
+    void registerTo(hie::Int32StateInterface *const iface, const std::string &prefix) {
+      iface->registerHandle(hie::Int32StateHandle(prefix + "/transactions", &transactions));
+      iface->registerHandle(hie::Int32StateHandle(prefix + "/timeouts", &timeouts));
+      iface->registerHandle(
+          hie::Int32StateHandle(prefix + "/corrupt_packets", &corrupt_packets));
+      iface->registerHandle(hie::Int32StateHandle(prefix + "/error_permille", &error_permille));
+      iface->registerHandle(hie::Int32StateHandle(prefix + "/error_warning", &error_warning));
+    }
+
+    // the error rate is of transactions since the last update
+    void update(const Counters &counters, const double max_error_rate, ErrorLog *const error_log) {
+      const std::uint32_t n_transactions(counters.n_transactions.load(std::memory_order_relaxed)),
+          n_timeouts(counters.n_timeouts.load(std::memory_order_relaxed)),
+          n_corrupts(counters.n_corrupts.load(std::memory_order_relaxed)),
+          n_errors(n_timeouts + n_corrupts + counters.n_others.load(std::memory_order_relaxed));
+      transactions = static_cast< std::int32_t >(n_transactions);
+      timeouts = static_cast< std::int32_t >(n_timeouts);
+      corrupt_packets = static_cast< std::int32_t >(n_corrupts);
+      const std::uint32_t n_new_transactions(n_transactions - n_last_transactions),
+          n_new_errors(n_errors - n_last_errors);
+      n_last_transactions = n_transactions;
+      n_last_errors = n_errors;
+      if (n_new_transactions == 0) {
+        return;
+      }
+      const double error_rate(static_cast< double >(n_new_errors) / n_new_transactions);
+      error_permille = static_cast< std::int32_t >(error_rate * 1000.);
+      const bool is_failing(error_rate > max_error_rate);
+      if (is_failing && !error_warning) {
+        char log[ErrorEntry::LOG_LENGTH];
+        std::snprintf(log, sizeof(log),
+                      "%u of %u transactions failed (%d timeouts & %d corrupt packets in total)",
+                      n_new_errors, n_new_transactions, timeouts, corrupt_packets);
+        ErrorLog::report(error_log,
+                         ErrorEntry("DiagnosingBackend::summarize",
+                                    "The error rate exceeds the threshold. Check the cabling",
+                                    NULL, name.empty() ? NULL : name.c_str(), id, -1, log));
+      }
+      error_warning = is_failing ? 1 : 0;
+    }
+
+    // the actuator, or none for the bus
+    std::string name;
+    int id;
+    std::int32_t transactions, timeouts, corrupt_packets, error_permille, error_warning;
+    std::uint32_t n_last_transactions, n_last_errors;
+  };
+
+  bool instruct(bool (BusBackend::*const func)(std::uint8_t, const char **), const std::uint8_t id,
+                const char **const log) {
+    const char *call_log(NULL);
+    const bool result(((*backend_).*func)(id, &call_log));
+    finish(id, result, call_log, log);
+    return result;
+  }
+
+  bool forward(bool (BusBackend::*const func)(std::uint8_t, std::uint8_t *, std::uint8_t,
+                                              const char **),
+               const std::uint8_t index, std::uint8_t *const id, const std::uint8_t id_num,
+               const char **const log) {
+    const char *call_log(NULL);
+    const bool result(((*backend_).*func)(index, id, id_num, &call_log));
+    finish(bus_counters_, result, call_log, log);
+    return result;
+  }
+
+  // count the transaction to the actuator for both the actuator & the bus
+  void finish(const std::uint8_t id, const bool result, const char *const call_log,
+              const char **const log) {
+    counters_[id].count(result, call_log);
+    finish(bus_counters_, result, call_log, log);
+  }
+
+  void finish(Counters &counters, const bool result, const char *const call_log,
+              const char **const log) {
+    counters.count(result, call_log);
+    if (log) {
+      *log = call_log;
+    }
+  }
+
+  // failed transactions are not timed because they wait for the timeout
+  void finishTimed(const std::uint8_t id, const Clock::time_point &start, const double airtime,
+                   const bool result, const char *const call_log, const char **const log) {
+    time(start, airtime, result);
+    finish(id, result, call_log, log);
+  }
+
+  void finishTimed(Counters &counters, const Clock::time_point &start, const double airtime,
+                   const bool result, const char *const call_log, const char **const log) {
+    time(start, airtime, result);
+    finish(counters, result, call_log, log);
+  }
+
+  void time(const Clock::time_point &start, const double airtime, const bool result) {
+    if (!result) {
+      return;
+    }
+    const long long rtt_us(
+        std::chrono::duration_cast< std::chrono::microseconds >(Clock::now() - start).count());
+    n_timed_.fetch_add(1, std::memory_order_relaxed);
+    rtt_sum_us_.fetch_add(rtt_us > 0 ? rtt_us : 0, std::memory_order_relaxed);
+    airtime_sum_us_.fetch_add(static_cast< std::uint64_t >(airtime * 1e6),
+                              std::memory_order_relaxed);
+  }
+
+private:
+  const BusBackendPtr backend_;
+  BusTiming timing_;
+  const double max_excess_latency_, max_error_rate_;
+
+  // blocks of group reads to estimate their airtime, updated on init & the bus thread
+  std::vector< std::uint16_t > sync_read_lengths_;
+  std::size_t n_bulk_read_params_, bulk_read_length_;
+
+  // recorded values
+  Counters counters_[256], bus_counters_;
+  std::atomic< std::uint64_t > n_timed_, rtt_sum_us_, airtime_sum_us_;
+
+  // summarized values bound to hardware handles
+  std::int32_t rtt_us_, airtime_us_, latency_warning_;
+  Summary bus_summary_;
+  std::map< std::uint8_t, Summary > summaries_;
+};
+
+typedef std::shared_ptr< DiagnosingBackend > DiagnosingBackendPtr;
+typedef std::shared_ptr< const DiagnosingBackend > DiagnosingBackendConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef LAYERED_HARDWARE_DYNAMIXEL_DYNAMIXEL_ACTUATOR_HPP
 #define LAYERED_HARDWARE_DYNAMIXEL_DYNAMIXEL_ACTUATOR_HPP
 
+#include <cstddef>
 #include <cstdint>
 #include <list>
 #include <map>
@@ -13,16 +14,20 @@
 #include <hardware_interface/controller_info.h>
 #include <hardware_interface/robot_hw.h>
 #include <hardware_interface_extensions/integer_interface.hpp>
+#include <layered_hardware_dynamixel/capability_cache.hpp>
 #include <layered_hardware_dynamixel/clear_multi_turn_mode.hpp>
 #include <layered_hardware_dynamixel/common_namespaces.hpp>
+#include <layered_hardware_dynamixel/control_table.hpp>
 #include <layered_hardware_dynamixel/controller_set.hpp>
 #include <layered_hardware_dynamixel/current_based_position_mode.hpp>
 #include <layered_hardware_dynamixel/current_mode.hpp>
 #include <layered_hardware_dynamixel/dynamixel_actuator_data.hpp>
+#include <layered_hardware_dynamixel/dynamixel_actuator_store.hpp>
 #include <layered_hardware_dynamixel/extended_position_mode.hpp>
 #include <layered_hardware_dynamixel/operating_mode_base.hpp>
 #include <layered_hardware_dynamixel/position_mode.hpp>
 #include <layered_hardware_dynamixel/reboot_mode.hpp>
+#include <layered_hardware_dynamixel/state_estimator.hpp>
 #include <layered_hardware_dynamixel/torque_disable_mode.hpp>
 #include <layered_hardware_dynamixel/velocity_mode.hpp>
 #include <ros/console.h>
@@ -31,12 +36,13 @@
 #include <ros/node_handle.h>
 #include <ros/param.h>
 #include <ros/time.h>
+#include <xmlrpcpp/XmlRpcValue.h>
 
 namespace layered_hardware_dynamixel {
 
 class DynamixelActuator {
 public:
-  DynamixelActuator() {}
+  DynamixelActuator() : capability_(NULL), is_switching_(false) {}
 
   virtual ~DynamixelActuator() {
     // finalize the present mode
@@ -49,8 +55,18 @@ public:
     }
   }
 
-  bool init(const std::string &name, DynamixelWorkbench *const dxl_wb, hi::RobotHW *const hw,
-            const ros::NodeHandle &param_nh) {
+  // states & commands of the actuator are bound to the index-th elements of the store.
+  // if handle_store is given, hardware handles are bound to the elements of handle_store instead
+  // so that another thread can operate the actuator while the control thread accesses handles.
+  // then the layer exchanges values in the stores, and additional values are exchanged
+  // by get/setAdditionalStates() & get/setAdditionalCommands().
+  // if capability_cache is given, items & scales are taken from or recorded to the entry
+  // for the port, the id, the model number & the firmware version of the actuator.
+  bool init(const std::string &name, BusBackend *const dxl_wb, hi::RobotHW *const hw,
+            const ros::NodeHandle &param_nh, ControllerIds *const controller_ids,
+            DynamixelActuatorStore *const store, const std::size_t index,
+            DynamixelActuatorStore *const handle_store = NULL,
+            CapabilityCache *const capability_cache = NULL, const std::string &port = "") {
     // dynamixel id from param
     int id;
     if (!param_nh.getParam("id", id)) {
@@ -59,9 +75,12 @@ public:
       return false;
     }
 
-    // find dynamixel actuator by id
-    std::uint16_t model_number;
-    if (!dxl_wb->ping(id, &model_number)) {
+    // find dynamixel actuator by id unless the bus has already discovered it.
+    // either way, the model number is the one answered by the ping.
+    std::uint16_t model_number(0);
+    if (dxl_wb->getModelName(id)) {
+      model_number = dxl_wb->getModelNumber(id);
+    } else if (!dxl_wb->ping(id, &model_number)) {
       ROS_ERROR_STREAM("DynamixelActuator::init(): Failed to ping the actuator '"
                        << name << "' (id: " << static_cast< int >(id) << ")");
       return false;
@@ -75,38 +94,156 @@ public:
       return false;
     }
 
-    // names of additinal states & commands from param (optional)
-    const std::vector< std::string > additional_state_names(
-        param_nh.param("additional_states", std::vector< std::string >()));
+    // names & polling intervals of additinal states from param (optional)
+    std::vector< Int32StateItem > additional_states;
+    if (!getAdditionalStatesParam(param_nh, "additional_states", &additional_states)) {
+      return false;
+    }
+
+    // names of additinal commands from param (optional)
     const std::vector< std::string > additional_cmd_names(
         param_nh.param("additional_commands", std::vector< std::string >()));
 
     // allocate data structure
-    data_.reset(new DynamixelActuatorData(name, dxl_wb, id, torque_constant, additional_state_names,
-                                          additional_cmd_names));
+    data_.reset(new DynamixelActuatorData(name, dxl_wb, id, torque_constant, store, index,
+                                          additional_states, additional_cmd_names));
+
+    // dead-bands of commands from param (optional)
+    data_->pos_dead_band = param_nh.param("dead_band/position", 0.);
+    data_->vel_dead_band = param_nh.param("dead_band/velocity", 0.);
+    data_->eff_dead_band = param_nh.param("dead_band/effort", 0.);
+
+    // extrapolation of the position over cycles without readings (optional)
+    if (param_nh.hasParam("extrapolation")) {
+      const int max_stale_cycles(param_nh.param("extrapolation/max_stale_cycles", 10));
+      const double correction_gain(param_nh.param("extrapolation/correction_gain", 1.));
+      if (max_stale_cycles < 0 || correction_gain <= 0. || correction_gain > 1.) {
+        ROS_ERROR_STREAM("DynamixelActuator::init(): Param '"
+                         << param_nh.resolveName("extrapolation/max_stale_cycles")
+                         << "' must be non-negative, and param '"
+                         << param_nh.resolveName("extrapolation/correction_gain")
+                         << "' must be in (0, 1]");
+        return false;
+      }
+      estimator_.reset(new StateEstimator(max_stale_cycles, correction_gain));
+    }
+
+    // look up items & scales resolved by previous runs if enabled.
+    // the model number from the ping & the firmware version read here are the key
+    // because a model name from DynamixelWorkbench's table may be shared by variants.
+    // the firmware version is kept for bus setups not to read it again.
+    // this saves lookups in DynamixelWorkbench's tables, not transactions on the bus.
+    capability_ = NULL;
+    if (capability_cache) {
+      std::int32_t firmware_version;
+      const char *log(NULL);
+      if (dxl_wb->readRegister(id, "Firmware_Version", &firmware_version, &log)) {
+        data_->firmware_version = firmware_version;
+        bool is_cached;
+        capability_ =
+            capability_cache->get(port, id, model_number, firmware_version, &is_cached);
+        if (is_cached) {
+          ROS_INFO_STREAM("DynamixelActuator::init(): Using the cached capability for the "
+                          "actuator '"
+                          << name << "' (model number: " << model_number
+                          << ", firmware version: " << firmware_version << ")");
+        }
+      } else {
+        ROS_WARN_STREAM("DynamixelActuator::init(): Failed to read the firmware version of the "
+                        "actuator '"
+                        << name << "' (id: " << static_cast< int >(id)
+                        << "). Resolving its capability without the cache: "
+                        << (log ? log : "No log from DynamixelWorkbench::readRegister()"));
+      }
+    }
+
+    // use the compile-time control table if the model family is known
+    data_->control_table = ControlTable::find(dxl_wb->getModelName(id));
+    if (data_->control_table) {
+      ROS_INFO_STREAM("DynamixelActuator::init(): Using the compile-time "
+                      << data_->control_table->family << " control table for the actuator '"
+                      << name << "'");
+    }
+
+    // resolve control table items used in read & write cycles.
+    // items for the core states & commands are optional because some models do not have them.
+    // operating modes will complain if they use unavailable items.
+    resolveItem(&data_->present_pos_item, /* verbose = */ false);
+    resolveItem(&data_->present_vel_item, false);
+    resolveItem(&data_->present_eff_item, false);
+    resolveItem(&data_->goal_pos_item, false);
+    if (!resolveItem(&data_->goal_vel_item, false)) {
+      // Protocol 1.0 models name the goal velocity differently
+      data_->goal_vel_item.name = "Moving_Speed";
+      resolveItem(&data_->goal_vel_item, false);
+    }
+    resolveItem(&data_->goal_eff_item, false);
+    resolveItem(&data_->profile_vel_item, false);
+    for (Int32StateItem &state : data_->additional_states) {
+      if (!resolveItem(&state.info)) {
+        return false;
+      }
+    }
+    for (Int32Item &cmd : data_->additional_cmds) {
+      if (!resolveItem(&cmd.info)) {
+        return false;
+      }
+    }
+
+    // whether the model has the present current is fixed once items are resolved,
+    // so that reading states never checks it again
+    data_->has_eff = data_->present_eff_item.isAvailable();
+
+    // precompute scales for conversion between raw values & SI units (optional)
+    data_->uses_scales = initScales();
+    capability_ = NULL;
+
+    // data bound to hardware handles
+    handle_data_ = (handle_store && handle_store != store)
+                       ? std::make_shared< DynamixelActuatorData >(
+                             name, dxl_wb, id, torque_constant, handle_store, index,
+                             data_->additional_states, additional_cmd_names)
+                       : data_;
 
     // register actuator states & commands to corresponding hardware interfaces
-    const hi::ActuatorStateHandle state_handle(data_->name, &data_->pos, &data_->vel, &data_->eff);
+    const hi::ActuatorStateHandle state_handle(handle_data_->name, &handle_data_->pos,
+                                               &handle_data_->vel, &handle_data_->eff);
     if (!registerActuatorTo< hi::ActuatorStateInterface >(hw, state_handle) ||
         !registerActuatorTo< hi::PositionActuatorInterface >(
-            hw, hi::ActuatorHandle(state_handle, &data_->pos_cmd)) ||
+            hw, hi::ActuatorHandle(state_handle, &handle_data_->pos_cmd)) ||
         !registerActuatorTo< hi::VelocityActuatorInterface >(
-            hw, hi::ActuatorHandle(state_handle, &data_->vel_cmd)) ||
+            hw, hi::ActuatorHandle(state_handle, &handle_data_->vel_cmd)) ||
         !registerActuatorTo< hi::EffortActuatorInterface >(
-            hw, hi::ActuatorHandle(state_handle, &data_->eff_cmd))) {
+            hw, hi::ActuatorHandle(state_handle, &handle_data_->eff_cmd))) {
+      return false;
+    }
+
+    // register the progress of rebooting, the health & the staleness of the position
+    if (!registerActuatorTo< hie::Int32StateInterface >(
+            hw, hie::Int32StateHandle(data_->name + "/reboot_status",
+                                      &handle_data_->reboot_status)) ||
+        !registerActuatorTo< hie::Int32StateInterface >(
+            hw, hie::Int32StateHandle(data_->name + "/health_status",
+                                      &handle_data_->health_status)) ||
+        !registerActuatorTo< hie::Int32StateInterface >(
+            hw, hie::Int32StateHandle(data_->name + "/consecutive_failures",
+                                      &handle_data_->consecutive_failures)) ||
+        !registerActuatorTo< hie::Int32StateInterface >(
+            hw, hie::Int32StateHandle(data_->name + "/stale_cycles",
+                                      &handle_data_->stale_cycles))) {
       return false;
     }
 
     // register additional states & commands to corresponding hardware interfaces
-    for (std::map< std::string, std::int32_t >::value_type &state : data_->additional_states) {
+    for (Int32StateItem &state : handle_data_->additional_states) {
       if (!registerActuatorTo< hie::Int32StateInterface >(
-              hw, hie::Int32StateHandle(data_->name + "/" + state.first, &state.second))) {
+              hw, hie::Int32StateHandle(data_->name + "/" + state.info.name, &state.value))) {
         return false;
       }
     }
-    for (std::map< std::string, std::int32_t >::value_type &cmd : data_->additional_cmds) {
+    for (Int32Item &cmd : handle_data_->additional_cmds) {
       if (!registerActuatorTo< hie::Int32Interface >(
-              hw, hie::Int32Handle(data_->name + "/" + cmd.first, &cmd.second, &cmd.second))) {
+              hw, hie::Int32Handle(data_->name + "/" + cmd.info.name, &cmd.value, &cmd.value))) {
         return false;
       }
     }
@@ -138,7 +275,21 @@ public:
                          << "' (id: " << static_cast< int >(data_->id) << ")");
         return false;
       }
-      mode_map_[controller_names] = mode;
+      // the states to be read by the mode from param (optional)
+      const std::string read_states_key(ros::names::append("read_states", mode_name.second));
+      if (param_nh.hasParam(read_states_key)) {
+        std::uint8_t read_mask;
+        if (!getReadMaskParam(param_nh, read_states_key, &read_mask)) {
+          return false;
+        }
+        mode->setReadMask(read_mask);
+      }
+      // controllers required by the mode as a set of interned ids
+      ControllerSet controllers;
+      for (const std::string &controller_name : controller_names) {
+        controllers.insert(controller_ids->intern(controller_name));
+      }
+      addMode(controllers, mode);
     }
 
     return true;
@@ -147,8 +298,7 @@ public:
   bool prepareSwitch(const ControllerSet &controllers) {
     // check if switching is possible by counting number of operating modes after switching
     std::size_t n_modes(0);
-    for (const std::map< std::vector< std::string >, OperatingModePtr >::value_type &mode :
-         mode_map_) {
+    for (const std::pair< ControllerSet, OperatingModePtr > &mode : mode_table_) {
       if (controllers.contains(mode.first)) {
         ++n_modes;
         if (n_modes > 1) {
@@ -160,12 +310,19 @@ public:
   }
 
   void doSwitch(const ControllerSet &controllers) {
+    beginSwitch(controllers);
+    endSwitch();
+  }
+
+  // switch modes in two steps so that the layer can batch writes to enable the next modes
+  // among actuators between them. beginSwitch() stops the present mode and
+  // lets the next mode write (or defer) its mode-enable sequence, then endSwitch() starts it.
+  void beginSwitch(const ControllerSet &controllers) {
     // find the next mode to run by the list of running controllers after switching
-    OperatingModePtr next_mode;
-    for (const std::map< std::vector< std::string >, OperatingModePtr >::value_type &mode :
-         mode_map_) {
+    next_mode_ = OperatingModePtr();
+    for (const std::pair< ControllerSet, OperatingModePtr > &mode : mode_table_) {
       if (controllers.contains(mode.first)) {
-        next_mode = mode.second;
+        next_mode_ = mode.second;
         // no more iterations are required because prepareSwitch() ensures
         // there is one match at the maximum
         break;
@@ -173,30 +330,119 @@ public:
     }
 
     // do nothing if no mode switching is required
-    if (next_mode == present_mode_) {
+    is_switching_ = (next_mode_ != present_mode_);
+    if (!is_switching_) {
       return;
     }
 
-    // switch modes
+    // switch modes. the present mode's torque-off is deferred until the next mode
+    // has written, which may keep the torque on in the same operating mode.
+    data_->defers_torque_off = static_cast< bool >(next_mode_);
     if (present_mode_) {
-      ROS_INFO_STREAM("DynamixelActuator::doSwitch(): Stopping operating mode '"
+      ROS_INFO_STREAM("DynamixelActuator::beginSwitch(): Stopping operating mode '"
                       << present_mode_->getName() << "' for the actuator '" << data_->name
                       << "' (id: " << static_cast< int >(data_->id) << ")");
       present_mode_->stopping();
     }
-    if (next_mode) {
-      ROS_INFO_STREAM("DynamixelActuator::doSwitch(): Starting operating mode '"
-                      << next_mode->getName() << "' for the actuator '" << data_->name
+    data_->defers_torque_off = false;
+    if (next_mode_) {
+      next_mode_->startWriting();
+    }
+    if (present_mode_) {
+      present_mode_->finishStopping();
+    }
+  }
+
+  void endSwitch() {
+    if (!is_switching_) {
+      return;
+    }
+    is_switching_ = false;
+
+    // states prefetched in the previous mode may not cover ones the next mode reads
+    data_->has_prefetched_states = false;
+    data_->stale_cycles = 0;
+    if (estimator_) {
+      estimator_->reset();
+    }
+    data_->read_mask =
+        next_mode_ ? next_mode_->getReadMask() : static_cast< std::uint8_t >(READ_NONE);
+    if (next_mode_) {
+      ROS_INFO_STREAM("DynamixelActuator::endSwitch(): Starting operating mode '"
+                      << next_mode_->getName() << "' for the actuator '" << data_->name
                       << "' (id: " << static_cast< int >(data_->id) << ")");
-      next_mode->starting();
+      next_mode_->starting();
+    }
+    present_mode_ = next_mode_;
+    next_mode_ = OperatingModePtr();
+  }
+
+  DynamixelActuatorDataPtr getData() const { return data_; }
+
+  // mark additional states to be read in the cycle
+  void scheduleRead(const std::uint64_t cycle) {
+    for (Int32StateItem &state : data_->additional_states) {
+      state.is_due = ((cycle + state.phase) % state.every == 0) || state.is_deferred;
+    }
+  }
+
+  //
+  // exchange of additional values between the actuator data and the data bound to
+  // hardware handles. values are stored in series from the given pointers.
+  // other values are exchanged by the layer's store.
+  //
+
+  void getAdditionalStates(std::int32_t *const values) const {
+    for (std::size_t i = 0; i < data_->additional_states.size(); ++i) {
+      values[i] = data_->additional_states[i].value;
+    }
+  }
+
+  void setAdditionalStates(const std::int32_t *const values) {
+    for (std::size_t i = 0; i < handle_data_->additional_states.size(); ++i) {
+      handle_data_->additional_states[i].value = values[i];
+    }
+  }
+
+  void getAdditionalCommands(std::int32_t *const values) const {
+    for (std::size_t i = 0; i < handle_data_->additional_cmds.size(); ++i) {
+      values[i] = handle_data_->additional_cmds[i].value;
+    }
+  }
+
+  void setAdditionalCommands(const std::int32_t *const values) {
+    for (std::size_t i = 0; i < data_->additional_cmds.size(); ++i) {
+      data_->additional_cmds[i].value = values[i];
+    }
+  }
+
+  // copy additional states & commands to the data bound to hardware handles.
+  // operating modes may initialize commands on switching, so handles must follow them.
+  void updateHandles() {
+    if (handle_data_ == data_) {
+      return;
+    }
+    for (std::size_t i = 0; i < data_->additional_states.size(); ++i) {
+      handle_data_->additional_states[i].value = data_->additional_states[i].value;
+    }
+    for (std::size_t i = 0; i < data_->additional_cmds.size(); ++i) {
+      handle_data_->additional_cmds[i].value = data_->additional_cmds[i].value;
     }
-    present_mode_ = next_mode;
   }
 
   void read(const ros::Time &time, const ros::Duration &period) {
-    if (present_mode_) {
-      present_mode_->read(time, period);
+    if (!present_mode_) {
+      return;
     }
+    data_->has_fresh_pos = data_->has_fresh_vel = false;
+    present_mode_->read(time, period);
+    if (!(data_->read_mask & READ_POSITION)) {
+      return;
+    }
+    if (estimator_) {
+      estimator_->update(data_.get(), period);
+    }
+    data_->stale_cycles = data_->has_fresh_pos ? 0 : data_->stale_cycles + 1;
   }
 
   void write(const ros::Time &time, const ros::Duration &period) {
@@ -217,6 +463,143 @@ private:
     return true;
   }
 
+  // resolve the item from the cached capability if any, or record the result to it
+  bool resolveItem(ItemInfo *const item, const bool verbose = true) const {
+    if (!capability_) {
+      return lookUpItem(item, verbose);
+    }
+    const CapabilityCache::Items::const_iterator cached(capability_->items.find(item->name));
+    if (cached != capability_->items.end()) {
+      item->address = cached->second.first;
+      item->length = cached->second.second;
+      if (!item->isAvailable() && verbose) {
+        ROS_ERROR_STREAM("DynamixelActuator::resolveItem(): The control table item '"
+                         << item->name << "' is cached as unavailable on the actuator '"
+                         << data_->name << "' (id: " << static_cast< int >(data_->id) << ")");
+      }
+      return item->isAvailable();
+    }
+    // a failed lookup leaves the item unavailable (length 0), which is also cached
+    const bool result(lookUpItem(item, verbose));
+    capability_->items[item->name] = std::make_pair(item->address, item->length);
+    capability_->is_modified = true;
+    return result;
+  }
+
+  bool lookUpItem(ItemInfo *const item, const bool verbose) const {
+    // items missing in the compile-time table may still be in DynamixelWorkbench's one
+    if (data_->control_table) {
+      const ControlTableItem *const table_item(
+          data_->control_table->find_item(item->name.c_str()));
+      if (table_item) {
+        item->address = table_item->address;
+        item->length = table_item->length;
+        return true;
+      }
+    }
+    const char *log(NULL);
+    const ControlItem *const info(data_->dxl_wb->getItemInfo(data_->id, item->name.c_str(), &log));
+    if (!info) {
+      if (verbose) {
+        ROS_ERROR_STREAM("DynamixelActuator::resolveItem(): Failed to find control table item '"
+                         << item->name << "' of the actuator '" << data_->name
+                         << "' (id: " << static_cast< int >(data_->id)
+                         << "): " << (log ? log : "No log from DynamixelWorkbench::getItemInfo()"));
+      }
+      return false;
+    }
+    item->address = info->address;
+    item->length = info->data_length;
+    return true;
+  }
+
+  // take the scales from the cached capability if any, or record the resolved ones to it
+  bool initScales() const {
+    UnitScales scales;
+    if (capability_ && capability_->has_scales) {
+      if (!capability_->uses_scales) {
+        return false;
+      }
+      scales = capability_->scales;
+    } else {
+      const bool result(resolveScales(&scales));
+      if (capability_) {
+        capability_->has_scales = true;
+        capability_->uses_scales = result;
+        capability_->scales = scales;
+        capability_->is_modified = true;
+      }
+      if (!result) {
+        return false;
+      }
+    }
+    DynamixelActuatorStore &store(*data_->store);
+    const std::size_t i(data_->index);
+    store.pos_zero_value[i] = scales.pos_zero_value;
+    store.pos_scale_plus[i] = scales.pos_scale_plus;
+    store.pos_scale_minus[i] = scales.pos_scale_minus;
+    store.vel_scale[i] = scales.vel_scale;
+    // mA -> N*m
+    store.eff_scale[i] = scales.current_scale * data_->torque_constant / 1000.0;
+    initInverseScales();
+    return true;
+  }
+
+  // the scales follow DynamixelWorkbench::convert*() which are linear on Protocol 2.0.
+  // known model families take them from the compile-time control table instead.
+  // Protocol 1.0 models encode directions differently, so they keep using DynamixelWorkbench.
+  bool resolveScales(UnitScales *const scales) const {
+    if (data_->dxl_wb->getProtocolVersion() != 2.0) {
+      return false;
+    }
+    if (data_->control_table) {
+      const ControlTable &table(*data_->control_table);
+      scales->pos_zero_value = table.pos_zero_value;
+      scales->pos_scale_plus = table.pos_scale_plus;
+      scales->pos_scale_minus = table.pos_scale_minus;
+      scales->vel_scale = table.vel_scale;
+      scales->current_scale = table.current_scale;
+      return true;
+    }
+    const ModelInfo *const info(data_->dxl_wb->getModelInfo(data_->id));
+    if (!info || info->value_of_max_radian_position == info->value_of_zero_radian_position ||
+        info->value_of_min_radian_position == info->value_of_zero_radian_position ||
+        info->max_radian == 0. || info->min_radian == 0.) {
+      return false;
+    }
+    scales->pos_zero_value = info->value_of_zero_radian_position;
+    scales->pos_scale_plus = info->max_radian / static_cast< double >(
+                                                    info->value_of_max_radian_position -
+                                                    info->value_of_zero_radian_position);
+    scales->pos_scale_minus = info->min_radian / static_cast< double >(
+                                                     info->value_of_min_radian_position -
+                                                     info->value_of_zero_radian_position);
+    // the conversion functions are linear, so the values for 1 are the scales
+    scales->vel_scale = data_->dxl_wb->convertValue2Velocity(data_->id, 1);
+    scales->current_scale = data_->dxl_wb->convertValue2Current(data_->id, 1);
+    return scales->vel_scale != 0. && scales->current_scale != 0.;
+  }
+
+  void initInverseScales() const {
+    DynamixelActuatorStore &store(*data_->store);
+    const std::size_t i(data_->index);
+    store.pos_inv_scale_plus[i] = 1. / store.pos_scale_plus[i];
+    store.pos_inv_scale_minus[i] = 1. / store.pos_scale_minus[i];
+    store.vel_inv_scale[i] = 1. / store.vel_scale[i];
+    store.eff_inv_scale[i] = 1. / store.eff_scale[i];
+  }
+
+  // add the mode to the table. the mode replaces one required by the same controllers.
+  void addMode(const ControllerSet &controllers, const OperatingModePtr &mode) {
+    for (std::pair< ControllerSet, OperatingModePtr > &entry : mode_table_) {
+      if (entry.first.contains(controllers) && controllers.contains(entry.first)) {
+        entry.second = mode;
+        return;
+      }
+    }
+    mode_table_.push_back(std::make_pair(controllers, mode));
+  }
+
   static std::vector< std::string > resolveControllerNames(const std::string &key) {
     // try resolving the key as a controller group name
     // by searching "<node_ns>/controller_group/<key>"
@@ -239,6 +622,73 @@ private:
     return std::vector< std::string >();
   }
 
+  static bool getAdditionalStatesParam(const ros::NodeHandle &nh, const std::string &key,
+                                       std::vector< Int32StateItem > *const states) {
+    // the param is optional
+    XmlRpc::XmlRpcValue states_param;
+    if (!nh.getParam(key, states_param)) {
+      return true;
+    }
+    if (states_param.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+      ROS_ERROR_STREAM("DynamixelActuator::getAdditionalStatesParam(): Param '"
+                       << nh.resolveName(key) << "' must be an array");
+      return false;
+    }
+
+    // each element must be a state name or a struct like {<state_name>: {every: <n_cycles>}}
+    for (int i = 0; i < states_param.size(); ++i) {
+      XmlRpc::XmlRpcValue &state_param(states_param[i]);
+      if (state_param.getType() == XmlRpc::XmlRpcValue::TypeString) {
+        states->push_back(Int32StateItem(static_cast< std::string & >(state_param)));
+        continue;
+      }
+      if (state_param.getType() == XmlRpc::XmlRpcValue::TypeStruct && state_param.size() == 1) {
+        const std::string name(state_param.begin()->first);
+        XmlRpc::XmlRpcValue rate_param(state_param.begin()->second);
+        if (rate_param.getType() == XmlRpc::XmlRpcValue::TypeStruct &&
+            rate_param.hasMember("every") &&
+            rate_param["every"].getType() == XmlRpc::XmlRpcValue::TypeInt &&
+            static_cast< int & >(rate_param["every"]) > 0) {
+          states->push_back(Int32StateItem(name, static_cast< int & >(rate_param["every"])));
+          continue;
+        }
+      }
+      ROS_ERROR_STREAM("DynamixelActuator::getAdditionalStatesParam(): Element "
+                       << i << " of param '" << nh.resolveName(key)
+                       << "' must be a state name or a struct like {<name>: {every: <n_cycles>}}");
+      return false;
+    }
+    return true;
+  }
+
+  static bool getReadMaskParam(const ros::NodeHandle &nh, const std::string &key,
+                               std::uint8_t *const read_mask) {
+    std::vector< std::string > state_names;
+    if (!nh.getParam(key, state_names)) {
+      ROS_ERROR_STREAM("DynamixelActuator::getReadMaskParam(): Param '"
+                       << nh.resolveName(key) << "' must be an array of state names");
+      return false;
+    }
+    *read_mask = READ_NONE;
+    for (const std::string &state_name : state_names) {
+      if (state_name == "position") {
+        *read_mask |= READ_POSITION;
+      } else if (state_name == "velocity") {
+        *read_mask |= READ_VELOCITY;
+      } else if (state_name == "effort") {
+        *read_mask |= READ_EFFORT;
+      } else if (state_name == "additional_states") {
+        *read_mask |= READ_ADDITIONAL_STATES;
+      } else {
+        ROS_ERROR_STREAM("DynamixelActuator::getReadMaskParam(): Unknown state name '"
+                         << state_name << "' in param '" << nh.resolveName(key)
+                         << "' (should be 'position', 'velocity', 'effort' or 'additional_states')");
+        return false;
+      }
+    }
+    return true;
+  }
+
   static bool getInt32MapParam(const ros::NodeHandle &nh, const std::string &key,
                                std::map< std::string, std::int32_t > &int32_map) {
     std::map< std::string, int > int_map;
@@ -279,10 +729,18 @@ private:
   }
 
 private:
-  DynamixelActuatorDataPtr data_;
+  DynamixelActuatorDataPtr data_, handle_data_;
+  // the entry in the capability cache, used on init only
+  CapabilityCache::Capability *capability_;
+  // extrapolation of the position (optional)
+  StateEstimatorPtr estimator_;
 
-  std::map< std::vector< std::string >, OperatingModePtr > mode_map_;
+  // operating modes & controllers required by them
+  std::vector< std::pair< ControllerSet, OperatingModePtr > > mode_table_;
   OperatingModePtr present_mode_;
+  // the mode between beginSwitch() & endSwitch()
+  OperatingModePtr next_mode_;
+  bool is_switching_;
 };
 
 typedef std::shared_ptr< DynamixelActuator > DynamixelActuatorPtr;
@@ -1,53 +1,239 @@
 #ifndef LAYERED_HARDWARE_DYNAMIXEL_DYNAMIXEL_ACTUATOR_DATA_HPP
 #define LAYERED_HARDWARE_DYNAMIXEL_DYNAMIXEL_ACTUATOR_DATA_HPP
 
+#include <cstddef>
 #include <cstdint>
 #include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
-#include <dynamixel_workbench_toolbox/dynamixel_workbench.h>
 #include <hardware_interface_extensions/integer_interface.hpp>
+#include <layered_hardware_dynamixel/bus_backend.hpp>
+#include <layered_hardware_dynamixel/command_cache.hpp>
 #include <layered_hardware_dynamixel/common_namespaces.hpp>
+#include <layered_hardware_dynamixel/control_table.hpp>
+#include <layered_hardware_dynamixel/dynamixel_actuator_store.hpp>
+#include <layered_hardware_dynamixel/error_log.hpp>
+#include <layered_hardware_dynamixel/io_stats.hpp>
 
 #include <boost/optional.hpp>
 
 namespace layered_hardware_dynamixel {
 
-struct DynamixelActuatorData {
-  DynamixelActuatorData(const std::string &_name, DynamixelWorkbench *const _dxl_wb,
-                        const std::uint8_t _id, const double _torque_constant,
-                        const std::vector< std::string > &additional_state_names,
-                        const std::vector< std::string > &additional_cmd_names)
-      : name(_name), dxl_wb(_dxl_wb), id(_id), torque_constant(_torque_constant), pos(0.), vel(0.),
-        eff(0.), pos_cmd(0.), vel_cmd(0.), eff_cmd(0.) {
-    // TODO: this sorts names and breaks the original order.
-    //       use std::vector< std::pair<> > instead of std::map<> .
-    for (const std::string &name : additional_state_names) {
-      additional_states[name] = 0;
+// control table item resolved to its address & length on init
+// so that hot paths need no lookups by the item name
+struct ItemInfo {
+  ItemInfo() : address(0), length(0) {}
+  ItemInfo(const std::string &_name) : name(_name), address(0), length(0) {}
+
+  bool isAvailable() const { return length > 0; }
+
+  // raw register value -> signed value in the same way as DynamixelWorkbench::itemRead()
+  std::int32_t decode(const std::uint32_t raw_value) const {
+    switch (length) {
+    case 1:
+      return static_cast< std::uint8_t >(raw_value);
+    case 2:
+      return static_cast< std::int16_t >(raw_value);
+    default:
+      return static_cast< std::int32_t >(raw_value);
     }
-    for (const std::string &name : additional_cmd_names) {
-      additional_cmds[name] = 0;
+  }
+
+  // value -> little endian bytes as the control table
+  void encode(const std::int32_t value, std::uint8_t *const bytes) const {
+    for (std::uint16_t i = 0; i < length && i < 4; ++i) {
+      bytes[i] = static_cast< std::uint8_t >((value >> (8 * i)) & 0xFF);
     }
   }
 
+  std::string name;
+  std::uint16_t address, length;
+};
+
+// control table item with its value for additional states & commands
+struct Int32Item {
+  Int32Item(const std::string &name) : info(name), value(0) {}
+
+  ItemInfo info;
+  std::int32_t value;
+};
+
+// additional state item polled every specified number of cycles
+struct Int32StateItem : public Int32Item {
+  Int32StateItem(const std::string &name, const int _every = 1)
+      : Int32Item(name), every(_every), phase(0), is_due(true), is_deferred(false),
+        stale_cycles(0) {}
+
+  // the item is due in cycles where (cycle + phase) % every == 0
+  int every, phase;
+  // true while the item should be but has not been read in the present cycle
+  bool is_due;
+  // true if the bus scheduler has deferred reading the item to the next cycle,
+  // and the number of cycles it has been deferred for
+  bool is_deferred;
+  int stale_cycles;
+};
+
+// flags of states to be read in cycles
+enum ReadMask {
+  READ_NONE = 0,
+  READ_POSITION = 1 << 0,
+  READ_VELOCITY = 1 << 1,
+  READ_EFFORT = 1 << 2,
+  READ_ADDITIONAL_STATES = 1 << 3,
+  READ_ALL = READ_POSITION | READ_VELOCITY | READ_EFFORT | READ_ADDITIONAL_STATES
+};
+
+// progress of rebooting an actuator
+enum RebootStatus { REBOOT_NONE = 0, REBOOTING = 1, REBOOT_SUCCEEDED = 2, REBOOT_FAILED = 3 };
+
+// health of an actuator judged by failures in consecutive cycles
+enum HealthStatus { HEALTH_OK = 0, HEALTH_FAILING = 1, HEALTH_OFFLINE = 2 };
+
+// a command staged by an operating mode to be written by the layer's group write
+struct StagedItem {
+  std::uint16_t address, length;
+  std::int32_t value;
+};
+
+// an actuator's data. the states & commands are elements of the layer's store
+// so that loops over actuators access them sequentially.
+struct DynamixelActuatorData {
+  DynamixelActuatorData(const std::string &_name, BusBackend *const _dxl_wb, const std::uint8_t _id,
+                        const double _torque_constant, DynamixelActuatorStore *const _store,
+                        const std::size_t _index,
+                        const std::vector< Int32StateItem > &_additional_states,
+                        const std::vector< std::string > &additional_cmd_names)
+      : name(_name), dxl_wb(_dxl_wb), id(_id), torque_constant(_torque_constant), store(_store),
+        index(_index), control_table(NULL), uses_scales(false), is_available(true),
+        reboot_status(_store->reboot_status[_index]),
+        health_status(_store->health_status[_index]),
+        consecutive_failures(_store->consecutive_failures[_index]), n_errors(0),
+        is_offline(false), stale_cycles(_store->stale_cycles[_index]), has_fresh_pos(false),
+        has_fresh_vel(false), has_eff(false), pos(_store->pos[_index]),
+        vel(_store->vel[_index]), eff(_store->eff[_index]), present_pos_item("Present_Position"),
+        present_vel_item("Present_Velocity"), present_eff_item("Present_Current"),
+        additional_states(_additional_states), read_mask(READ_NONE), defers_core_states(false),
+        indirect_table_address(0),
+        has_prefetched_states(false), present_pos_value(_store->present_pos_value[_index]),
+        present_vel_value(_store->present_vel_value[_index]),
+        present_eff_value(_store->present_eff_value[_index]), pos_cmd(_store->pos_cmd[_index]),
+        vel_cmd(_store->vel_cmd[_index]), eff_cmd(_store->eff_cmd[_index]),
+        goal_pos_item("Goal_Position"), goal_vel_item("Goal_Velocity"),
+        goal_eff_item("Goal_Current"), profile_vel_item("Profile_Velocity"), pos_dead_band(0.),
+        vel_dead_band(0.), eff_dead_band(0.), stages_cmds(false), defers_switch_writes(false),
+        defers_torque_off(false), has_deferred_torque_off(false), error_log(NULL) {
+    // the vectors are never resized after here
+    // so that hardware handles can hold pointers to their values
+    additional_cmds.assign(additional_cmd_names.begin(), additional_cmd_names.end());
+    additional_cmd_caches.resize(additional_cmds.size());
+  }
+
+  // e.g. after failed writes, rebooting or being taken offline
+  void forgetControlTable() {
+    known_operating_mode = boost::none;
+    known_items.clear();
+  }
+
   // handles
   const std::string name;
-  DynamixelWorkbench *const dxl_wb;
+  // the backend of the bus, DynamixelWorkbench or its simulation
+  BusBackend *const dxl_wb;
   const std::uint8_t id;
 
   // params
   const double torque_constant;
 
-  // states
-  boost::optional< bool > has_eff;
-  double pos, vel, eff;
-  std::map< std::string, std::int32_t > additional_states;
+  // location in the layer's store
+  DynamixelActuatorStore *const store;
+  const std::size_t index;
+  // the compile-time control table of the model family if known.
+  // otherwise items & scales are looked up in DynamixelWorkbench's model database.
+  const ControlTable *control_table;
+  // true if the store has precomputed scales for conversion of values.
+  // otherwise conversion falls back to DynamixelWorkbench::convert*().
+  bool uses_scales;
+
+  // availability. false while the actuator does not respond like during rebooting.
+  // the layer's group read & write skip unavailable actuators.
+  bool is_available;
+  std::int32_t &reboot_status;
+
+  // health judged by the layer (a HealthStatus) & the number of consecutive failed cycles.
+  // the total number of failed transactions is counted by operating modes.
+  // an offline actuator is unavailable & not operated except periodic health pings.
+  std::int32_t &health_status, &consecutive_failures;
+  std::uint32_t n_errors;
+  bool is_offline;
+
+  // the number of consecutive cycles where the position has not been read
+  // although the operating mode reads it (failed or deferred)
+  std::int32_t &stale_cycles;
+  // true if the position & velocity have been read in the present cycle
+  bool has_fresh_pos, has_fresh_vel;
+
+  // the firmware version if read on init, so that bus setups need not read it again
+  boost::optional< std::int32_t > firmware_version;
+
+  // states. has_eff is true if the model has the present current, fixed on init.
+  bool has_eff;
+  double &pos, &vel, &eff;
+  ItemInfo present_pos_item, present_vel_item, present_eff_item;
+  std::vector< Int32StateItem > additional_states;
+  // states read by the present operating mode in cycles (a combination of ReadMask)
+  std::uint8_t read_mask;
+  // true if the bus scheduler skips reading position, velocity & current in the present cycle
+  bool defers_core_states;
+
+  // indirect address table mirroring states into the indirect data region if programmed.
+  // kept to reprogram the table after rebooting because the table is in RAM.
+  std::uint16_t indirect_table_address;
+  std::vector< std::uint8_t > indirect_table;
+
+  // raw present values prefetched by the layer's group read.
+  // operating modes decode them instead of reading the actuator if available.
+  bool has_prefetched_states;
+  std::int32_t &present_pos_value, &present_vel_value, &present_eff_value;
 
   // commands
-  double pos_cmd, vel_cmd, eff_cmd;
-  std::map< std::string, std::int32_t > additional_cmds;
+  double &pos_cmd, &vel_cmd, &eff_cmd;
+  ItemInfo goal_pos_item, goal_vel_item, goal_eff_item, profile_vel_item;
+  std::vector< Int32Item > additional_cmds;
+
+  // commands last written to the control table, shared by operating modes
+  // so that unchanged commands are never written again
+  CachedCommand goal_pos_cache, goal_vel_cache, goal_eff_cache, profile_vel_cache;
+  std::vector< CachedCommand > additional_cmd_caches;
+  // changes of commands in SI units which are too small to be written
+  double pos_dead_band, vel_dead_band, eff_dead_band;
+
+  // commands staged by operating modes. if stages_cmds is true,
+  // operating modes append commands here instead of writing them,
+  // and the layer's group write or command merger flushes them once per cycle.
+  bool stages_cmds;
+  std::vector< StagedItem > staged_cmds;
+
+  // writes on switching modes. if defers_switch_writes is true, operating modes append
+  // their mode-enable sequences & item maps here, and the layer writes them
+  // for all the actuators switching modes at once.
+  bool defers_switch_writes;
+  std::vector< StagedItem > switch_writes;
+
+  // the operating mode & items which switches have left in the control table,
+  // so that the next switch writes only what differs. forgotten whenever they may be stale.
+  boost::optional< std::int32_t > known_operating_mode;
+  std::map< std::string, std::int32_t > known_items;
+  // true while the present mode is stopped on switching, so that its torque-off is deferred
+  // and the next mode can take it over if it enables the torque in the same operating mode
+  bool defers_torque_off, has_deferred_torque_off;
+
+  // latencies & errors on the actuator recorded if the layer's stats are enabled
+  IoStatsPtr stats;
+  // errors on bus cycles are reported to the layer's error log if given,
+  // otherwise logged immediately
+  ErrorLog *error_log;
 };
 
 typedef std::shared_ptr< DynamixelActuatorData > DynamixelActuatorDataPtr;
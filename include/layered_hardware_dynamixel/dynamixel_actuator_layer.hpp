@@ -1,20 +1,44 @@
 #ifndef LAYERED_HARDWARE_DYNAMIXEL_DYNAMIXEL_ACTUATOR_LAYER_HPP
 #define LAYERED_HARDWARE_DYNAMIXEL_DYNAMIXEL_ACTUATOR_LAYER_HPP
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <list>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
-#include <dynamixel_workbench_toolbox/dynamixel_workbench.h>
 #include <hardware_interface/actuator_command_interface.h>
 #include <hardware_interface/actuator_state_interface.h>
 #include <hardware_interface/controller_info.h>
 #include <hardware_interface/robot_hw.h>
 #include <hardware_interface_extensions/integer_interface.hpp>
 #include <layered_hardware/layer_base.hpp>
+#include <layered_hardware_dynamixel/bus_backend.hpp>
+#include <layered_hardware_dynamixel/bus_log.hpp>
+#include <layered_hardware_dynamixel/capability_cache.hpp>
 #include <layered_hardware_dynamixel/common_namespaces.hpp>
 #include <layered_hardware_dynamixel/controller_set.hpp>
+#include <layered_hardware_dynamixel/diagnosing_backend.hpp>
 #include <layered_hardware_dynamixel/dynamixel_actuator.hpp>
+#include <layered_hardware_dynamixel/dynamixel_actuator_data.hpp>
+#include <layered_hardware_dynamixel/dynamixel_actuator_store.hpp>
+#include <layered_hardware_dynamixel/dynamixel_bus.hpp>
+#include <layered_hardware_dynamixel/error_log.hpp>
+#include <layered_hardware_dynamixel/realtime_thread.hpp>
+#include <layered_hardware_dynamixel/recording_backend.hpp>
+#include <layered_hardware_dynamixel/replay_backend.hpp>
+#include <layered_hardware_dynamixel/simulated_backend.hpp>
+#include <layered_hardware_dynamixel/state_exporter.hpp>
+#include <layered_hardware_dynamixel/triple_buffer.hpp>
+#include <layered_hardware_dynamixel/workbench_backend.hpp>
 #include <ros/console.h>
 #include <ros/duration.h>
 #include <ros/names.h>
@@ -26,6 +50,31 @@ namespace layered_hardware_dynamixel {
 
 class DynamixelActuatorLayer : public lh::LayerBase {
 public:
+  DynamixelActuatorLayer()
+      : stats_window_(0), n_stats_cycles_(0), diagnostics_window_(0), n_diagnostics_cycles_(0) {}
+
+  virtual ~DynamixelActuatorLayer() {
+    // stop bus cycles before actuators finalize their operating modes
+    if (io_thread_) {
+      io_thread_->stop();
+    }
+    // log remaining errors. errors on finalization are logged immediately
+    // because the error log refers to names of actuators.
+    for (const DynamixelBusPtr &bus : buses_) {
+      bus->setErrorLog(NULL);
+    }
+    if (error_log_) {
+      error_log_->stop();
+    }
+    // finalize actuators while their buses and the store are alive.
+    // buses release the last references to actuators before their backends,
+    // so every reference to buses is dropped here rather than by the implicit teardown.
+    actuators_.clear();
+    diagnostics_.clear();
+    capability_ports_.clear();
+    buses_.clear();
+  }
+
   virtual bool init(hi::RobotHW *const hw, const ros::NodeHandle &param_nh,
                     const std::string &urdf_str) override {
     // make actuator interfaces registered to the hardware
@@ -37,13 +86,30 @@ public:
     makeRegistered< hie::Int32StateInterface >(hw);
     makeRegistered< hie::Int32Interface >(hw);
 
-    // open USB serial device
-    if (!dxl_wb_.init(param< std::string >(param_nh, "serial_interface", "/dev/ttyUSB0").c_str(),
-                      param(param_nh, "baudrate", 115200))) {
-      ROS_ERROR_STREAM("DynamixelActuatorLayer::init(): Failed to open DynamixelWorkbench");
+    // open USB serial devices with param "buses" (optional),
+    // or a single device with params "serial_interface" & "baudrate".
+    // each bus is simulated or replayed instead if param "simulation" or "replay" is given
+    // for it (optional).
+    XmlRpc::XmlRpcValue buses_param;
+    if (param_nh.getParam("buses", buses_param)) {
+      if (buses_param.getType() != XmlRpc::XmlRpcValue::TypeStruct || buses_param.size() == 0) {
+        ROS_ERROR_STREAM("DynamixelActuatorLayer::init(): Param '"
+                         << param_nh.resolveName("buses") << "' must be a non-empty struct");
+        return false;
+      }
+      for (const XmlRpc::XmlRpcValue::ValueStruct::value_type &bus_param : buses_param) {
+        ros::NodeHandle bus_param_nh(param_nh, ros::names::append("buses", bus_param.first));
+        if (!addBus(bus_param.first, bus_param_nh, param_nh)) {
+          return false;
+        }
+      }
+    } else if (!addBus("default", param_nh, param_nh)) {
       return false;
     }
 
+    // run bus cycles on a dedicated thread if param "io_thread" is given (optional)
+    const bool use_io_thread(param_nh.hasParam("io_thread"));
+
     // load actuator names from param "actuators"
     XmlRpc::XmlRpcValue ators_param;
     if (!param_nh.getParam("actuators", ators_param)) {
@@ -57,30 +123,278 @@ public:
       return false;
     }
 
-    // init actuators with param "actuators/<actuator_name>"
+    // find buses of actuators with param "actuators/<actuator_name>/bus"
     // (could not use BOOST_FOREACH here to avoid a bug in the library in Kinetic)
+    std::vector< std::pair< std::string, DynamixelBusPtr > > ator_buses;
+    std::map< DynamixelBusPtr, std::vector< std::uint8_t > > ids_on_buses;
     for (const XmlRpc::XmlRpcValue::ValueStruct::value_type &ator_param : ators_param) {
-      DynamixelActuatorPtr ator(new DynamixelActuator());
       ros::NodeHandle ator_param_nh(param_nh, ros::names::append("actuators", ator_param.first));
-      if (!ator->init(ator_param.first, &dxl_wb_, hw, ator_param_nh)) {
+      const DynamixelBusPtr bus(findBus(ator_param_nh));
+      if (!bus) {
+        return false;
+      }
+      ator_buses.push_back(std::make_pair(ator_param.first, bus));
+      int id;
+      if (ator_param_nh.getParam("id", id)) {
+        ids_on_buses[bus].push_back(id);
+      }
+    }
+
+    // discover actuators on all buses concurrently before initializing them one by one.
+    // buses with diagnostics also ping the actuators to measure round trips.
+    const int n_probes(diagnostics_.empty() ? 0 : param(param_nh, "diagnostics/probes", 10));
+    {
+      std::vector< std::thread > threads;
+      for (const std::map< DynamixelBusPtr, std::vector< std::uint8_t > >::value_type &ids :
+           ids_on_buses) {
+        const DynamixelBusPtr &bus(ids.first);
+        const int n_pings(diagnostics_.count(bus) > 0 ? n_probes : 0);
+        threads.push_back(std::thread([&bus, &ids, n_pings]() {
+          bus->discover(ids.second);
+          bus->probe(ids.second, n_pings);
+        }));
+      }
+      for (std::thread &thread : threads) {
+        thread.join();
+      }
+    }
+    for (const std::map< DynamixelBusPtr, DiagnosingBackendPtr >::value_type &diag :
+         diagnostics_) {
+      diag.second->summarize(NULL);
+      ROS_INFO_STREAM("DynamixelActuatorLayer::init(): Round trips on the bus '"
+                      << diag.first->getName() << "' take " << diag.second->getRttUs()
+                      << " us against " << diag.second->getAirtimeUs()
+                      << " us of airtime on average");
+    }
+
+    // order actuators by buses so that each bus operates a contiguous range in the store
+    std::stable_sort(ator_buses.begin(), ator_buses.end(),
+                     [this](const std::pair< std::string, DynamixelBusPtr > &a,
+                            const std::pair< std::string, DynamixelBusPtr > &b) {
+                       return std::find(buses_.begin(), buses_.end(), a.second) <
+                              std::find(buses_.begin(), buses_.end(), b.second);
+                     });
+
+    // take capabilities of actuators from the file given by param "capability_cache"
+    // instead of resolving them if cached by previous runs (optional)
+    CapabilityCachePtr capability_cache;
+    if (param_nh.hasParam("capability_cache")) {
+      capability_cache.reset(new CapabilityCache());
+      capability_cache->load(param< std::string >(param_nh, "capability_cache", ""));
+    }
+
+    // allocate states & commands of all actuators in series.
+    // handles are bound to another store if the I/O thread operates actuators.
+    store_.reset(new DynamixelActuatorStore(ator_buses.size()));
+    handle_store_ = use_io_thread ? std::make_shared< DynamixelActuatorStore >(ator_buses.size())
+                                  : store_;
+
+    // init actuators with param "actuators/<actuator_name>"
+    for (const std::pair< std::string, DynamixelBusPtr > &ator_bus : ator_buses) {
+      ros::NodeHandle ator_param_nh(param_nh, ros::names::append("actuators", ator_bus.first));
+      DynamixelActuatorPtr ator(new DynamixelActuator());
+      const std::map< DynamixelBusPtr, std::string >::const_iterator port(
+          capability_ports_.find(ator_bus.second));
+      if (!ator->init(ator_bus.first, ator_bus.second->getBackend(), hw, ator_param_nh,
+                      &controller_ids_, store_.get(), actuators_.size(), handle_store_.get(),
+                      port != capability_ports_.end() ? capability_cache.get() : NULL,
+                      port != capability_ports_.end() ? port->second : "")) {
         return false;
       }
       ROS_INFO_STREAM("DynamixelActuatorLayer::init(): Initialized the actuator '"
-                      << ator_param.first << "'");
+                      << ator_bus.first << "' on the bus '" << ator_bus.second->getName() << "'");
+      ator_bus.second->addActuator(ator);
       actuators_.push_back(ator);
     }
 
+    // keep capabilities resolved in this run for the next
+    if (capability_cache) {
+      capability_cache->save();
+    }
+
+    // size sets of running controllers so that switching never allocates memory
+    controllers_.reserve(controller_ids_.size());
+    updated_controllers_.reserve(controller_ids_.size());
+
+    // log errors on bus cycles from a non-realtime thread
+    // so that bus cycles never allocate memory or block on logging
+    error_log_.reset(new ErrorLog());
+    for (const DynamixelBusPtr &bus : buses_) {
+      bus->setErrorLog(error_log_.get());
+    }
+
+    // take failing actuators offline & summarize errors if param "health" is given (optional)
+    if (param_nh.hasParam("health")) {
+      const int max_failures(param(param_nh, "health/max_failures", 5));
+      const double ping_interval(param(param_nh, "health/ping_interval", 0.1)),
+          max_ping_interval(param(param_nh, "health/max_ping_interval", 5.)),
+          summary_interval(param(param_nh, "health/summary_interval", 1.));
+      if (max_failures <= 0 || ping_interval <= 0. || max_ping_interval < ping_interval) {
+        ROS_ERROR_STREAM("DynamixelActuatorLayer::init(): Param '"
+                         << param_nh.resolveName("health/max_failures") << "' & '"
+                         << param_nh.resolveName("health/ping_interval")
+                         << "' must be positive, and param '"
+                         << param_nh.resolveName("health/max_ping_interval")
+                         << "' must not be less than '"
+                         << param_nh.resolveName("health/ping_interval") << "'");
+        return false;
+      }
+      for (const DynamixelBusPtr &bus : buses_) {
+        bus->enableHealth(max_failures, ros::Duration(ping_interval),
+                          ros::Duration(max_ping_interval));
+      }
+      error_log_->setSummaryInterval(summary_interval);
+    }
+    error_log_->start();
+
+    // prepare bus cycles with optional group read & write
+    const bool use_group_read(param(param_nh, "group_read", false)),
+        use_group_write(param(param_nh, "group_write", false)),
+        use_group_switch(param(param_nh, "group_switch", false)),
+        use_indirect_read(param(param_nh, "indirect_read", false)),
+        use_fast_read(param(param_nh, "fast_read", false)),
+        use_pipelined_read(param(param_nh, "pipelined_read", false)),
+        use_merged_write(param(param_nh, "merge_writes", false));
+    for (const DynamixelBusPtr &bus : buses_) {
+      if (!bus->initIO(use_group_read, use_group_write, use_group_switch, use_indirect_read,
+                       use_fast_read, use_pipelined_read, use_merged_write)) {
+        return false;
+      }
+    }
+
+    // fit bus cycles into the time budget if param "budget" is given (optional)
+    if (param_nh.hasParam("budget")) {
+      const double budget(param(param_nh, "budget/time", 0.)),
+          status_latency(param(param_nh, "budget/status_latency", 0.));
+      const int max_stale_cycles(param(param_nh, "budget/max_stale_cycles", 10));
+      if (budget <= 0. || status_latency < 0. || max_stale_cycles < 0) {
+        ROS_ERROR_STREAM("DynamixelActuatorLayer::init(): Param '"
+                         << param_nh.resolveName("budget/time")
+                         << "' must be positive, and params '"
+                         << param_nh.resolveName("budget/status_latency") << "' & '"
+                         << param_nh.resolveName("budget/max_stale_cycles")
+                         << "' must be non-negative");
+        return false;
+      }
+      for (const DynamixelBusPtr &bus : buses_) {
+        bus->initScheduler(budget, status_latency, max_stale_cycles);
+      }
+    }
+
+    // record latencies & errors if param "stats" is given (optional)
+    if (param_nh.hasParam("stats")) {
+      stats_window_ = param(param_nh, "stats/window", 100);
+      if (stats_window_ <= 0) {
+        ROS_ERROR_STREAM("DynamixelActuatorLayer::init(): Param '"
+                         << param_nh.resolveName("stats/window") << "' must be positive");
+        return false;
+      }
+      hie::Int32StateInterface *const iface(hw->get< hie::Int32StateInterface >());
+      for (const DynamixelBusPtr &bus : buses_) {
+        bus->enableStats();
+        bus->getStats()->registerTo(iface, ros::names::append("bus_stats", bus->getName()));
+      }
+      for (const DynamixelActuatorPtr &ator : actuators_) {
+        ator->getData()->stats->registerTo(iface, ator->getData()->name + "/stats");
+      }
+    }
+
+    // expose round trips & error rates if param "diagnostics" is given (optional)
+    if (!diagnostics_.empty()) {
+      diagnostics_window_ = param(param_nh, "diagnostics/window", 100);
+      if (diagnostics_window_ <= 0) {
+        ROS_ERROR_STREAM("DynamixelActuatorLayer::init(): Param '"
+                         << param_nh.resolveName("diagnostics/window") << "' must be positive");
+        return false;
+      }
+      hie::Int32StateInterface *const iface(hw->get< hie::Int32StateInterface >());
+      for (const std::map< DynamixelBusPtr, DiagnosingBackendPtr >::value_type &diag :
+           diagnostics_) {
+        diag.second->registerTo(iface,
+                                ros::names::append("bus_diagnostics", diag.first->getName()));
+      }
+      for (std::size_t i = 0; i < actuators_.size(); ++i) {
+        const DynamixelActuatorDataPtr &data(actuators_[i]->getData());
+        diagnostics_[ator_buses[i].second]->registerTo(iface, data->name, data->id);
+      }
+    }
+
+    // export states of every cycle to shared memory if param "shm_export" is given (optional)
+    if (param_nh.hasParam("shm_export")) {
+      const std::string shm_name(
+          param< std::string >(param_nh, "shm_export/name", "/layered_hardware_dynamixel"));
+      const int n_slots(param(param_nh, "shm_export/slots", 64));
+      if (n_slots <= 0) {
+        ROS_ERROR_STREAM("DynamixelActuatorLayer::init(): Param '"
+                         << param_nh.resolveName("shm_export/slots") << "' must be positive");
+        return false;
+      }
+      std::vector< std::string > ator_names, state_names;
+      for (const DynamixelActuatorPtr &ator : actuators_) {
+        ator_names.push_back(ator->getData()->name);
+        for (const Int32StateItem &state : ator->getData()->additional_states) {
+          state_names.push_back(ator->getData()->name + "/" + state.info.name);
+        }
+      }
+      exporter_.reset(new StateExporter());
+      if (!exporter_->init(shm_name, n_slots, ator_names, state_names)) {
+        return false;
+      }
+      ROS_INFO_STREAM("DynamixelActuatorLayer::init(): Exporting states to the shared memory '"
+                      << shm_name << "' with " << n_slots << " slots");
+    }
+
+    // service buses concurrently on their own worker threads if there are multiple buses
+    if (buses_.size() > 1) {
+      for (const DynamixelBusPtr &bus : buses_) {
+        bus->startWorker();
+      }
+    }
+
+    // start the dedicated thread which owns the bus
+    if (use_io_thread) {
+      // locate additional values of each actuator in snapshots
+      std::size_t n_additional_states(0), n_additional_cmds(0);
+      for (const DynamixelActuatorPtr &ator : actuators_) {
+        state_offsets_.push_back(n_additional_states);
+        cmd_offsets_.push_back(n_additional_cmds);
+        n_additional_states += ator->getData()->additional_states.size();
+        n_additional_cmds += ator->getData()->additional_cmds.size();
+      }
+      DynamixelActuatorStore snapshot(*store_);
+      snapshot.additional_states.resize(n_additional_states);
+      snapshot.additional_cmds.resize(n_additional_cmds);
+      saveStates(&snapshot);
+      saveCommands(&snapshot);
+      state_buffer_.reset(snapshot);
+      cmd_buffer_.reset(snapshot);
+
+      const double frequency(param(param_nh, "io_thread/frequency", 100.));
+      const int priority(param(param_nh, "io_thread/priority", 0));
+      const int cpu(param(param_nh, "io_thread/cpu", -1));
+      io_thread_.reset(new RealtimeThread());
+      if (frequency <= 0. ||
+          !io_thread_->start(std::bind(&DynamixelActuatorLayer::ioCycle, this), 1. / frequency,
+                             priority, cpu)) {
+        ROS_ERROR_STREAM("DynamixelActuatorLayer::init(): Failed to start the I/O thread");
+        return false;
+      }
+      ROS_INFO_STREAM("DynamixelActuatorLayer::init(): Started the I/O thread at "
+                      << frequency << " Hz");
+    }
+
     return true;
   }
 
   virtual bool prepareSwitch(const std::list< hi::ControllerInfo > &start_list,
                              const std::list< hi::ControllerInfo > &stop_list) override {
     // dry-update of the list of running controllers
-    const ControllerSet updated_list(controllers_.updated(start_list, stop_list));
+    updated_controllers_.assign(controllers_);
+    updated_controllers_.update(controller_ids_, start_list, stop_list);
 
     // ask to all actuators if controller switching is possible
     for (const DynamixelActuatorPtr &ator : actuators_) {
-      if (!ator->prepareSwitch(updated_list)) {
+      if (!ator->prepareSwitch(updated_controllers_)) {
         return false;
       }
     }
@@ -90,30 +404,306 @@ public:
 
   virtual void doSwitch(const std::list< hi::ControllerInfo > &start_list,
                         const std::list< hi::ControllerInfo > &stop_list) override {
+    // mode switching accesses the bus. wait for the I/O thread to finish the present cycle.
+    std::unique_lock< std::mutex > lock(io_mutex_, std::defer_lock);
+    if (io_thread_) {
+      lock.lock();
+    }
+
     // update the list of running controllers
-    controllers_.update(start_list, stop_list);
+    controllers_.update(controller_ids_, start_list, stop_list);
 
-    // notify controller switching to all actuators
+    // notify controller switching to all actuators.
+    // writes to enable the next modes are batched among actuators on each bus if enabled.
+    for (const DynamixelBusPtr &bus : buses_) {
+      bus->beginSwitch();
+    }
+    for (const DynamixelActuatorPtr &ator : actuators_) {
+      ator->beginSwitch(controllers_);
+    }
+    for (const DynamixelBusPtr &bus : buses_) {
+      bus->flushSwitch();
+    }
     for (const DynamixelActuatorPtr &ator : actuators_) {
-      ator->doSwitch(controllers_);
+      ator->endSwitch();
+    }
+
+    // assemble only states read by the new operating modes into the group read
+    for (const DynamixelBusPtr &bus : buses_) {
+      bus->reconfigure();
+    }
+
+    if (io_thread_) {
+      // operating modes may initialize commands on starting.
+      // let handles follow them, and supersede commands for the previous modes
+      // by publishing the followed ones as the producer of the buffer does on write().
+      handle_store_->copyStatesFrom(*store_);
+      handle_store_->copyCommandsFrom(*store_);
+      for (const DynamixelActuatorPtr &ator : actuators_) {
+        ator->updateHandles();
+      }
+      saveCommands(&cmd_buffer_.back());
+      cmd_buffer_.publish();
     }
   }
 
   virtual void read(const ros::Time &time, const ros::Duration &period) override {
-    // read from all actuators
-    for (const DynamixelActuatorPtr &ator : actuators_) {
-      ator->read(time, period);
+    // update summaries of latencies once per window if enabled
+    if (stats_window_ > 0 && ++n_stats_cycles_ >= stats_window_) {
+      n_stats_cycles_ = 0;
+      for (const DynamixelBusPtr &bus : buses_) {
+        bus->getStats()->summarize();
+      }
+      for (const DynamixelActuatorPtr &ator : actuators_) {
+        ator->getData()->stats->summarize();
+      }
+    }
+
+    // update round trips & error rates once per window if enabled.
+    // rising warnings are logged via the error log.
+    if (diagnostics_window_ > 0 && ++n_diagnostics_cycles_ >= diagnostics_window_) {
+      n_diagnostics_cycles_ = 0;
+      for (const std::map< DynamixelBusPtr, DiagnosingBackendPtr >::value_type &diag :
+           diagnostics_) {
+        diag.second->summarize(error_log_.get());
+      }
     }
+
+    // just copy the latest states from the I/O thread if enabled
+    if (io_thread_) {
+      if (state_buffer_.update()) {
+        loadStates(state_buffer_.front());
+      }
+      return;
+    }
+
+    readBus(time, period);
   }
 
   virtual void write(const ros::Time &time, const ros::Duration &period) override {
-    // write to all actuators
-    for (const DynamixelActuatorPtr &ator : actuators_) {
-      ator->write(time, period);
+    // just pass the commands to the I/O thread if enabled
+    if (io_thread_) {
+      saveCommands(&cmd_buffer_.back());
+      cmd_buffer_.publish();
+      return;
+    }
+
+    writeBus(time, period);
+  }
+
+protected:
+  // the real bus via DynamixelWorkbench, the simulated one if param "simulation" is given,
+  // or the recorded one if param "replay" is given.
+  // derived layers can override this to inspect or replace backends (e.g. benchmarks).
+  virtual BusBackendPtr makeBackend(const ros::NodeHandle &bus_param_nh) const {
+    if (bus_param_nh.hasParam("replay")) {
+      const std::string file(param< std::string >(bus_param_nh, "replay/file", ""));
+      ROS_INFO_STREAM("DynamixelActuatorLayer::makeBackend(): Replaying the bus log '"
+                      << file << "' with param '" << bus_param_nh.resolveName("replay") << "'");
+      return std::make_shared< ReplayBackend >(file, param(bus_param_nh, "replay/waits", false));
     }
+    if (!bus_param_nh.hasParam("simulation")) {
+      return std::make_shared< WorkbenchBackend >();
+    }
+    const SimulatedBackendPtr backend(std::make_shared< SimulatedBackend >(
+        param(bus_param_nh, "simulation/latency_timer", 0.001),
+        param(bus_param_nh, "simulation/waits", true)));
+    backend->setReturnDelayTime(param(bus_param_nh, "simulation/return_delay_time", 0));
+    backend->setFirmwareVersion(param(bus_param_nh, "simulation/firmware_version", 45));
+    ROS_INFO_STREAM("DynamixelActuatorLayer::makeBackend(): Simulating the bus with param '"
+                    << bus_param_nh.resolveName("simulation") << "'");
+    return backend;
   }
 
 private:
+  // open the bus with params "serial_interface" & "baudrate" in the bus namespace.
+  // all calls to the backend are recorded if param "record" is given, and diagnosed
+  // if param "diagnostics" is given in the layer namespace (optional).
+  bool addBus(const std::string &name, const ros::NodeHandle &bus_param_nh,
+              const ros::NodeHandle &param_nh) {
+    BusBackendPtr backend(makeBackend(bus_param_nh));
+    // diagnose the backend itself so that recording does not count in round trips
+    DiagnosingBackendPtr diag;
+    if (param_nh.hasParam("diagnostics")) {
+      const double max_excess_latency(param(param_nh, "diagnostics/max_excess_latency", 0.004)),
+          max_error_rate(param(param_nh, "diagnostics/max_error_rate", 0.01));
+      if (max_excess_latency <= 0. || max_error_rate < 0.) {
+        ROS_ERROR_STREAM("DynamixelActuatorLayer::addBus(): Param '"
+                         << param_nh.resolveName("diagnostics/max_excess_latency")
+                         << "' must be positive, and param '"
+                         << param_nh.resolveName("diagnostics/max_error_rate")
+                         << "' must be non-negative");
+        return false;
+      }
+      diag = std::make_shared< DiagnosingBackend >(backend, max_excess_latency, max_error_rate);
+      backend = diag;
+    }
+    if (param_nh.hasParam("record")) {
+      const std::string path(param< std::string >(param_nh, "record/prefix",
+                                                  "/tmp/layered_hardware_dynamixel_") +
+                             name + ".bus");
+      const int capacity(param(param_nh, "record/capacity", 4096));
+      if (capacity <= 0) {
+        ROS_ERROR_STREAM("DynamixelActuatorLayer::addBus(): Param '"
+                         << param_nh.resolveName("record/capacity") << "' must be positive");
+        return false;
+      }
+      const BusLogWriterPtr writer(std::make_shared< BusLogWriter >(capacity));
+      if (!writer->open(path)) {
+        return false;
+      }
+      writer->start(param(param_nh, "record/flush_period", 0.1));
+      backend = std::make_shared< RecordingBackend >(backend, writer);
+      ROS_INFO_STREAM("DynamixelActuatorLayer::addBus(): Recording the bus '"
+                      << name << "' to '" << path << "'");
+    }
+    const std::string serial_interface(
+        param< std::string >(bus_param_nh, "serial_interface", "/dev/ttyUSB0"));
+    DynamixelBusPtr bus(new DynamixelBus());
+    if (!bus->init(name, backend, serial_interface, param(bus_param_nh, "baudrate", 115200))) {
+      return false;
+    }
+    buses_.push_back(bus);
+    if (diag) {
+      diagnostics_[bus] = diag;
+    }
+    // simulated actuators are cached apart from real ones. replayed buses never use the cache
+    // because the recorded calls depend on the cache at the time of recording.
+    if (!bus_param_nh.hasParam("replay")) {
+      capability_ports_[bus] =
+          bus_param_nh.hasParam("simulation") ? "simulation:" + serial_interface : serial_interface;
+    }
+    return true;
+  }
+
+  // one cycle on the I/O thread
+  void ioCycle() {
+    std::lock_guard< std::mutex > lock(io_mutex_);
+
+    const ros::Time time(ros::Time::now());
+    const ros::Duration period(io_last_time_.isZero() ? ros::Duration(0.) : time - io_last_time_);
+    io_last_time_ = time;
+
+    // read states and pass them to the control thread
+    readBus(time, period);
+    saveStates(&state_buffer_.back());
+    state_buffer_.publish();
+
+    // write the latest commands from the control thread
+    if (cmd_buffer_.update()) {
+      loadCommands(cmd_buffer_.front());
+    }
+    writeBus(time, period);
+  }
+
+  //
+  // exchange of snapshots between the store operated by the I/O thread and
+  // the store bound to hardware handles. these never allocate memory.
+  //
+
+  // on the I/O thread
+  void saveStates(DynamixelActuatorStore *const snapshot) const {
+    snapshot->copyStatesFrom(*store_);
+    for (std::size_t i = 0; i < actuators_.size(); ++i) {
+      actuators_[i]->getAdditionalStates(snapshot->additional_states.data() + state_offsets_[i]);
+    }
+  }
+
+  void loadCommands(const DynamixelActuatorStore &snapshot) {
+    store_->copyCommandsFrom(snapshot);
+    for (std::size_t i = 0; i < actuators_.size(); ++i) {
+      actuators_[i]->setAdditionalCommands(snapshot.additional_cmds.data() + cmd_offsets_[i]);
+    }
+  }
+
+  // on the control thread
+  void loadStates(const DynamixelActuatorStore &snapshot) {
+    handle_store_->copyStatesFrom(snapshot);
+    for (std::size_t i = 0; i < actuators_.size(); ++i) {
+      actuators_[i]->setAdditionalStates(snapshot.additional_states.data() + state_offsets_[i]);
+    }
+  }
+
+  void saveCommands(DynamixelActuatorStore *const snapshot) const {
+    snapshot->copyCommandsFrom(*handle_store_);
+    for (std::size_t i = 0; i < actuators_.size(); ++i) {
+      actuators_[i]->getAdditionalCommands(snapshot->additional_cmds.data() + cmd_offsets_[i]);
+    }
+  }
+
+  // read & write all buses. the total time is the longest one among buses
+  // because each bus runs its job on its own worker if there are multiple buses.
+  void readBus(const ros::Time &time, const ros::Duration &period) {
+    const std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+    for (const DynamixelBusPtr &bus : buses_) {
+      bus->readAsync(time, period);
+    }
+    for (const DynamixelBusPtr &bus : buses_) {
+      bus->wait();
+    }
+
+    // publish the states to other processes if enabled
+    if (exporter_) {
+      exportStates(time, period,
+                   std::chrono::duration_cast< std::chrono::nanoseconds >(
+                       std::chrono::steady_clock::now() - start)
+                       .count());
+    }
+  }
+
+  // copy the states in the store into the next slot of the shared memory. never allocates.
+  void exportStates(const ros::Time &time, const ros::Duration &period,
+                    const std::int64_t read_ns) {
+    SharedStateSlot *const slot(
+        exporter_->begin(static_cast< std::int64_t >(time.toNSec()), period.toNSec(), read_ns));
+    std::copy(store_->pos.begin(), store_->pos.end(), exporter_->positions(slot));
+    std::copy(store_->vel.begin(), store_->vel.end(), exporter_->velocities(slot));
+    std::copy(store_->eff.begin(), store_->eff.end(), exporter_->efforts(slot));
+    std::copy(store_->health_status.begin(), store_->health_status.end(),
+              exporter_->healthStatuses(slot));
+    std::copy(store_->stale_cycles.begin(), store_->stale_cycles.end(),
+              exporter_->staleCycles(slot));
+    std::int32_t *states(exporter_->additionalStates(slot));
+    for (const DynamixelActuatorPtr &ator : actuators_) {
+      for (const Int32StateItem &state : ator->getData()->additional_states) {
+        *states++ = state.value;
+      }
+    }
+    exporter_->publish(slot);
+  }
+
+  void writeBus(const ros::Time &time, const ros::Duration &period) {
+    for (const DynamixelBusPtr &bus : buses_) {
+      bus->writeAsync(time, period);
+    }
+    for (const DynamixelBusPtr &bus : buses_) {
+      bus->wait();
+    }
+  }
+
+  // find the bus specified by param "bus". the param can be omitted if there is only one bus.
+  DynamixelBusPtr findBus(const ros::NodeHandle &ator_param_nh) const {
+    std::string bus_name;
+    if (!ator_param_nh.getParam("bus", bus_name)) {
+      if (buses_.size() == 1) {
+        return buses_.front();
+      }
+      ROS_ERROR_STREAM("DynamixelActuatorLayer::findBus(): Param '"
+                       << ator_param_nh.resolveName("bus")
+                       << "' is required when multiple buses are given");
+      return DynamixelBusPtr();
+    }
+    for (const DynamixelBusPtr &bus : buses_) {
+      if (bus->getName() == bus_name) {
+        return bus;
+      }
+    }
+    ROS_ERROR_STREAM("DynamixelActuatorLayer::findBus(): Unknown bus '"
+                     << bus_name << "' given by param '" << ator_param_nh.resolveName("bus")
+                     << "'");
+    return DynamixelBusPtr();
+  }
+
   // make an hardware interface registered. the interface must be in the static memory space
   // to allow access from outside of this plugin.
   template < typename Interface > static void makeRegistered(hi::RobotHW *const hw) {
@@ -124,9 +714,33 @@ private:
   }
 
 private:
-  DynamixelWorkbench dxl_wb_;
-  ControllerSet controllers_;
+  ErrorLogPtr error_log_;
+  std::vector< DynamixelBusPtr > buses_;
+  // keys of buses in the capability cache
+  std::map< DynamixelBusPtr, std::string > capability_ports_;
+  ControllerIds controller_ids_;
+  ControllerSet controllers_, updated_controllers_;
+  // all actuators on all buses, and their states & commands
   std::vector< DynamixelActuatorPtr > actuators_;
+  DynamixelActuatorStorePtr store_, handle_store_;
+
+  // summarizing latencies (optional)
+  int stats_window_, n_stats_cycles_;
+
+  // diagnosing round trips & error rates of buses (optional)
+  std::map< DynamixelBusPtr, DiagnosingBackendPtr > diagnostics_;
+  int diagnostics_window_, n_diagnostics_cycles_;
+
+  // states exported to shared memory in every read cycle (optional)
+  StateExporterPtr exporter_;
+
+  // dedicated thread for bus cycles (optional)
+  RealtimeThreadPtr io_thread_;
+  std::mutex io_mutex_;
+  ros::Time io_last_time_;
+  TripleBuffer< DynamixelActuatorStore > state_buffer_, cmd_buffer_;
+  // locations of additional values of actuators in snapshots
+  std::vector< std::size_t > state_offsets_, cmd_offsets_;
 };
 } // namespace layered_hardware_dynamixel
 
@@ -0,0 +1,120 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_DYNAMIXEL_ACTUATOR_STORE_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_DYNAMIXEL_ACTUATOR_STORE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace layered_hardware_dynamixel {
+
+// states & commands of all actuators in a layer, laid out as contiguous arrays indexed by
+// actuators so that per-cycle loops over actuators walk memory sequentially.
+// actuator data & hardware handles refer to elements, so arrays are never resized after init.
+struct DynamixelActuatorStore {
+  DynamixelActuatorStore(const std::size_t n_actuators = 0)
+      : reboot_status(n_actuators, 0), health_status(n_actuators, 0),
+        consecutive_failures(n_actuators, 0), stale_cycles(n_actuators, 0), pos(n_actuators, 0.),
+        vel(n_actuators, 0.),
+        eff(n_actuators, 0.), present_pos_value(n_actuators, 0), present_vel_value(n_actuators, 0),
+        present_eff_value(n_actuators, 0), pos_cmd(n_actuators, 0.), vel_cmd(n_actuators, 0.),
+        eff_cmd(n_actuators, 0.), prefetched_pos(n_actuators, 0.), prefetched_vel(n_actuators, 0.),
+        prefetched_eff(n_actuators, 0.), pos_zero_value(n_actuators, 0.),
+        pos_scale_plus(n_actuators, 0.), pos_scale_minus(n_actuators, 0.),
+        vel_scale(n_actuators, 0.), eff_scale(n_actuators, 0.),
+        pos_inv_scale_plus(n_actuators, 0.), pos_inv_scale_minus(n_actuators, 0.),
+        vel_inv_scale(n_actuators, 0.), eff_inv_scale(n_actuators, 0.) {}
+
+  std::size_t size() const { return pos.size(); }
+
+  //
+  // bulk copies of per-actuator arrays between stores of the same size.
+  // these never allocate memory. additional values are not copied.
+  //
+
+  void copyStatesFrom(const DynamixelActuatorStore &other) {
+    reboot_status = other.reboot_status;
+    health_status = other.health_status;
+    consecutive_failures = other.consecutive_failures;
+    stale_cycles = other.stale_cycles;
+    pos = other.pos;
+    vel = other.vel;
+    eff = other.eff;
+  }
+
+  void copyCommandsFrom(const DynamixelActuatorStore &other) {
+    pos_cmd = other.pos_cmd;
+    vel_cmd = other.vel_cmd;
+    eff_cmd = other.eff_cmd;
+  }
+
+  //
+  // conversion between raw values & SI units with the precomputed scales.
+  // these follow DynamixelWorkbench::convert*() on Protocol 2.0 without model lookups.
+  //
+
+  // raw present values of actuators in [begin, end) -> prefetched_* in one pass.
+  // the loop has no branches nor calls so that compilers can vectorize it.
+  void decodePrefetched(const std::size_t begin, const std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      const double pos_diff(present_pos_value[i] - pos_zero_value[i]);
+      prefetched_pos[i] = pos_diff * (pos_diff > 0. ? pos_scale_plus[i] : pos_scale_minus[i]);
+      prefetched_vel[i] = present_vel_value[i] * vel_scale[i];
+      prefetched_eff[i] = present_eff_value[i] * eff_scale[i];
+    }
+  }
+
+  double decodePosition(const std::size_t i, const std::int32_t value) const {
+    const double pos_diff(value - pos_zero_value[i]);
+    return pos_diff * (pos_diff > 0. ? pos_scale_plus[i] : pos_scale_minus[i]);
+  }
+
+  double decodeVelocity(const std::size_t i, const std::int32_t value) const {
+    return value * vel_scale[i];
+  }
+
+  double decodeEffort(const std::size_t i, const std::int32_t value) const {
+    return value * eff_scale[i];
+  }
+
+  std::int32_t encodePosition(const std::size_t i, const double pos) const {
+    return static_cast< std::int32_t >(
+        pos * (pos > 0. ? pos_inv_scale_plus[i] : pos_inv_scale_minus[i]) + pos_zero_value[i]);
+  }
+
+  std::int32_t encodeVelocity(const std::size_t i, const double vel) const {
+    return static_cast< std::int32_t >(vel * vel_inv_scale[i]);
+  }
+
+  std::int16_t encodeEffort(const std::size_t i, const double eff) const {
+    return static_cast< std::int16_t >(eff * eff_inv_scale[i]);
+  }
+
+  // states
+  std::vector< std::int32_t > reboot_status, health_status, consecutive_failures, stale_cycles;
+  std::vector< double > pos, vel, eff;
+
+  // raw present values prefetched by the group read
+  std::vector< std::int32_t > present_pos_value, present_vel_value, present_eff_value;
+
+  // commands
+  std::vector< double > pos_cmd, vel_cmd, eff_cmd;
+
+  // prefetched states decoded into SI units
+  std::vector< double > prefetched_pos, prefetched_vel, prefetched_eff;
+
+  // scales from raw values to rad (above & below the zero position), rad/s & N*m,
+  // and their inverses
+  std::vector< double > pos_zero_value, pos_scale_plus, pos_scale_minus, vel_scale, eff_scale;
+  std::vector< double > pos_inv_scale_plus, pos_inv_scale_minus, vel_inv_scale, eff_inv_scale;
+
+  // values of additional states & commands of all actuators in series.
+  // used only by snapshots exchanged between threads, and filled by the layer.
+  std::vector< std::int32_t > additional_states, additional_cmds;
+};
+
+typedef std::shared_ptr< DynamixelActuatorStore > DynamixelActuatorStorePtr;
+typedef std::shared_ptr< const DynamixelActuatorStore > DynamixelActuatorStoreConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
\ No newline at end of file
@@ -0,0 +1,513 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_DYNAMIXEL_BUS_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_DYNAMIXEL_BUS_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <layered_hardware_dynamixel/actuator_health.hpp>
+#include <layered_hardware_dynamixel/bus_backend.hpp>
+#include <layered_hardware_dynamixel/bus_scheduler.hpp>
+#include <layered_hardware_dynamixel/bus_timing.hpp>
+#include <layered_hardware_dynamixel/command_merger.hpp>
+#include <layered_hardware_dynamixel/common_namespaces.hpp>
+#include <layered_hardware_dynamixel/dynamixel_actuator.hpp>
+#include <layered_hardware_dynamixel/dynamixel_actuator_data.hpp>
+#include <layered_hardware_dynamixel/dynamixel_actuator_store.hpp>
+#include <layered_hardware_dynamixel/error_log.hpp>
+#include <layered_hardware_dynamixel/group_reader.hpp>
+#include <layered_hardware_dynamixel/group_writer.hpp>
+#include <layered_hardware_dynamixel/indirect_mapper.hpp>
+#include <layered_hardware_dynamixel/io_stats.hpp>
+#include <layered_hardware_dynamixel/switch_writer.hpp>
+#include <layered_hardware_dynamixel/worker_thread.hpp>
+#include <ros/console.h>
+#include <ros/duration.h>
+#include <ros/time.h>
+
+namespace layered_hardware_dynamixel {
+
+// a serial device and actuators on it
+class DynamixelBus {
+public:
+  DynamixelBus()
+      : baudrate_(0), error_log_(NULL), store_(NULL), store_begin_(0), store_end_(0),
+        n_read_cycles_(0), job_(NO_JOB) {}
+
+  virtual ~DynamixelBus() {
+    // stop the worker before actuators finalize their operating modes
+    if (worker_) {
+      worker_->stop();
+    }
+    // receive status packets in flight before actuators write on finalization
+    if (group_reader_) {
+      group_reader_->cancel();
+    }
+  }
+
+  // open the backend, WorkbenchBackend for a real device or SimulatedBackend
+  bool init(const std::string &name, const BusBackendPtr &dxl_wb,
+            const std::string &serial_interface, const int baudrate) {
+    name_ = name;
+    baudrate_ = baudrate;
+    dxl_wb_ = dxl_wb;
+    const char *log(NULL);
+    if (!dxl_wb_->init(serial_interface.c_str(), baudrate, &log)) {
+      ROS_ERROR_STREAM("DynamixelBus::init(): Failed to open the backend on '"
+                       << serial_interface << "' for the bus '" << name_
+                       << "': " << (log ? log : "No log from BusBackend::init()"));
+      return false;
+    }
+    return true;
+  }
+
+  std::string getName() const { return name_; }
+
+  BusBackend *getBackend() { return dxl_wb_.get(); }
+
+  // find actuators so that the workbench learns their models before actuators are initialized.
+  // one broadcast ping finds all actuators on Protocol 2.0, and each is pinged on Protocol 1.0.
+  // actuators not found are pinged again on their init.
+  // this blocks for the bus only, so multiple buses can discover actuators concurrently.
+  void discover(const std::vector< std::uint8_t > &ids) {
+    if (ids.empty()) {
+      return;
+    }
+    int n_found(0);
+    if (dxl_wb_->getProtocolVersion() == 2.0) {
+      std::uint8_t found_ids[253], n_found_ids(0);
+      const char *log(NULL);
+      if (!dxl_wb_->scan(found_ids, &n_found_ids, *std::max_element(ids.begin(), ids.end()),
+                         &log)) {
+        ROS_WARN_STREAM("DynamixelBus::discover(): Failed to broadcast a ping on the bus '"
+                        << name_ << "': " << (log ? log : "No log from BusBackend::scan()"));
+      }
+      for (const std::uint8_t id : ids) {
+        if (std::find(found_ids, found_ids + n_found_ids, id) != found_ids + n_found_ids) {
+          ++n_found;
+        }
+      }
+    } else {
+      for (const std::uint8_t id : ids) {
+        std::uint16_t model_number;
+        if (dxl_wb_->ping(id, &model_number)) {
+          ++n_found;
+        }
+      }
+    }
+    ROS_INFO_STREAM("DynamixelBus::discover(): Found " << n_found << " of " << ids.size()
+                                                       << " actuators on the bus '" << name_
+                                                       << "'");
+  }
+
+  // ping actuators repeatedly so that diagnostics measure round trips on the bus
+  void probe(const std::vector< std::uint8_t > &ids, const int n_pings) {
+    for (int i = 0; i < n_pings; ++i) {
+      for (const std::uint8_t id : ids) {
+        dxl_wb_->ping(id);
+      }
+    }
+  }
+
+  void addActuator(const DynamixelActuatorPtr &ator) { actuators_.push_back(ator); }
+
+  // report errors on bus cycles to the log, or log them immediately if NULL.
+  // call after all actuators are added.
+  void setErrorLog(ErrorLog *const error_log) {
+    error_log_ = error_log;
+    for (const DynamixelActuatorPtr &ator : actuators_) {
+      ator->getData()->error_log = error_log;
+    }
+    if (group_reader_) {
+      group_reader_->setErrorLog(error_log);
+    }
+    if (group_writer_) {
+      group_writer_->setErrorLog(error_log);
+    }
+    if (cmd_merger_) {
+      cmd_merger_->setErrorLog(error_log);
+    }
+  }
+
+  // prepare bus cycles after all actuators are added
+  bool initIO(const bool use_group_read, const bool use_group_write, const bool use_group_switch,
+              const bool use_indirect_read, const bool use_fast_read, const bool use_pipelined_read,
+              const bool use_merged_write) {
+    // spread polling of additional states with the same interval over cycles
+    // so that the bus load does not concentrate in specific cycles
+    std::map< int, int > n_states_per_interval;
+    for (const DynamixelActuatorPtr &ator : actuators_) {
+      for (Int32StateItem &state : ator->getData()->additional_states) {
+        state.phase = (n_states_per_interval[state.every]++) % state.every;
+      }
+    }
+
+    std::vector< DynamixelActuatorDataPtr > data_list;
+    for (const DynamixelActuatorPtr &ator : actuators_) {
+      data_list.push_back(ator->getData());
+    }
+
+    // find the range of actuators on the bus in the store to decode prefetched states at once.
+    // the layer allocates actuators on a bus contiguously.
+    store_ = NULL;
+    if (!data_list.empty()) {
+      store_ = data_list.front()->store;
+      store_begin_ = data_list.front()->index;
+      store_end_ = store_begin_;
+      for (const DynamixelActuatorDataPtr &data : data_list) {
+        if (data->store != store_ || data->index != store_end_) {
+          ROS_WARN_STREAM("DynamixelBus::initIO(): Actuators on the bus '"
+                          << name_
+                          << "' are not contiguous in the store. "
+                             "Prefetched states will be decoded individually.");
+          store_ = NULL;
+          break;
+        }
+        ++store_end_;
+      }
+    }
+
+    // mirror states of each actuator into one compact block (optional).
+    // this must precede the group read which assembles blocks from item addresses.
+    if (use_indirect_read) {
+      for (const DynamixelActuatorDataPtr &data : data_list) {
+        IndirectMapper::map(data.get());
+      }
+    }
+
+    // prepare reading states of all actuators in one transaction (optional)
+    if (use_group_read) {
+      // DynamixelWorkbench cannot send Fast Sync Read. tell it rather than reporting it enabled.
+      const bool fast_read(use_fast_read && dxl_wb_->supportsFastSyncRead());
+      if (use_fast_read && !fast_read) {
+        ROS_WARN_STREAM("DynamixelBus::initIO(): The bus '"
+                        << name_
+                        << "' cannot send Fast Sync Read. Param 'fast_read' is ignored and "
+                           "SyncRead is used instead.");
+      }
+      // nor can it split SyncRead. reject rather than running without the requested overlap.
+      if (use_pipelined_read && !dxl_wb_->supportsSplitSyncRead()) {
+        ROS_ERROR_STREAM("DynamixelBus::initIO(): The bus '"
+                         << name_
+                         << "' cannot split SyncRead. Param 'pipelined_read' is supported "
+                            "only on the simulated bus");
+        return false;
+      }
+      group_reader_.reset(new GroupReader());
+      group_reader_->setErrorLog(error_log_);
+      if (!group_reader_->init(dxl_wb_.get(), data_list, fast_read, use_pipelined_read)) {
+        ROS_ERROR_STREAM("DynamixelBus::initIO(): Failed to init the group reader for the bus '"
+                         << name_ << "'");
+        return false;
+      }
+      ROS_INFO_STREAM("DynamixelBus::initIO(): Initialized the group reader for the bus '"
+                      << name_ << "'");
+    }
+
+    // merge commands of each actuator into contiguous blocks (optional)
+    if (use_merged_write) {
+      cmd_merger_.reset(new CommandMerger());
+      cmd_merger_->setErrorLog(error_log_);
+      if (!cmd_merger_->init(dxl_wb_.get(), data_list)) {
+        ROS_ERROR_STREAM("DynamixelBus::initIO(): Failed to init the command merger for the bus '"
+                         << name_ << "'");
+        return false;
+      }
+      ROS_INFO_STREAM("DynamixelBus::initIO(): Initialized the command merger for the bus '"
+                      << name_ << "'");
+    }
+
+    // prepare writing commands to all actuators with a few transactions (optional)
+    if (use_group_write) {
+      group_writer_.reset(new GroupWriter());
+      group_writer_->setErrorLog(error_log_);
+      if (!group_writer_->init(dxl_wb_.get(), data_list, cmd_merger_.get())) {
+        ROS_ERROR_STREAM("DynamixelBus::initIO(): Failed to init the group writer for the bus '"
+                         << name_ << "'");
+        return false;
+      }
+      ROS_INFO_STREAM("DynamixelBus::initIO(): Initialized the group writer for the bus '"
+                      << name_ << "'");
+    }
+
+    // prepare writing mode-enable sequences of all actuators switching modes at once (optional)
+    if (use_group_switch) {
+      switch_writer_.reset(new SwitchWriter());
+      if (!switch_writer_->init(dxl_wb_.get(), data_list)) {
+        ROS_ERROR_STREAM("DynamixelBus::initIO(): Failed to init the switch writer for the bus '"
+                         << name_ << "'");
+        return false;
+      }
+      ROS_INFO_STREAM("DynamixelBus::initIO(): Initialized the switch writer for the bus '"
+                      << name_ << "'");
+    }
+
+    return true;
+  }
+
+  // fit cycles into the time budget by the estimated airtime. call after initIO().
+  void initScheduler(const double budget, const double status_latency, const int max_stale_cycles) {
+    std::vector< DynamixelActuatorDataPtr > data_list;
+    for (const DynamixelActuatorPtr &ator : actuators_) {
+      data_list.push_back(ator->getData());
+    }
+    scheduler_.reset(new BusScheduler());
+    scheduler_->init(BusTiming(baudrate_, dxl_wb_->getProtocolVersion() == 2.0, status_latency),
+                     budget, max_stale_cycles, data_list, static_cast< bool >(group_reader_),
+                     static_cast< bool >(group_writer_));
+  }
+
+  // let operating modes defer writes on switching if enabled.
+  // call before actuators begin switching.
+  void beginSwitch() {
+    // the prefetch follows read masks of the previous modes, and must not stay in flight
+    // while switching writes to actuators
+    if (group_reader_) {
+      group_reader_->cancel();
+    }
+    // writes on switching may change bytes known to the command merger
+    if (cmd_merger_) {
+      cmd_merger_->invalidate();
+    }
+    if (switch_writer_) {
+      switch_writer_->begin();
+    }
+  }
+
+  // write deferred writes on switching. call before actuators end switching.
+  void flushSwitch() {
+    if (switch_writer_ && !switch_writer_->flush() && stats_) {
+      stats_->countError();
+    }
+  }
+
+  // let the group read follow read masks of operating modes. call after switching modes.
+  void reconfigure() {
+    if (group_reader_) {
+      if (group_reader_->configure()) {
+        ROS_INFO_STREAM("DynamixelBus::reconfigure(): The group reader for the bus '"
+                        << name_ << "' uses "
+                        << (group_reader_->usesFastRead()
+                                ? "Fast Sync Read"
+                                : (group_reader_->usesSyncRead() ? "SyncRead" : "BulkRead"))
+                        << (group_reader_->usesPipelinedRead() ? " (pipelined)" : ""));
+      } else {
+        ROS_ERROR_STREAM("DynamixelBus::reconfigure(): Failed to configure the group reader "
+                         "for the bus '"
+                         << name_ << "'. States will be read individually.");
+      }
+    }
+  }
+
+  // record latencies & errors of the bus and actuators on it
+  void enableStats() {
+    stats_.reset(new IoStats());
+    for (const DynamixelActuatorPtr &ator : actuators_) {
+      ator->getData()->stats.reset(new IoStats());
+    }
+  }
+
+  IoStatsPtr getStats() const { return stats_; }
+
+  // take actuators offline after consecutive failed cycles & ping them with backoff
+  void enableHealth(const int max_failures, const ros::Duration &ping_interval,
+                    const ros::Duration &max_ping_interval) {
+    healths_.clear();
+    for (const DynamixelActuatorPtr &ator : actuators_) {
+      const ActuatorHealthPtr health(new ActuatorHealth());
+      health->init(ator->getData().get(), max_failures, ping_interval, max_ping_interval);
+      healths_.push_back(health);
+    }
+  }
+
+  void read(const ros::Time &time, const ros::Duration &period) {
+    const IoStats::Clock::time_point start(IoStats::now());
+
+    // receive states prefetched at the end of the last cycle before any other instruction
+    if (group_reader_ && !group_reader_->collect() && stats_) {
+      stats_->countError();
+    }
+
+    // ping offline actuators due for health checks if enabled
+    for (const ActuatorHealthPtr &health : healths_) {
+      health->poll(time);
+    }
+
+    // determine additional states to be read in this cycle
+    ++n_read_cycles_;
+    for (const DynamixelActuatorPtr &ator : actuators_) {
+      ator->scheduleRead(n_read_cycles_);
+    }
+    // defer reads which do not fit in the budget if enabled
+    cycle_start_ = start;
+    if (scheduler_) {
+      scheduler_->plan();
+    }
+
+    // prefetch states of all actuators in one transaction if enabled
+    if (group_reader_) {
+      if (!group_reader_->read() && stats_) {
+        stats_->countError();
+      }
+      // raw values -> SI units for all actuators on the bus in one pass
+      if (store_) {
+        store_->decodePrefetched(store_begin_, store_end_);
+      }
+    }
+
+    // read from all actuators except offline ones
+    for (const DynamixelActuatorPtr &ator : actuators_) {
+      if (ator->getData()->is_offline) {
+        continue;
+      }
+      const IoStatsPtr &ator_stats(ator->getData()->stats);
+      const IoStats::Clock::time_point ator_start(ator_stats ? IoStats::now()
+                                                             : IoStats::Clock::time_point());
+      ator->read(time, period);
+      if (ator_stats) {
+        ator_stats->recordRead(ator_start);
+      }
+    }
+
+    if (stats_) {
+      stats_->recordRead(start);
+    }
+  }
+
+  void write(const ros::Time &time, const ros::Duration &period) {
+    const IoStats::Clock::time_point start(IoStats::now());
+
+    // write to all actuators except offline ones
+    for (const DynamixelActuatorPtr &ator : actuators_) {
+      if (ator->getData()->is_offline) {
+        continue;
+      }
+      const IoStatsPtr &ator_stats(ator->getData()->stats);
+      const IoStats::Clock::time_point ator_start(ator_stats ? IoStats::now()
+                                                             : IoStats::Clock::time_point());
+      ator->write(time, period);
+      if (ator_stats) {
+        ator_stats->recordWrite(ator_start);
+      }
+    }
+
+    // flush commands staged by the actuators if enabled
+    if (group_writer_ ? !group_writer_->flush() : (cmd_merger_ && !cmd_merger_->flush())) {
+      if (stats_) {
+        stats_->countError();
+      }
+    }
+
+    // judge health of actuators by failures in the cycle if enabled
+    for (const ActuatorHealthPtr &health : healths_) {
+      health->update(time);
+    }
+
+    // send the read instruction for the next cycle so that status packets arrive
+    // while controllers run, if pipelined
+    if (group_reader_ && !group_reader_->prefetch() && stats_) {
+      stats_->countError();
+    }
+
+    if (stats_) {
+      stats_->recordWrite(start);
+    }
+
+    // count a cycle exceeded the budget if enabled
+    if (scheduler_ &&
+        scheduler_->finish(
+            std::chrono::duration< double >(IoStats::now() - cycle_start_).count()) &&
+        stats_) {
+      stats_->countOverrun();
+    }
+  }
+
+  //
+  // asynchronous read & write on the worker thread.
+  // state & command values of actuators on the bus must not be accessed until wait() returns.
+  //
+
+  void startWorker() {
+    worker_.reset(new WorkerThread());
+    worker_->start(std::bind(&DynamixelBus::runJob, this));
+  }
+
+  void readAsync(const ros::Time &time, const ros::Duration &period) {
+    startJob(READ_JOB, time, period);
+  }
+
+  void writeAsync(const ros::Time &time, const ros::Duration &period) {
+    startJob(WRITE_JOB, time, period);
+  }
+
+  // wait for the job. if the worker has not been started, the job is run here.
+  void wait() {
+    if (worker_) {
+      worker_->wait();
+    } else {
+      runJob();
+    }
+  }
+
+private:
+  enum Job { NO_JOB, READ_JOB, WRITE_JOB };
+
+  void startJob(const Job job, const ros::Time &time, const ros::Duration &period) {
+    job_ = job;
+    job_time_ = time;
+    job_period_ = period;
+    if (worker_) {
+      worker_->trigger();
+    }
+  }
+
+  void runJob() {
+    switch (job_) {
+    case READ_JOB:
+      read(job_time_, job_period_);
+      break;
+    case WRITE_JOB:
+      write(job_time_, job_period_);
+      break;
+    default:
+      break;
+    }
+    job_ = NO_JOB;
+  }
+
+private:
+  std::string name_;
+  int baudrate_;
+  // must be declared before actuators that use it on destruction
+  BusBackendPtr dxl_wb_;
+  std::vector< DynamixelActuatorPtr > actuators_;
+  ErrorLog *error_log_;
+  DynamixelActuatorStore *store_;
+  std::size_t store_begin_, store_end_;
+  GroupReaderPtr group_reader_;
+  CommandMergerPtr cmd_merger_;
+  GroupWriterPtr group_writer_;
+  SwitchWriterPtr switch_writer_;
+  BusSchedulerPtr scheduler_;
+  std::vector< ActuatorHealthPtr > healths_;
+  std::uint64_t n_read_cycles_;
+  IoStats::Clock::time_point cycle_start_;
+  IoStatsPtr stats_;
+
+  WorkerThreadPtr worker_;
+  Job job_;
+  ros::Time job_time_;
+  ros::Duration job_period_;
+};
+
+typedef std::shared_ptr< DynamixelBus > DynamixelBusPtr;
+typedef std::shared_ptr< const DynamixelBus > DynamixelBusConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
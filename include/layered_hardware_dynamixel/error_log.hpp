@@ -0,0 +1,265 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_ERROR_LOG_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_ERROR_LOG_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ros/console.h>
+
+namespace layered_hardware_dynamixel {
+
+// an error on the bus cycles, which refers to strings living as long as the layer
+// (literals, actuator & item names) and copies the volatile log from DynamixelWorkbench
+struct ErrorEntry {
+  ErrorEntry() : func(NULL), what(NULL), item(NULL), name(NULL), id(-1), address(-1) {
+    log[0] = '\0';
+  }
+
+  ErrorEntry(const char *const _func, const char *const _what, const char *const _item,
+             const char *const _name, const int _id, const int _address, const char *const _log)
+      : func(_func), what(_what), item(_item), name(_name), id(_id), address(_address) {
+    setLog(_log);
+  }
+
+  void setLog(const char *const _log) {
+    if (_log) {
+      std::strncpy(log, _log, LOG_LENGTH - 1);
+      log[LOG_LENGTH - 1] = '\0';
+    } else {
+      log[0] = '\0';
+    }
+  }
+
+  // like "GroupReader::read(): Failed to sync read item 'Present_Position' of 'joint1' (id: 1)
+  // at address 132: [TxRxResult] There is no status packet!"
+  std::string format() const {
+    std::ostringstream os;
+    os << func << "(): " << what;
+    if (item) {
+      os << " '" << item << "'";
+    }
+    if (name) {
+      os << " of '" << name << "' (id: " << id << ")";
+    }
+    if (address >= 0) {
+      os << " at address " << address;
+    }
+    os << ": " << (log[0] != '\0' ? log : "No log from DynamixelWorkbench");
+    return os.str();
+  }
+
+  static const std::size_t LOG_LENGTH = 128;
+
+  const char *func, *what, *item, *name;
+  int id, address;
+  char log[LOG_LENGTH];
+};
+
+// errors reported on bus cycles are pushed into a preallocated lock-free ring buffer
+// and logged by a non-realtime thread, so that a flaky actuator never makes
+// bus cycles allocate memory or block on logging. errors are dropped if the buffer is full.
+class ErrorLog {
+public:
+  ErrorLog(const std::size_t capacity = 256)
+      : slots_(roundUpToPowerOf2(capacity)), mask_(slots_.size() - 1), push_pos_(0), pop_pos_(0),
+        n_dropped_(0), summary_interval_(0.), n_summarized_(0), is_stopping_(false) {
+    for (std::size_t i = 0; i < slots_.size(); ++i) {
+      slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  virtual ~ErrorLog() { stop(); }
+
+  // report the error via the log, or log it immediately if no log is given
+  static void report(ErrorLog *const error_log, const ErrorEntry &entry) {
+    if (error_log) {
+      error_log->push(entry);
+    } else {
+      ROS_ERROR_STREAM(entry.format());
+    }
+  }
+
+  //
+  // recording side (any threads)
+  //
+
+  void push(const ErrorEntry &entry) {
+    std::size_t pos(push_pos_.load(std::memory_order_relaxed));
+    while (true) {
+      Slot &slot(slots_[pos & mask_]);
+      const std::size_t seq(slot.seq.load(std::memory_order_acquire));
+      const std::ptrdiff_t diff(static_cast< std::ptrdiff_t >(seq) -
+                                static_cast< std::ptrdiff_t >(pos));
+      if (diff == 0) {
+        if (push_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          slot.entry = entry;
+          slot.seq.store(pos + 1, std::memory_order_release);
+          return;
+        }
+      } else if (diff < 0) {
+        // full
+        n_dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+      } else {
+        pos = push_pos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  //
+  // logging side (the drain thread only)
+  //
+
+  // aggregate errors into one summary line per interval instead of logging each of them.
+  // call before start().
+  void setSummaryInterval(const double interval) { summary_interval_ = interval; }
+
+  // log all errors in the buffer, or add them to the summary.
+  // returns the number of drained errors.
+  std::size_t drain() {
+    std::size_t n_drained(0);
+    while (true) {
+      Slot &slot(slots_[pop_pos_ & mask_]);
+      if (slot.seq.load(std::memory_order_acquire) != pop_pos_ + 1) {
+        break;
+      }
+      if (summary_interval_ > 0.) {
+        summarize(slot.entry);
+      } else {
+        ROS_ERROR_STREAM(slot.entry.format());
+      }
+      slot.seq.store(pop_pos_ + slots_.size(), std::memory_order_release);
+      ++pop_pos_;
+      ++n_drained;
+    }
+    const std::uint64_t n_dropped(n_dropped_.exchange(0, std::memory_order_relaxed));
+    if (n_dropped > 0) {
+      ROS_ERROR_STREAM("ErrorLog::drain(): Dropped " << n_dropped
+                                                     << " errors because the buffer was full");
+    }
+    if (summary_interval_ > 0. && n_summarized_ > 0 &&
+        std::chrono::duration< double >(std::chrono::steady_clock::now() - summary_start_)
+                .count() >= summary_interval_) {
+      logSummary();
+    }
+    return n_drained;
+  }
+
+  // drain the buffer periodically on a dedicated thread
+  void start(const double period = 0.1) {
+    stop();
+    is_stopping_ = false;
+    thread_ = std::thread([this, period]() {
+      std::unique_lock< std::mutex > lock(mutex_);
+      while (!is_stopping_) {
+        cond_.wait_for(lock, std::chrono::duration< double >(period));
+        lock.unlock();
+        drain();
+        lock.lock();
+      }
+    });
+  }
+
+  void stop() {
+    if (!thread_.joinable()) {
+      return;
+    }
+    {
+      std::lock_guard< std::mutex > lock(mutex_);
+      is_stopping_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+    // log errors reported since the last drain
+    drain();
+    if (n_summarized_ > 0) {
+      logSummary();
+    }
+  }
+
+private:
+  struct Slot {
+    std::atomic< std::size_t > seq;
+    ErrorEntry entry;
+  };
+
+  // the number of errors & the last error of a source (an actuator or a bus)
+  struct Summary {
+    Summary() : n_errors(0) {}
+
+    std::size_t n_errors;
+    std::string last_error;
+  };
+
+  void summarize(const ErrorEntry &entry) {
+    if (n_summarized_ == 0) {
+      summary_start_ = std::chrono::steady_clock::now();
+    }
+    Summary &summary(summaries_[entry.name ? entry.name : "bus"]);
+    ++summary.n_errors;
+    summary.last_error = entry.format();
+    ++n_summarized_;
+  }
+
+  // like "ErrorLog::logSummary(): 1500 errors in the last 1.0 s (joint1: 1499, bus: 1).
+  // last errors: ..."
+  void logSummary() {
+    std::ostringstream counts, last_errors;
+    for (const std::map< std::string, Summary >::value_type &summary : summaries_) {
+      counts << (counts.tellp() > 0 ? ", " : "") << summary.first << ": "
+             << summary.second.n_errors;
+      last_errors << " [" << summary.second.last_error << "]";
+    }
+    ROS_ERROR_STREAM("ErrorLog::logSummary(): "
+                     << n_summarized_ << " errors in the last "
+                     << std::chrono::duration< double >(std::chrono::steady_clock::now() -
+                                                        summary_start_)
+                            .count()
+                     << " s (" << counts.str() << "). last errors:" << last_errors.str());
+    summaries_.clear();
+    n_summarized_ = 0;
+  }
+
+  static std::size_t roundUpToPowerOf2(const std::size_t n) {
+    std::size_t p(1);
+    while (p < n) {
+      p <<= 1;
+    }
+    return p;
+  }
+
+private:
+  std::vector< Slot > slots_;
+  const std::size_t mask_;
+  std::atomic< std::size_t > push_pos_;
+  std::size_t pop_pos_;
+  std::atomic< std::uint64_t > n_dropped_;
+
+  // aggregation of errors on the drain thread (optional)
+  double summary_interval_;
+  std::map< std::string, Summary > summaries_;
+  std::size_t n_summarized_;
+  std::chrono::steady_clock::time_point summary_start_;
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool is_stopping_;
+};
+
+typedef std::shared_ptr< ErrorLog > ErrorLogPtr;
+typedef std::shared_ptr< const ErrorLog > ErrorLogConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
@@ -3,9 +3,9 @@
 
 #include <cmath>
 #include <cstdint>
-#include <limits>
 #include <map>
 #include <string>
+#include <vector>
 
 #include <layered_hardware_dynamixel/common_namespaces.hpp>
 #include <layered_hardware_dynamixel/dynamixel_actuator_data.hpp>
@@ -23,44 +23,39 @@ public:
                        const std::map< std::string, std::int32_t > &item_map)
       : OperatingModeBase("extended_position", data), item_map_(item_map) {}
 
-  virtual void starting() override {
+  virtual void startWriting() override {
     // switch to extended-position mode & torque enable
-    enableOperatingMode(&DynamixelWorkbench::setExtendedPositionControlMode);
+    enableOperatingMode(&BusBackend::setExtendedPositionControlMode);
 
     writeItems(item_map_);
+  }
 
+  virtual void starting() override {
     // use the present position as the initial command
     readAllStates();
     data_->pos_cmd = data_->pos;
-    prev_pos_cmd_ = std::numeric_limits< double >::quiet_NaN();
     data_->vel_cmd = 0.;
-    prev_vel_cmd_ = std::numeric_limits< double >::quiet_NaN();
+    invalidateCommands();
 
-    readItems(&data_->additional_cmds);
-    prev_additional_cmds_ = data_->additional_cmds;
+    readAdditionalCommands();
 
     cached_pos_ = boost::none;
   }
 
   virtual void read(const ros::Time &time, const ros::Duration &period) override {
-    // read pos, vel, eff, etc
-    readAllStates();
+    // read pos, vel, eff, etc as specified by the read mask
+    readStates();
   }
 
   virtual void write(const ros::Time &time, const ros::Duration &period) override {
     // write profile velocity if updated
-    const bool do_write_vel(!std::isnan(data_->vel_cmd) &&
-                            areNotEqual(data_->vel_cmd, prev_vel_cmd_));
-    if (do_write_vel) {
-      writeProfileVelocity();
-      prev_vel_cmd_ = data_->vel_cmd;
-    }
+    const bool do_write_vel(updateProfileVelocity());
 
     // if the profile velocity is 0, the user would want the actuator
     // to stop at the present position but 0 actually means unlimited.
     // to solve this mismatch, freeze the position command on that case.
     const bool do_freeze_pos(!std::isnan(data_->vel_cmd) &&
-                             data_->dxl_wb->convertVelocity2Value(data_->id, data_->vel_cmd) == 0);
+                             encodeVelocity(data_->vel_cmd) == 0);
     if (do_freeze_pos) {
       if (!cached_pos_) {
         cached_pos_ = data_->pos;
@@ -72,30 +67,16 @@ public:
 
     // write goal position if the goal pos or profile velocity have been updated
     // to make the change affect
-    const bool do_write_pos(!std::isnan(data_->pos_cmd) &&
-                            (do_write_vel || areNotEqual(data_->pos_cmd, prev_pos_cmd_)));
-    if (do_write_pos) {
-      writePositionCommand();
-      prev_pos_cmd_ = data_->pos_cmd;
-    }
+    updatePositionCommand(/* force = */ do_write_vel);
 
     // write additional commands only when commands are updated
-    for (const std::map< std::string, std::int32_t >::value_type &cmd : data_->additional_cmds) {
-      std::int32_t &prev_cmd(prev_additional_cmds_[cmd.first]);
-      const bool do_write_cmd(cmd.second != prev_cmd);
-      if (do_write_cmd) {
-        writeItem(cmd.first, cmd.second);
-        prev_cmd = cmd.second;
-      }
-    }
+    updateAdditionalCommands();
   }
 
   virtual void stopping() override { torqueOff(); }
 
 private:
   const std::map< std::string, std::int32_t > item_map_;
-  double prev_pos_cmd_, prev_vel_cmd_;
-  std::map< std::string, std::int32_t > prev_additional_cmds_;
   boost::optional< double > cached_pos_;
 };
 } // namespace layered_hardware_dynamixel
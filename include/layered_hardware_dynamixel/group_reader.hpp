@@ -0,0 +1,512 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_GROUP_READER_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_GROUP_READER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <layered_hardware_dynamixel/bus_backend.hpp>
+#include <layered_hardware_dynamixel/common_namespaces.hpp>
+#include <layered_hardware_dynamixel/dynamixel_actuator_data.hpp>
+#include <layered_hardware_dynamixel/error_log.hpp>
+#include <ros/console.h>
+
+namespace layered_hardware_dynamixel {
+
+// reads present position, velocity & current of all actuators on a bus in one transaction.
+// only states in the read mask of each actuator's operating mode are assembled into the block.
+// uses SyncRead if the blocks of all actuators are the same on Protocol 2.0,
+// otherwise uses BulkRead. additional states due in a cycle are folded into the transaction
+// by BulkRead of the block covering all additional states for each actuator.
+// the layout of BulkRead is fixed while read masks & availabilities of actuators are,
+// because registering it to DynamixelWorkbench reallocates buffers.
+// if requested, Fast Sync Read, where all actuators answer in one concatenated status packet,
+// replaces SyncRead when every actuator and the transport support it.
+// if also requested, SyncRead is pipelined: the instruction for the next cycle is sent
+// right after commands of the present cycle, and its status packets arrive while
+// controllers run so that the next read() only collects them.
+class GroupReader {
+public:
+  GroupReader()
+      : dxl_wb_(NULL), error_log_(NULL), is_protocol2_(false), use_sync_read_(false),
+        sync_read_index_(0), has_bulk_read_(false), has_fast_read_(false),
+        has_pipelined_read_(false), is_prefetching_(false), is_collected_(false),
+        in_sync_read_(false) {}
+
+  virtual ~GroupReader() {}
+
+  bool init(BusBackend *const dxl_wb, const std::vector< DynamixelActuatorDataPtr > &data_list,
+            const bool use_fast_read = false, const bool use_pipelined_read = false) {
+    dxl_wb_ = dxl_wb;
+    data_list_ = data_list;
+    members_.assign(data_list_.size(), Member());
+    ids_.clear();
+    for (const DynamixelActuatorDataPtr &data : data_list_) {
+      ids_.push_back(data->id);
+    }
+    sync_read_handlers_.clear();
+    is_protocol2_ = (dxl_wb_->getProtocolVersion() == 2.0);
+
+    if (data_list_.empty()) {
+      return true;
+    }
+
+    // prepare BulkRead in advance because read masks may change the layout of blocks on switching.
+    // SyncRead is still available on Protocol 2.0 even if BulkRead is not.
+    const char *log(NULL);
+    has_bulk_read_ = dxl_wb_->initBulkRead(&log);
+    if (!has_bulk_read_) {
+      if (!is_protocol2_) {
+        ROS_ERROR_STREAM("GroupReader::init(): Failed to init bulk read: "
+                         << (log ? log : "No log from DynamixelWorkbench::initBulkRead()"));
+        return false;
+      }
+      ROS_WARN_STREAM("GroupReader::init(): Failed to init bulk read. Additional states and "
+                      "non-uniform blocks are read individually: "
+                      << (log ? log : "No log from DynamixelWorkbench::initBulkRead()"));
+    }
+
+    has_fast_read_ = use_fast_read && initFastRead();
+    has_pipelined_read_ = use_pipelined_read && initPipelinedRead();
+
+    return configure();
+  }
+
+  // update the block to be read for each actuator according to its read mask.
+  // call this after operating modes are switched.
+  bool configure() {
+    sync_ids_.clear();
+    for (std::size_t i = 0; i < members_.size(); ++i) {
+      const DynamixelActuatorData &data(*data_list_[i]);
+      Member &member(members_[i]);
+      std::uint16_t start(0), end(0);
+      if (data.read_mask & READ_POSITION) {
+        cover(data.present_pos_item, &start, &end);
+      }
+      if (data.read_mask & READ_VELOCITY) {
+        cover(data.present_vel_item, &start, &end);
+      }
+      // some models do not offer present current
+      if (data.read_mask & READ_EFFORT) {
+        cover(data.present_eff_item, &start, &end);
+      }
+      member.start = start;
+      member.length = end - start;
+      if (member.length > 0) {
+        sync_ids_.push_back(ids_[i]);
+      }
+      if (has_bulk_read_ && (data.read_mask & READ_ADDITIONAL_STATES)) {
+        for (const Int32StateItem &state : data.additional_states) {
+          cover(state.info, &start, &end);
+        }
+      }
+      member.full_start = start;
+      member.full_length = end - start;
+    }
+
+    // use SyncRead if possible because it requires no per-actuator params in the instruction.
+    // actuators reading no core states just do not participate in SyncRead.
+    use_sync_read_ = is_protocol2_ && !sync_ids_.empty();
+    const Member *first(NULL);
+    for (const Member &member : members_) {
+      if (member.length == 0) {
+        continue;
+      }
+      if (!first) {
+        first = &member;
+      } else if (member.start != first->start || member.length != first->length) {
+        use_sync_read_ = false;
+        break;
+      }
+    }
+    if (use_sync_read_ && !findSyncReadHandler(first->start, first->length, &sync_read_index_)) {
+      use_sync_read_ = false;
+    }
+
+    if (!use_sync_read_ && !sync_ids_.empty() && !has_bulk_read_) {
+      ROS_ERROR("GroupReader::configure(): Neither SyncRead nor BulkRead is available "
+                "for the present read masks");
+      return false;
+    }
+
+    // register the blocks to BulkRead in advance so that cycles never do.
+    // read() retries the registration on failures.
+    if (has_bulk_read_) {
+      updateBulkReadParams();
+    }
+    return true;
+  }
+
+  // report errors on read() to the log instead of logging them immediately
+  void setErrorLog(ErrorLog *const error_log) { error_log_ = error_log; }
+
+  bool usesSyncRead() const { return use_sync_read_; }
+
+  bool usesFastRead() const { return use_sync_read_ && has_fast_read_; }
+
+  bool usesPipelinedRead() const { return use_sync_read_ && has_pipelined_read_; }
+
+  // send the SyncRead instruction for the next cycle if pipelined.
+  // call right after commands are flushed. no instruction may be sent until collect().
+  bool prefetch() {
+    if (!usesPipelinedRead() || is_prefetching_) {
+      return true;
+    }
+    // SyncRead has the fixed list of participants which must all answer
+    for (std::size_t i = 0; i < members_.size(); ++i) {
+      if (members_[i].length > 0 && !data_list_[i]->is_available) {
+        return true;
+      }
+    }
+    const char *log(NULL);
+    if (has_fast_read_
+            ? !dxl_wb_->beginFastSyncRead(sync_read_index_, &sync_ids_[0], sync_ids_.size(), &log)
+            : !dxl_wb_->beginSyncRead(sync_read_index_, &sync_ids_[0], sync_ids_.size(), &log)) {
+      ErrorLog::report(error_log_, ErrorEntry("GroupReader::prefetch", "Failed to begin sync read",
+                                              NULL, NULL, -1, -1, log));
+      return false;
+    }
+    is_prefetching_ = true;
+    return true;
+  }
+
+  // receive status packets of the prefetch if any. call before any other instruction.
+  // read() extracts them.
+  bool collect() {
+    if (!is_prefetching_) {
+      return true;
+    }
+    is_prefetching_ = false;
+    const char *log(NULL);
+    if (!dxl_wb_->finishSyncRead(sync_read_index_, &log)) {
+      ErrorLog::report(error_log_, ErrorEntry("GroupReader::collect", "Failed to finish sync read",
+                                              NULL, NULL, -1, -1, log));
+      return false;
+    }
+    is_collected_ = true;
+    return true;
+  }
+
+  // receive and discard the prefetch, e.g. before switching operating modes
+  // which may change read masks
+  void cancel() {
+    collect();
+    is_collected_ = false;
+  }
+
+  bool read() {
+    // invalidate previously prefetched states
+    for (const DynamixelActuatorDataPtr &data : data_list_) {
+      data->has_prefetched_states = false;
+    }
+
+    // core states collected from the prefetch are no longer read in the present cycle.
+    // they override deferrals by the bus scheduler because they have been paid for.
+    bool result(collect());
+    const bool has_collected(is_collected_);
+    is_collected_ = false;
+    if (has_collected) {
+      for (std::size_t i = 0; i < members_.size(); ++i) {
+        DynamixelActuatorData &data(*data_list_[i]);
+        if (members_[i].length == 0) {
+          continue;
+        }
+        data.defers_core_states = false;
+        data.has_prefetched_states = getCoreStates(i, true);
+      }
+    }
+
+    // check what to be read in the present cycle
+    bool has_due_states(false), has_blocks(false), has_unavailable(false), has_deferred(false);
+    for (std::size_t i = 0; i < members_.size(); ++i) {
+      const DynamixelActuatorData &data(*data_list_[i]);
+      const Member &member(members_[i]);
+      // skip unavailable actuators because they would fail the whole transaction
+      if (!data.is_available) {
+        has_unavailable = has_unavailable || member.length > 0;
+        continue;
+      }
+      has_deferred = has_deferred || (data.defers_core_states && member.length > 0);
+      has_blocks = has_blocks || (!has_collected && !data.defers_core_states && member.length > 0);
+      if (has_bulk_read_ && (data.read_mask & READ_ADDITIONAL_STATES)) {
+        for (const Int32StateItem &state : data.additional_states) {
+          has_due_states = has_due_states || state.is_due;
+        }
+      }
+    }
+    has_blocks = has_blocks || has_due_states;
+    if (!has_blocks) {
+      return result;
+    }
+
+    // transfer the instruction and receive status packets from all participating actuators.
+    // SyncRead has the fixed list of participants so an unavailable one makes it BulkRead.
+    // BulkRead reads the whole blocks of all available actuators, whether each part is
+    // required in the present cycle or not, to keep its layout.
+    in_sync_read_ = use_sync_read_ && !has_collected && !has_due_states && !has_unavailable &&
+                    !has_deferred;
+    const char *log(NULL);
+    if (in_sync_read_) {
+      if (has_fast_read_
+              ? !dxl_wb_->fastSyncRead(sync_read_index_, &sync_ids_[0], sync_ids_.size(), &log)
+              : !dxl_wb_->syncRead(sync_read_index_, &sync_ids_[0], sync_ids_.size(), &log)) {
+        ErrorLog::report(error_log_, ErrorEntry("GroupReader::read", "Failed to sync read", NULL,
+                                                NULL, -1, -1, log));
+        return false;
+      }
+    } else {
+      if (!has_bulk_read_ || !updateBulkReadParams()) {
+        return false;
+      }
+      if (!dxl_wb_->bulkRead(&log)) {
+        ErrorLog::report(error_log_, ErrorEntry("GroupReader::read", "Failed to bulk read", NULL,
+                                                NULL, -1, -1, log));
+        return false;
+      }
+    }
+
+    // extract received values. operating modes will decode them into SI units.
+    for (std::size_t i = 0; i < members_.size(); ++i) {
+      DynamixelActuatorData &data(*data_list_[i]);
+      const Member &member(members_[i]);
+      if (in_sync_read_ ? member.length == 0 : member.bulk_length == 0) {
+        continue;
+      }
+      // core states deferred by the bus scheduler are also taken from the block
+      // because they have been paid for. collected ones are newer than the block.
+      if (!has_collected && member.length > 0) {
+        if (!getCoreStates(i, in_sync_read_)) {
+          continue;
+        }
+        data.defers_core_states = false;
+        data.has_prefetched_states = true;
+      }
+      // operating modes will skip reading additional states which are no longer due
+      if (in_sync_read_ || !(data.read_mask & READ_ADDITIONAL_STATES)) {
+        continue;
+      }
+      for (Int32StateItem &state : data.additional_states) {
+        if (state.is_due && getData(i, state.info, false, &state.value)) {
+          state.is_due = false;
+        }
+      }
+    }
+
+    return result;
+  }
+
+private:
+  struct Member {
+    Member() : start(0), length(0), full_start(0), full_length(0), bulk_start(0), bulk_length(0) {}
+
+    // block of the masked present states
+    std::uint16_t start, length;
+    // block of the masked present states & all additional states
+    std::uint16_t full_start, full_length;
+    // block registered to BulkRead
+    std::uint16_t bulk_start, bulk_length;
+  };
+
+  // the first firmware version of X-series with Fast Sync Read
+  static const std::int32_t MIN_FAST_READ_FIRMWARE_VERSION = 45;
+
+  struct SyncReadHandler {
+    std::uint16_t start, length;
+    std::uint8_t index;
+  };
+
+  // check if Fast Sync Read is available for all actuators.
+  // returns false to fall back to SyncRead if any of them lacks the support.
+  bool initFastRead() {
+    if (!is_protocol2_) {
+      ROS_WARN("GroupReader::initFastRead(): Fast Sync Read requires Protocol 2.0. "
+               "SyncRead or BulkRead is used instead.");
+      return false;
+    }
+    // WorkbenchBackend cannot send it because DynamixelWorkbench offers no packet handler.
+    // checked first not to read firmware versions in vain.
+    if (!dxl_wb_->supportsFastSyncRead()) {
+      ROS_WARN("GroupReader::initFastRead(): The backend does not support Fast Sync Read. "
+               "SyncRead is used instead.");
+      return false;
+    }
+    for (const DynamixelActuatorDataPtr &data : data_list_) {
+      // the actuator may have read it on init for the capability cache
+      std::int32_t firmware_version(data->firmware_version ? *data->firmware_version : 0);
+      const char *log(NULL);
+      if (!data->firmware_version &&
+          !dxl_wb_->readRegister(data->id, "Firmware_Version", &firmware_version, &log)) {
+        ROS_WARN_STREAM("GroupReader::initFastRead(): Failed to read the firmware version of '"
+                        << data->name << "' (id: " << static_cast< int >(data->id)
+                        << "). SyncRead is used instead of Fast Sync Read: "
+                        << (log ? log : "No log from DynamixelWorkbench::readRegister()"));
+        return false;
+      }
+      if (firmware_version < MIN_FAST_READ_FIRMWARE_VERSION) {
+        ROS_WARN_STREAM("GroupReader::initFastRead(): The firmware version "
+                        << firmware_version << " of '" << data->name
+                        << "' (id: " << static_cast< int >(data->id)
+                        << ") does not support Fast Sync Read (requires "
+                        << MIN_FAST_READ_FIRMWARE_VERSION << " or later). "
+                        << "SyncRead is used instead.");
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // check if the backend can send SyncRead in two phases.
+  // returns false to read states within each cycle if not.
+  bool initPipelinedRead() {
+    if (!is_protocol2_) {
+      ROS_WARN("GroupReader::initPipelinedRead(): Pipelined SyncRead requires Protocol 2.0. "
+               "States are read within each cycle instead.");
+      return false;
+    }
+    // WorkbenchBackend cannot because DynamixelWorkbench sends & receives in one call
+    if (!dxl_wb_->supportsSplitSyncRead()) {
+      ROS_WARN("GroupReader::initPipelinedRead(): The backend cannot split SyncRead. "
+               "States are read within each cycle instead.");
+      return false;
+    }
+    return true;
+  }
+
+  // register the whole blocks of available actuators to BulkRead.
+  // the registration reallocates buffers in DynamixelWorkbench, so it is done only if
+  // read masks have been changed by switching or availabilities by failures & recoveries.
+  bool updateBulkReadParams() {
+    bool is_changed(false);
+    for (std::size_t i = 0; i < members_.size(); ++i) {
+      const Member &member(members_[i]);
+      const std::uint16_t length(data_list_[i]->is_available ? member.full_length : 0);
+      if ((length > 0 && member.full_start != member.bulk_start) ||
+          length != member.bulk_length) {
+        is_changed = true;
+        break;
+      }
+    }
+    if (!is_changed) {
+      return true;
+    }
+
+    dxl_wb_->clearBulkReadParam();
+    for (std::size_t i = 0; i < members_.size(); ++i) {
+      Member &member(members_[i]);
+      member.bulk_start = member.bulk_length = 0;
+      if (!data_list_[i]->is_available || member.full_length == 0) {
+        continue;
+      }
+      const char *log(NULL);
+      if (!dxl_wb_->addBulkReadParam(ids_[i], member.full_start, member.full_length, &log)) {
+        ErrorLog::report(error_log_, ErrorEntry("GroupReader::updateBulkReadParams",
+                                                "Failed to add a bulk read param", NULL,
+                                                data_list_[i]->name.c_str(), ids_[i],
+                                                member.full_start, log));
+        // force re-registration in the next cycle
+        for (Member &m : members_) {
+          m.bulk_start = m.bulk_length = 0;
+        }
+        return false;
+      }
+      member.bulk_start = member.full_start;
+      member.bulk_length = member.full_length;
+    }
+    return true;
+  }
+
+  // find or add the SyncRead handler for the block.
+  // DynamixelWorkbench can hold a few handlers only, so they are reused among read masks.
+  bool findSyncReadHandler(const std::uint16_t start, const std::uint16_t length,
+                           std::uint8_t *const index) {
+    for (const SyncReadHandler &handler : sync_read_handlers_) {
+      if (handler.start == start && handler.length == length) {
+        *index = handler.index;
+        return true;
+      }
+    }
+    const SyncReadHandler handler = {start, length, dxl_wb_->getTheNumberOfSyncReadHandler()};
+    const char *log(NULL);
+    if (!dxl_wb_->addSyncReadHandler(start, length, &log)) {
+      ROS_WARN_STREAM("GroupReader::findSyncReadHandler(): Failed to add a sync read handler. "
+                      "BulkRead is used instead: "
+                      << (log ? log : "No log from DynamixelWorkbench::addSyncReadHandler()"));
+      return false;
+    }
+    sync_read_handlers_.push_back(handler);
+    *index = handler.index;
+    return true;
+  }
+
+  // extend the block [*start, *end) to cover the item. the block is empty if *start == *end.
+  static void cover(const ItemInfo &item, std::uint16_t *const start, std::uint16_t *const end) {
+    if (!item.isAvailable()) {
+      return;
+    }
+    if (*start == *end) {
+      *start = item.address;
+      *end = item.address + item.length;
+      return;
+    }
+    *start = std::min(*start, item.address);
+    *end = std::max< std::uint16_t >(*end, item.address + item.length);
+  }
+
+  // masked present states of the actuator from SyncRead or BulkRead
+  bool getCoreStates(const std::size_t i, const bool from_sync_read) {
+    DynamixelActuatorData &data(*data_list_[i]);
+    return (!(data.read_mask & READ_POSITION) ||
+            getData(i, data.present_pos_item, from_sync_read, &data.present_pos_value)) &&
+           (!(data.read_mask & READ_VELOCITY) ||
+            getData(i, data.present_vel_item, from_sync_read, &data.present_vel_value)) &&
+           (!(data.read_mask & READ_EFFORT) || !data.present_eff_item.isAvailable() ||
+            getData(i, data.present_eff_item, from_sync_read, &data.present_eff_value));
+  }
+
+  bool getData(const std::size_t i, const ItemInfo &item, const bool from_sync_read,
+               std::int32_t *const value) {
+    std::uint8_t id(ids_[i]);
+    std::uint16_t address(item.address), length(item.length);
+    std::int32_t raw_value;
+    const char *log(NULL);
+    if (from_sync_read
+            ? !dxl_wb_->getSyncReadData(sync_read_index_, &id, 1, address, length, &raw_value, &log)
+            : !dxl_wb_->getBulkReadData(&id, 1, &address, &length, &raw_value, &log)) {
+      ErrorLog::report(error_log_,
+                       ErrorEntry("GroupReader::getData", "Failed to get received data of item",
+                                  item.name.c_str(), data_list_[i]->name.c_str(), id, address,
+                                  log));
+      return false;
+    }
+    // restore the sign of values shorter than 4 bytes
+    *value = item.decode(static_cast< std::uint32_t >(raw_value));
+    return true;
+  }
+
+private:
+  BusBackend *dxl_wb_;
+  ErrorLog *error_log_;
+  std::vector< DynamixelActuatorDataPtr > data_list_;
+  std::vector< Member > members_;
+  std::vector< std::uint8_t > ids_;
+  bool is_protocol2_;
+  // actuators participating in SyncRead & the handler
+  std::vector< std::uint8_t > sync_ids_;
+  std::vector< SyncReadHandler > sync_read_handlers_;
+  bool use_sync_read_;
+  std::uint8_t sync_read_index_;
+  bool has_bulk_read_;
+  // true if SyncRead can be replaced with Fast Sync Read
+  bool has_fast_read_;
+  // true if SyncRead can be pipelined, and the state of the prefetch
+  bool has_pipelined_read_;
+  bool is_prefetching_, is_collected_;
+  bool in_sync_read_;
+};
+
+typedef std::shared_ptr< GroupReader > GroupReaderPtr;
+typedef std::shared_ptr< const GroupReader > GroupReaderConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
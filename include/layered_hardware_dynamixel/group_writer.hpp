@@ -0,0 +1,299 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_GROUP_WRITER_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_GROUP_WRITER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <layered_hardware_dynamixel/bus_backend.hpp>
+#include <layered_hardware_dynamixel/command_merger.hpp>
+#include <layered_hardware_dynamixel/common_namespaces.hpp>
+#include <layered_hardware_dynamixel/dynamixel_actuator_data.hpp>
+#include <layered_hardware_dynamixel/error_log.hpp>
+#include <ros/console.h>
+
+namespace layered_hardware_dynamixel {
+
+// writes commands staged by operating modes of all actuators on a bus once per cycle.
+// commands to the same control table address are merged into one SyncWrite.
+// with the command merger, commands of each actuator are merged into blocks first,
+// and the same blocks of all actuators into one SyncWrite.
+class GroupWriter {
+public:
+  GroupWriter() : dxl_wb_(NULL), error_log_(NULL), merger_(NULL) {}
+
+  virtual ~GroupWriter() {}
+
+  bool init(BusBackend *const dxl_wb, const std::vector< DynamixelActuatorDataPtr > &data_list,
+            CommandMerger *const merger = NULL) {
+    dxl_wb_ = dxl_wb;
+    data_list_ = data_list;
+    merger_ = merger;
+    batches_.clear();
+    rejected_blocks_.clear();
+
+    // items which operating modes may write every cycle. the goal position is the last
+    // because writing it should take effect of other commands like the profile velocity.
+    for (const DynamixelActuatorDataPtr &data : data_list_) {
+      addBatch(data->profile_vel_item);
+      addBatch(data->goal_eff_item);
+      addBatch(data->goal_vel_item);
+    }
+    for (const DynamixelActuatorDataPtr &data : data_list_) {
+      for (const Int32Item &cmd : data->additional_cmds) {
+        addBatch(cmd.info);
+      }
+    }
+    for (const DynamixelActuatorDataPtr &data : data_list_) {
+      addBatch(data->goal_pos_item);
+    }
+
+    // let operating modes stage commands instead of writing them immediately
+    for (const DynamixelActuatorDataPtr &data : data_list_) {
+      data->stages_cmds = true;
+      data->staged_cmds.clear();
+      data->staged_cmds.reserve(4 + data->additional_cmds.size());
+    }
+
+    return true;
+  }
+
+  // report errors on flush() to the log instead of logging them immediately
+  void setErrorLog(ErrorLog *const error_log) { error_log_ = error_log; }
+
+  bool flush() {
+    bool result(true);
+
+    // sort staged commands into batches.
+    // commands without the corresponding batch are written immediately.
+    // commands to unavailable actuators are discarded.
+    for (std::size_t i = 0; i < data_list_.size(); ++i) {
+      const DynamixelActuatorDataPtr &data(data_list_[i]);
+      if (merger_) {
+        if (!stageBlocks(i)) {
+          result = false;
+        }
+        continue;
+      }
+      if (!data->is_available) {
+        data->staged_cmds.clear();
+        continue;
+      }
+      for (const StagedItem &item : data->staged_cmds) {
+        Batch *const batch(findBatch(item.address, item.length));
+        if (batch) {
+          batch->ids.push_back(data->id);
+          batch->values.push_back(item.value);
+        } else if (!writeItem(*data, item)) {
+          result = false;
+        }
+      }
+      data->staged_cmds.clear();
+    }
+
+    // write batched commands with one instruction packet for each
+    for (Batch &batch : batches_) {
+      if (batch.ids.empty()) {
+        continue;
+      }
+      const char *log(NULL);
+      const bool is_written(dxl_wb_->syncWrite(batch.index, &batch.ids[0], batch.ids.size(),
+                                               &batch.values[0], batch.n_words, &log));
+      if (!is_written) {
+        ErrorLog::report(error_log_, ErrorEntry("GroupWriter::flush", "Failed to sync write", NULL,
+                                                NULL, -1, batch.address, log));
+        result = false;
+      }
+      if (merger_) {
+        commitBlocks(batch, is_written);
+      }
+      batch.ids.clear();
+      batch.members.clear();
+      batch.n_items.clear();
+      batch.values.clear();
+    }
+
+    return result;
+  }
+
+private:
+  struct Batch {
+    std::uint16_t address, length;
+    std::uint8_t index;
+    // values for each actuator are packed in 4 bytes each as DynamixelWorkbench::syncWrite()
+    std::uint8_t n_words;
+    std::vector< std::uint8_t > ids;
+    // indices of actuators in the batch & numbers of commands merged into their blocks
+    // to update the shadow of the command merger
+    std::vector< std::size_t > members;
+    std::vector< std::uint8_t > n_items;
+    std::vector< std::int32_t > values;
+  };
+
+  // add a sync write handler for each unique (address, length) pair of the items
+  // as long as DynamixelWorkbench accepts (it has a limited number of handlers).
+  // staged commands without the handler will be written individually.
+  void addBatch(const ItemInfo &item) {
+    if (!item.isAvailable() || findBatch(item.address, item.length)) {
+      return;
+    }
+    const char *log(NULL);
+    if (!addBatch(item.address, item.length, &log)) {
+      ROS_WARN_STREAM("GroupWriter::addBatch(): Failed to add a sync write handler for '"
+                      << item.name << "'. Commands to the item will be written individually: "
+                      << (log ? log : "No log from DynamixelWorkbench::addSyncWriteHandler()"));
+    }
+  }
+
+  bool addBatch(const std::uint16_t address, const std::uint16_t length, const char **const log) {
+    Batch batch;
+    batch.address = address;
+    batch.length = length;
+    batch.index = dxl_wb_->getTheNumberOfSyncWriteHandler();
+    batch.n_words = (length + 3) / 4;
+    if (!dxl_wb_->addSyncWriteHandler(batch.address, batch.length, log)) {
+      return false;
+    }
+    batch.ids.reserve(data_list_.size());
+    batch.members.reserve(data_list_.size());
+    batch.n_items.reserve(data_list_.size());
+    batch.values.reserve(data_list_.size() * batch.n_words);
+    batches_.push_back(batch);
+    return true;
+  }
+
+  // the batch for merged blocks, which is added on the first use.
+  // blocks rejected by DynamixelWorkbench once will be written individually.
+  Batch *findBlockBatch(const std::uint16_t address, const std::uint16_t length) {
+    Batch *const batch(findBatch(address, length));
+    if (batch) {
+      return batch;
+    }
+    const std::pair< std::uint16_t, std::uint16_t > block(address, length);
+    for (const std::pair< std::uint16_t, std::uint16_t > &rejected : rejected_blocks_) {
+      if (rejected == block) {
+        return NULL;
+      }
+    }
+    const char *log(NULL);
+    if (!addBatch(address, length, &log)) {
+      ROS_WARN_STREAM("GroupWriter::findBlockBatch(): Failed to add a sync write handler for "
+                      "merged commands at the address "
+                      << address << " (length: " << length
+                      << "). They will be written individually: "
+                      << (log ? log : "No log from DynamixelWorkbench::addSyncWriteHandler()"));
+      rejected_blocks_.push_back(block);
+      return NULL;
+    }
+    return &batches_.back();
+  }
+
+  // sort blocks merged from commands of the i-th actuator into batches.
+  // blocks without the corresponding batch are written immediately.
+  bool stageBlocks(const std::size_t i) {
+    DynamixelActuatorData &data(*data_list_[i]);
+    merger_->merge(i, &blocks_);
+    bool result(true);
+    for (const CommandMerger::Block &block : blocks_) {
+      Batch *const batch(findBlockBatch(block.address, block.length));
+      if (batch) {
+        addToBatch(i, block, batch);
+        continue;
+      }
+      // fall back to batches of the merged commands so that they are still sync written
+      for (std::uint8_t j = 0; j < block.n_items; ++j) {
+        const StagedItem &item(block.items[j]);
+        CommandMerger::Block item_block;
+        item_block.address = item.address;
+        item_block.length = item.length;
+        item_block.n_items = 1;
+        item_block.items[0] = item;
+        std::copy(block.bytes + (item.address - block.address),
+                  block.bytes + (item.address - block.address + item.length), item_block.bytes);
+        Batch *const item_batch(findBatch(item.address, item.length));
+        if (item_batch) {
+          addToBatch(i, item_block, item_batch);
+          continue;
+        }
+        const bool is_written(writeItem(data, item));
+        merger_->commit(i, item_block, is_written);
+        result = result && is_written;
+      }
+    }
+    return result;
+  }
+
+  // append the block for the i-th actuator to the batch
+  void addToBatch(const std::size_t i, const CommandMerger::Block &block, Batch *const batch) {
+    batch->ids.push_back(data_list_[i]->id);
+    batch->members.push_back(i);
+    batch->n_items.push_back(block.n_items);
+    for (std::uint16_t j = 0; j < batch->n_words; ++j) {
+      std::uint32_t word(0);
+      for (std::uint16_t k = 4 * j; k < 4 * j + 4 && k < block.length; ++k) {
+        word |= static_cast< std::uint32_t >(block.bytes[k]) << (8 * (k - 4 * j));
+      }
+      batch->values.push_back(static_cast< std::int32_t >(word));
+    }
+  }
+
+  // let the command merger know the result of the batch
+  void commitBlocks(const Batch &batch, const bool is_written) {
+    CommandMerger::Block block;
+    block.address = batch.address;
+    block.length = batch.length;
+    for (std::size_t m = 0; m < batch.members.size(); ++m) {
+      for (std::uint16_t k = 0; k < block.length; ++k) {
+        const std::uint32_t word(
+            static_cast< std::uint32_t >(batch.values[m * batch.n_words + k / 4]));
+        block.bytes[k] = static_cast< std::uint8_t >((word >> (8 * (k % 4))) & 0xFF);
+      }
+      block.n_items = batch.n_items[m];
+      merger_->commit(batch.members[m], block, is_written);
+    }
+  }
+
+  Batch *findBatch(const std::uint16_t address, const std::uint16_t length) {
+    for (Batch &batch : batches_) {
+      if (batch.address == address && batch.length == length) {
+        return &batch;
+      }
+    }
+    return NULL;
+  }
+
+  bool writeItem(const DynamixelActuatorData &data, const StagedItem &item) {
+    // little endian as the control table
+    ItemInfo info;
+    info.address = item.address;
+    info.length = item.length;
+    std::uint8_t bytes[4];
+    info.encode(item.value, bytes);
+    const char *log(NULL);
+    if (!dxl_wb_->writeRegister(data.id, item.address, item.length, bytes, &log)) {
+      ErrorLog::report(error_log_,
+                       ErrorEntry("GroupWriter::writeItem", "Failed to write", NULL,
+                                  data.name.c_str(), data.id, item.address, log));
+      return false;
+    }
+    return true;
+  }
+
+private:
+  BusBackend *dxl_wb_;
+  ErrorLog *error_log_;
+  std::vector< DynamixelActuatorDataPtr > data_list_;
+  std::vector< Batch > batches_;
+  // merges commands of each actuator before batching if enabled
+  CommandMerger *merger_;
+  std::vector< CommandMerger::Block > blocks_;
+  std::vector< std::pair< std::uint16_t, std::uint16_t > > rejected_blocks_;
+};
+
+typedef std::shared_ptr< GroupWriter > GroupWriterPtr;
+typedef std::shared_ptr< const GroupWriter > GroupWriterConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
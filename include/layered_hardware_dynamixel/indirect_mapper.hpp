@@ -0,0 +1,137 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_INDIRECT_MAPPER_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_INDIRECT_MAPPER_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <layered_hardware_dynamixel/bus_backend.hpp>
+#include <layered_hardware_dynamixel/common_namespaces.hpp>
+#include <layered_hardware_dynamixel/dynamixel_actuator_data.hpp>
+#include <ros/console.h>
+
+namespace layered_hardware_dynamixel {
+
+// mirrors present position, velocity, current & additional states of an actuator
+// into the contiguous Indirect_Data region by programming the Indirect_Address table.
+// items to be read are then redirected to the mirrored addresses so that
+// any subset of the states which is read in a cycle forms one compact block.
+// items to be written keep their original addresses.
+class IndirectMapper {
+public:
+  // program the indirect address table of the actuator and redirect its items on success.
+  // items are left unchanged if the actuator or its present state does not allow mirroring.
+  static bool map(DynamixelActuatorData *const data) {
+    BusBackend *const dxl_wb(data->dxl_wb);
+    if (dxl_wb->getProtocolVersion() != 2.0) {
+      ROS_WARN_STREAM("IndirectMapper::map(): Indirect addresses require Protocol 2.0. '"
+                      << data->name << "' (id: " << static_cast< int >(data->id)
+                      << ") reads states from their original addresses.");
+      return false;
+    }
+
+    // the indirect address & data regions of the model
+    const ControlItem *const address_item(dxl_wb->getItemInfo(data->id, "Indirect_Address_1"));
+    const ControlItem *const data_item(dxl_wb->getItemInfo(data->id, "Indirect_Data_1"));
+    if (!address_item || !data_item || data_item->address <= address_item->address) {
+      ROS_WARN_STREAM("IndirectMapper::map(): No indirect address region on '"
+                      << data->name << "' (id: " << static_cast< int >(data->id)
+                      << "). States are read from their original addresses.");
+      return false;
+    }
+    // each entry of the address table is 2 bytes and maps 1 byte of the data region
+    const std::uint16_t capacity((data_item->address - address_item->address) / 2);
+
+    // items to be mirrored in the order of the data region
+    std::vector< ItemInfo * > items;
+    if (data->present_pos_item.isAvailable()) {
+      items.push_back(&data->present_pos_item);
+    }
+    if (data->present_vel_item.isAvailable()) {
+      items.push_back(&data->present_vel_item);
+    }
+    if (data->present_eff_item.isAvailable()) {
+      items.push_back(&data->present_eff_item);
+    }
+    for (Int32StateItem &state : data->additional_states) {
+      if (state.info.isAvailable()) {
+        items.push_back(&state.info);
+      }
+    }
+    std::vector< std::uint8_t > table;
+    for (const ItemInfo *const item : items) {
+      for (std::uint16_t i = 0; i < item->length; ++i) {
+        const std::uint16_t address(item->address + i);
+        table.push_back(static_cast< std::uint8_t >(address & 0xFF));
+        table.push_back(static_cast< std::uint8_t >((address >> 8) & 0xFF));
+      }
+    }
+    if (table.empty()) {
+      return true;
+    }
+    if (table.size() / 2 > capacity) {
+      ROS_WARN_STREAM("IndirectMapper::map(): States of '"
+                      << data->name << "' (id: " << static_cast< int >(data->id) << ") need "
+                      << table.size() / 2 << " bytes but the indirect data region has only "
+                      << capacity << " bytes. States are read from their original addresses.");
+      return false;
+    }
+
+    // the address table is writable only while the torque is disabled.
+    // never disable the torque here because the actuator may be holding something.
+    std::int32_t torque_enable;
+    const char *log(NULL);
+    if (!dxl_wb->itemRead(data->id, "Torque_Enable", &torque_enable, &log)) {
+      ROS_WARN_STREAM("IndirectMapper::map(): Failed to read Torque_Enable of '"
+                      << data->name << "' (id: " << static_cast< int >(data->id)
+                      << "). States are read from their original addresses: "
+                      << (log ? log : "No log from DynamixelWorkbench::itemRead()"));
+      return false;
+    }
+    if (torque_enable != 0) {
+      ROS_WARN_STREAM("IndirectMapper::map(): The torque of '"
+                      << data->name << "' (id: " << static_cast< int >(data->id)
+                      << ") is enabled. States are read from their original addresses.");
+      return false;
+    }
+
+    data->indirect_table_address = address_item->address;
+    data->indirect_table = table;
+    if (!program(data)) {
+      data->indirect_table.clear();
+      return false;
+    }
+
+    // redirect items to the mirrored addresses
+    std::uint16_t address(data_item->address);
+    for (ItemInfo *const item : items) {
+      item->address = address;
+      address += item->length;
+    }
+    ROS_INFO_STREAM("IndirectMapper::map(): Mirrored " << items.size() << " items ("
+                                                       << table.size() / 2 << " bytes) of '"
+                                                       << data->name << "' (id: "
+                                                       << static_cast< int >(data->id)
+                                                       << ") into the indirect data region");
+    return true;
+  }
+
+  // write the indirect address table of the actuator in one packet
+  static bool program(DynamixelActuatorData *const data) {
+    if (data->indirect_table.empty()) {
+      return true;
+    }
+    const char *log(NULL);
+    if (!data->dxl_wb->writeRegister(data->id, data->indirect_table_address,
+                                     data->indirect_table.size(), &data->indirect_table[0],
+                                     &log)) {
+      ROS_ERROR_STREAM("IndirectMapper::program(): Failed to write the indirect address table of '"
+                       << data->name << "' (id: " << static_cast< int >(data->id)
+                       << "): " << (log ? log : "No log from DynamixelWorkbench::writeRegister()"));
+      return false;
+    }
+    return true;
+  }
+};
+} // namespace layered_hardware_dynamixel
+
+#endif
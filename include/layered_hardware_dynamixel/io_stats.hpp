@@ -0,0 +1,161 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_IO_STATS_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_IO_STATS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <hardware_interface_extensions/integer_interface.hpp>
+#include <layered_hardware_dynamixel/common_namespaces.hpp>
+
+namespace layered_hardware_dynamixel {
+
+// lock-free histogram of latencies with log2-spaced buckets in microseconds.
+// any thread can record() while another thread summarize()s.
+class LatencyHistogram {
+public:
+  LatencyHistogram() : max_us_(0) {
+    for (std::atomic< std::uint32_t > &count : counts_) {
+      count.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void record(const std::uint32_t us) {
+    counts_[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+    std::uint32_t max_us(max_us_.load(std::memory_order_relaxed));
+    while (us > max_us &&
+           !max_us_.compare_exchange_weak(max_us, us, std::memory_order_relaxed)) {
+    }
+  }
+
+  // compute percentiles of latencies recorded since the last call and restart recording.
+  // percentiles are the upper bounds of the buckets, so they overestimate by 2x at the maximum.
+  // all outputs are zero if nothing has been recorded.
+  void summarize(std::int32_t *const p50_us, std::int32_t *const p99_us,
+                 std::int32_t *const max_us) {
+    std::uint32_t counts[N_BUCKETS];
+    std::uint64_t n_total(0);
+    for (int i = 0; i < N_BUCKETS; ++i) {
+      counts[i] = counts_[i].exchange(0, std::memory_order_relaxed);
+      n_total += counts[i];
+    }
+    const std::uint32_t max(max_us_.exchange(0, std::memory_order_relaxed));
+
+    *p50_us = *p99_us = 0;
+    *max_us = static_cast< std::int32_t >(max);
+    if (n_total == 0) {
+      return;
+    }
+    const std::uint64_t n_p50((n_total * 50 + 99) / 100), n_p99((n_total * 99 + 99) / 100);
+    std::uint64_t n_accum(0);
+    for (int i = 0; i < N_BUCKETS; ++i) {
+      const std::uint64_t n_prev(n_accum);
+      n_accum += counts[i];
+      if (n_prev < n_p50 && n_accum >= n_p50) {
+        *p50_us = upperBoundOf(i, max);
+      }
+      if (n_prev < n_p99 && n_accum >= n_p99) {
+        *p99_us = upperBoundOf(i, max);
+        break;
+      }
+    }
+  }
+
+private:
+  // bucket i contains latencies in [2^(i-1), 2^i) us, except bucket 0 for 0 us
+  static const int N_BUCKETS = 33;
+
+  static int bucketOf(std::uint32_t us) {
+    int i(0);
+    while (us > 0) {
+      us >>= 1;
+      ++i;
+    }
+    return i;
+  }
+
+  static std::int32_t upperBoundOf(const int i, const std::uint32_t max_us) {
+    const std::uint64_t bound(i == 0 ? 0 : (std::uint64_t(1) << i) - 1);
+    return static_cast< std::int32_t >(bound < max_us ? bound : max_us);
+  }
+
+private:
+  std::atomic< std::uint32_t > counts_[N_BUCKETS];
+  std::atomic< std::uint32_t > max_us_;
+};
+
+// latencies of read & write phases and the number of failed transactions of a bus or an actuator,
+// and the number of overrun cycles of a bus.
+// recorded on the thread running bus cycles, and summarized on the control thread.
+class IoStats {
+public:
+  IoStats()
+      : n_errors_(0), n_overruns_(0), read_p50_us_(0), read_p99_us_(0), read_max_us_(0),
+        write_p50_us_(0), write_p99_us_(0), write_max_us_(0), errors_(0), overruns_(0) {}
+
+  //
+  // recording side
+  //
+
+  typedef std::chrono::steady_clock Clock;
+
+  static Clock::time_point now() { return Clock::now(); }
+
+  void recordRead(const Clock::time_point &start) { read_.record(elapsedUs(start)); }
+
+  void recordWrite(const Clock::time_point &start) { write_.record(elapsedUs(start)); }
+
+  void countError() { n_errors_.fetch_add(1, std::memory_order_relaxed); }
+
+  // cycles which took longer than the bus scheduler's budget
+  void countOverrun() { n_overruns_.fetch_add(1, std::memory_order_relaxed); }
+
+  //
+  // summarizing side
+  //
+
+  // update values bound to hardware handles with latencies recorded since the last call
+  void summarize() {
+    read_.summarize(&read_p50_us_, &read_p99_us_, &read_max_us_);
+    write_.summarize(&write_p50_us_, &write_p99_us_, &write_max_us_);
+    errors_ = static_cast< std::int32_t >(n_errors_.load(std::memory_order_relaxed));
+    overruns_ = static_cast< std::int32_t >(n_overruns_.load(std::memory_order_relaxed));
+  }
+
+  // register handles like "<prefix>/read_p50_us"
+  void registerTo(hie::Int32StateInterface *const iface, const std::string &prefix) {
+    iface->registerHandle(hie::Int32StateHandle(prefix + "/read_p50_us", &read_p50_us_));
+    iface->registerHandle(hie::Int32StateHandle(prefix + "/read_p99_us", &read_p99_us_));
+    iface->registerHandle(hie::Int32StateHandle(prefix + "/read_max_us", &read_max_us_));
+    iface->registerHandle(hie::Int32StateHandle(prefix + "/write_p50_us", &write_p50_us_));
+    iface->registerHandle(hie::Int32StateHandle(prefix + "/write_p99_us", &write_p99_us_));
+    iface->registerHandle(hie::Int32StateHandle(prefix + "/write_max_us", &write_max_us_));
+    iface->registerHandle(hie::Int32StateHandle(prefix + "/errors", &errors_));
+    iface->registerHandle(hie::Int32StateHandle(prefix + "/overruns", &overruns_));
+  }
+
+private:
+  static std::uint32_t elapsedUs(const Clock::time_point &start) {
+    const long long us(
+        std::chrono::duration_cast< std::chrono::microseconds >(Clock::now() - start).count());
+    return us > 0 ? static_cast< std::uint32_t >(us) : 0;
+  }
+
+private:
+  // recorded values
+  LatencyHistogram read_, write_;
+  std::atomic< std::uint32_t > n_errors_, n_overruns_;
+
+  // summarized values bound to hardware handles
+  std::int32_t read_p50_us_, read_p99_us_, read_max_us_;
+  std::int32_t write_p50_us_, write_p99_us_, write_max_us_;
+  std::int32_t errors_, overruns_;
+};
+
+typedef std::shared_ptr< IoStats > IoStatsPtr;
+typedef std::shared_ptr< const IoStats > IoStatsConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
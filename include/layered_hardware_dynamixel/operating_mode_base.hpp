@@ -7,6 +7,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <layered_hardware_dynamixel/dynamixel_actuator_data.hpp>
 #include <ros/console.h>
@@ -17,13 +18,24 @@ namespace layered_hardware_dynamixel {
 
 class OperatingModeBase {
 public:
-  OperatingModeBase(const std::string &name, const DynamixelActuatorDataPtr &data)
-      : name_(name), data_(data) {}
+  // read_mask is a combination of ReadMask to declare states the mode reads in cycles
+  OperatingModeBase(const std::string &name, const DynamixelActuatorDataPtr &data,
+                    const std::uint8_t read_mask = READ_ALL)
+      : name_(name), data_(data), read_mask_(read_mask) {}
 
   virtual ~OperatingModeBase() {}
 
   std::string getName() const { return name_; }
 
+  std::uint8_t getReadMask() const { return read_mask_; }
+
+  // override the default read mask of the mode
+  void setReadMask(const std::uint8_t read_mask) { read_mask_ = read_mask; }
+
+  // writes to enable the mode, called just before starting().
+  // the layer may defer & batch them among actuators switching modes at once.
+  virtual void startWriting() {}
+
   // TODO: retrun bool to inform result of mode switching to the upper class
   virtual void starting() = 0;
 
@@ -33,6 +45,15 @@ public:
 
   virtual void stopping() = 0;
 
+  // disable the torque deferred on stopping unless the next mode has taken it over.
+  // called after the next mode's startWriting() on switching.
+  void finishStopping() {
+    if (data_->has_deferred_torque_off) {
+      data_->has_deferred_torque_off = false;
+      writeTorqueOff();
+    }
+  }
+
 protected:
   //
   // instruction functions for chiled classes
@@ -44,6 +65,7 @@ protected:
       ROS_ERROR_STREAM("OperatingModeBase::ping(): Failed to ping to '"
                        << data_->name << "' (id: " << static_cast< int >(data_->id)
                        << "): " << (log ? log : "No log from DynamixelWorkbench::ping()"));
+      countError();
       return false;
     }
     return true;
@@ -72,6 +94,7 @@ protected:
       ROS_ERROR_STREAM("OperatingModeBase::reboot(): Failed to reboot '"
                        << data_->name << "' (id: " << static_cast< int >(data_->id)
                        << "): " << (log ? log : "No log from DynamixelWorkbench::reboot()"));
+      countError();
       return false;
     }
     return true;
@@ -81,11 +104,6 @@ protected:
   // read functions for chiled classes
   //
 
-  bool hasItem(const std::string &item) {
-    const char *log(NULL);
-    return data_->dxl_wb->getItemInfo(data_->id, item.c_str(), &log) != NULL;
-  }
-
   bool readItem(const std::string &item, int32_t *value) {
     const char *log(NULL);
     if (!data_->dxl_wb->itemRead(data_->id, item.c_str(), value, &log)) {
@@ -93,15 +111,33 @@ protected:
                        << item << "' of '" << data_->name
                        << "' (id: " << static_cast< int >(data_->id)
                        << "): " << (log ? log : "No log from DynamixelWorkbench::itemRead()"));
+      countError();
+      return false;
+    }
+    return true;
+  }
+
+  bool readItem(const ItemInfo &item, std::int32_t *value) {
+    // errors are reported without allocation because this runs in bus cycles
+    if (!item.isAvailable()) {
+      reportError("OperatingModeBase::readItem", "Unavailable control table item", item);
+      return false;
+    }
+    std::uint32_t raw_value;
+    const char *log(NULL);
+    if (!data_->dxl_wb->readRegister(data_->id, item.address, item.length, &raw_value, &log)) {
+      reportError("OperatingModeBase::readItem", "Failed to read control table item", item, log);
+      countError();
       return false;
     }
+    *value = item.decode(raw_value);
     return true;
   }
 
-  bool readItems(std::map< std::string, std::int32_t > *const items) {
+  bool readItems(std::vector< Int32Item > *const items) {
     bool result(true);
-    for (std::map< std::string, std::int32_t >::value_type &item : *items) {
-      if (!readItem(item.first, &item.second)) {
+    for (Int32Item &item : *items) {
+      if (!readItem(item.info, &item.value)) {
         result = false;
       }
     }
@@ -109,73 +145,144 @@ protected:
   }
 
   bool readPosition() {
-    float rad;
-    const char *log(NULL);
-    if (!data_->dxl_wb->getRadian(data_->id, &rad, &log)) {
-      ROS_ERROR_STREAM("OperatingModeBase::readPosition(): Failed to read position from '"
-                       << data_->name << "' (id: " << static_cast< int >(data_->id)
-                       << "): " << (log ? log : "No log from DynamixelWorkbench::getRadian()"));
+    // use the value from the layer's group read if available
+    std::int32_t value;
+    if (data_->has_prefetched_states) {
+      // the bus has decoded prefetched states if scales are available
+      if (data_->uses_scales) {
+        data_->pos = data_->store->prefetched_pos[data_->index];
+        data_->has_fresh_pos = true;
+        return true;
+      }
+      value = data_->present_pos_value;
+    } else if (!readItem(data_->present_pos_item, &value)) {
       return false;
     }
-    data_->pos = rad;
+    data_->pos = data_->uses_scales ? data_->store->decodePosition(data_->index, value)
+                                    : data_->dxl_wb->convertValue2Radian(data_->id, value);
+    data_->has_fresh_pos = true;
     return true;
   }
 
   bool readVelocity() {
-    std::int32_t value;
     // As of dynamixel_workbench_toolbox v2.0.0,
     // DynamixelWorkbench::getVelocity() reads a wrong item ...
-    if (!readItem("Present_Velocity", &value)) {
+    std::int32_t value;
+    if (data_->has_prefetched_states) {
+      if (data_->uses_scales) {
+        data_->vel = data_->store->prefetched_vel[data_->index];
+        data_->has_fresh_vel = true;
+        return true;
+      }
+      value = data_->present_vel_value;
+    } else if (!readItem(data_->present_vel_item, &value)) {
       return false;
     }
-    data_->vel = data_->dxl_wb->convertValue2Velocity(data_->id, value);
+    data_->vel = data_->uses_scales ? data_->store->decodeVelocity(data_->index, value)
+                                    : data_->dxl_wb->convertValue2Velocity(data_->id, value);
+    data_->has_fresh_vel = true;
     return true;
   }
 
-  bool hasEffort() { return hasItem("Present_Current"); }
-
   bool readEffort() {
     std::int32_t value;
-    if (!readItem("Present_Current", &value)) {
+    if (data_->has_prefetched_states) {
+      if (data_->uses_scales) {
+        data_->eff = data_->store->prefetched_eff[data_->index];
+        return true;
+      }
+      value = data_->present_eff_value;
+    } else if (!readItem(data_->present_eff_item, &value)) {
       return false;
     }
     // mA -> N*m
-    data_->eff =
-        data_->dxl_wb->convertValue2Current(data_->id, value) * data_->torque_constant / 1000.0;
+    data_->eff = data_->uses_scales
+                     ? data_->store->decodeEffort(data_->index, value)
+                     : data_->dxl_wb->convertValue2Current(data_->id, value) *
+                           data_->torque_constant / 1000.0;
     return true;
   }
 
   bool readAdditionalStates() {
     bool result(true);
-    for (std::map< std::string, std::int32_t >::value_type &state : data_->additional_states) {
-      if (!readItem(state.first, &state.second)) {
+    for (Int32StateItem &state : data_->additional_states) {
+      // skip states not due in the present cycle or already read by the layer's group read
+      if (!state.is_due) {
+        continue;
+      }
+      if (!readItem(state.info, &state.value)) {
         result = false;
       }
+      state.is_due = false;
     }
     return result;
   }
 
   bool readAllStates() {
-    // check whether the actuator supports effort if never
-    if (data_->has_eff == boost::none) {
-      data_->has_eff = hasEffort();
-    }
-
     // if one fails, "return readPosition() && readVelocity() && ..." does not call others.
     // on the other hand, lines below call all anyway to read info as much as possible.
     const bool pos_result(readPosition());
     const bool vel_result(readVelocity());
-    const bool eff_result(*data_->has_eff ? readEffort() : true);
+    const bool eff_result(data_->has_eff ? readEffort() : true);
     const bool additional_result(readAdditionalStates());
     return pos_result && vel_result && eff_result && additional_result;
   }
 
+  // read states specified by the read mask of the mode
+  bool readStates() {
+    // the layer's bus scheduler may defer core states to fit the cycle in its budget
+    const std::uint8_t core_mask(data_->defers_core_states ? static_cast< std::uint8_t >(READ_NONE)
+                                                           : read_mask_);
+    const bool pos_result((core_mask & READ_POSITION) ? readPosition() : true);
+    const bool vel_result((core_mask & READ_VELOCITY) ? readVelocity() : true);
+    const bool eff_result((core_mask & READ_EFFORT) && data_->has_eff ? readEffort() : true);
+    const bool additional_result((read_mask_ & READ_ADDITIONAL_STATES) ? readAdditionalStates()
+                                                                       : true);
+    return pos_result && vel_result && eff_result && additional_result;
+  }
+
   //
   // write functions for child classes
   //
 
-  bool enableOperatingMode(bool (DynamixelWorkbench::*const set_func)(std::uint8_t,
-                                                                      const char **)) {
+  bool enableOperatingMode(bool (BusBackend::*const set_func)(std::uint8_t, const char **)) {
+    // the sequence below disables the torque anyway if the previous mode has deferred it
+    data_->has_deferred_torque_off = false;
+
+    // keep the torque if the actuator is already in the mode, which avoids
+    // dropping a loaded joint on switching between controllers of the same mode
+    std::int32_t mode_value;
+    const bool has_mode_value(operatingModeValueOf(set_func, &mode_value));
+    if (has_mode_value && recallOperatingMode() &&
+        data_->known_operating_mode.get() == mode_value) {
+      // the torque is read every time because the actuator disables it on hardware errors
+      std::int32_t torque_value;
+      if (data_->dxl_wb->readRegister(data_->id, "Torque_Enable", &torque_value) &&
+          torque_value != 0) {
+        return true;
+      }
+      return data_->defers_switch_writes ? deferSwitchWrite("Torque_Enable", 1) : torqueOn();
+    }
+
+    // defer the sequence to the layer's batched write on switching if enabled.
+    // the layer forgets the result if the batched write fails.
+    if (data_->defers_switch_writes && has_mode_value) {
+      // changing the mode may reset items to the defaults of the mode
+      data_->forgetControlTable();
+      // the mode is known only if the whole sequence is queued. a partial sequence is dropped
+      // not to disable the torque without changing the mode.
+      if (!deferSwitchWrite("Torque_Enable", 0) ||
+          !deferSwitchWrite("Operating_Mode", mode_value) ||
+          !deferSwitchWrite("Torque_Enable", 1)) {
+        data_->forgetControlTable();
+        data_->switch_writes.clear();
+        return false;
+      }
+      data_->known_operating_mode = mode_value;
+      return true;
+    }
+
+    data_->forgetControlTable();
     const char *log;
     // disable torque to make the actuator ready to change operating modes
     log = NULL;
@@ -183,6 +290,7 @@ protected:
       ROS_ERROR_STREAM("OperatingModeBase::enableOperatingMode(): Failed to disable torque of '"
                        << data_->name << "' (id: " << static_cast< int >(data_->id)
                        << "): " << (log ? log : "No log from DynamixelWorkbench::torqueOff()"));
+      countError();
       return false;
     }
     // change operating modes
@@ -191,6 +299,7 @@ protected:
       ROS_ERROR_STREAM("OperatingModeBase::enableOperatingMode(): Failed to set operating mode of '"
                        << data_->name << "' (id: " << static_cast< int >(data_->id)
                        << "): " << (log ? log : "No log from DynamixelWorkbench"));
+      countError();
       return false;
     }
     // activate new operating mode by enabling torque
@@ -199,28 +308,79 @@ protected:
       ROS_ERROR_STREAM("OperatingModeBase::enableOperatingMode(): Failed to enable torque of '"
                        << data_->name << "' (id: " << static_cast< int >(data_->id)
                        << "): " << (log ? log : "No log from DynamixelWorkbench::torqueOn()"));
+      countError();
       return false;
     }
+    if (has_mode_value) {
+      data_->known_operating_mode = mode_value;
+    }
     return true;
   }
 
+  // disable the torque, or defer it on stopping to let the next mode take it over
   bool torqueOff() {
+    if (data_->defers_torque_off) {
+      data_->has_deferred_torque_off = true;
+      return true;
+    }
+    return writeTorqueOff();
+  }
+
+  bool writeTorqueOff() {
     const char *log(NULL);
     if (!data_->dxl_wb->torqueOff(data_->id, &log)) {
       ROS_ERROR_STREAM("OperatingModeBase::torqueOff(): Failed to disable torque of '"
                        << data_->name << "' (id: " << static_cast< int >(data_->id)
                        << "): " << (log ? log : "No log from DynamixelWorkbench::torqueOff()"));
+      countError();
       return false;
     }
     return true;
   }
 
+  bool torqueOn() {
+    const char *log(NULL);
+    if (!data_->dxl_wb->torqueOn(data_->id, &log)) {
+      ROS_ERROR_STREAM("OperatingModeBase::torqueOn(): Failed to enable torque of '"
+                       << data_->name << "' (id: " << static_cast< int >(data_->id)
+                       << "): " << (log ? log : "No log from DynamixelWorkbench::torqueOn()"));
+      countError();
+      return false;
+    }
+    return true;
+  }
+
+  // read the operating mode of the actuator unless it is known.
+  // returns false if it is still unknown.
+  bool recallOperatingMode() {
+    if (data_->known_operating_mode) {
+      return true;
+    }
+    // Operating_Mode is an item of Protocol 2.0
+    if (data_->dxl_wb->getProtocolVersion() != 2.0) {
+      return false;
+    }
+    std::int32_t mode_value;
+    const char *log(NULL);
+    if (!data_->dxl_wb->readRegister(data_->id, "Operating_Mode", &mode_value, &log)) {
+      ROS_WARN_STREAM("OperatingModeBase::recallOperatingMode(): Failed to read the operating "
+                      "mode of '"
+                      << data_->name << "' (id: " << static_cast< int >(data_->id)
+                      << "). It is written anyway: "
+                      << (log ? log : "No log from DynamixelWorkbench::readRegister()"));
+      return false;
+    }
+    data_->known_operating_mode = mode_value;
+    return true;
+  }
+
   bool clearMultiTurn() {
     const char *log(NULL);
     if (!data_->dxl_wb->clearMultiTurn(data_->id, &log)) {
       ROS_ERROR_STREAM("OperatingModeBase::clearMultiTurn(): Failed to clear multi turn count of '"
                        << data_->name << "' (id: " << static_cast< int >(data_->id) << "): "
                        << (log ? log : "No log from DynamixelWorkbench::clearMultiTurn()"));
+      countError();
       return false;
     }
     return true;
@@ -233,71 +393,225 @@ protected:
                        << item << "' of '" << data_->name
                        << "' (id: " << static_cast< int >(data_->id) << " to " << value << ": "
                        << (log ? log : "No log from DynamixelWorkbench::itemWrite()"));
+      data_->known_items.erase(item);
+      countError();
+      return false;
+    }
+    data_->known_items[item] = value;
+    return true;
+  }
+
+  bool writeItem(const ItemInfo &item, const std::int32_t value) {
+    if (!item.isAvailable()) {
+      reportError("OperatingModeBase::writeItem", "Unavailable control table item", item);
+      return false;
+    }
+    std::uint8_t bytes[4];
+    item.encode(value, bytes);
+    const char *log(NULL);
+    if (!data_->dxl_wb->writeRegister(data_->id, item.address, item.length, bytes, &log)) {
+      reportError("OperatingModeBase::writeItem", "Failed to set control table item", item, log);
+      countError();
+      return false;
+    }
+    return true;
+  }
+
+  // stage the command for the layer's group write or command merger if enabled,
+  // or write it immediately
+  bool writeCommandItem(const ItemInfo &item, const std::int32_t value) {
+    if (data_->stages_cmds && item.isAvailable()) {
+      const StagedItem staged = {item.address, item.length, value};
+      data_->staged_cmds.push_back(staged);
+      return true;
+    }
+    return writeItem(item, value);
+  }
+
+  // write the command if the cache requires or if forced, then cache it
+  bool updateCommand(const ItemInfo &item, CachedCommand *const cache, const std::int32_t value,
+                     const double source, const double dead_band, const bool force) {
+    if (!force && !cache->needsWrite(value, source, dead_band)) {
       return false;
     }
+    writeCommandItem(item, value);
+    cache->update(value, source);
     return true;
   }
 
+  // write items of the mode except ones known to have the values already
   bool writeItems(const std::map< std::string, std::int32_t > &item_map) {
     for (const std::map< std::string, std::int32_t >::value_type &item : item_map) {
-      if (!writeItem(item.first, item.second)) {
+      const std::map< std::string, std::int32_t >::const_iterator known(
+          data_->known_items.find(item.first));
+      if (known != data_->known_items.end() && known->second == item.second) {
+        continue;
+      }
+      if (data_->defers_switch_writes) {
+        if (!deferSwitchWrite(item.first, item.second)) {
+          return false;
+        }
+        data_->known_items[item.first] = item.second;
+      } else if (!writeItem(item.first, item.second)) {
         return false;
       }
     }
     return true;
   }
 
-  bool writePositionCommand() {
-    const float cmd(static_cast< float >(data_->pos_cmd));
+  // append a write to the layer's batched write on switching
+  bool deferSwitchWrite(const std::string &item_name, const std::int32_t value) {
+    if (data_->control_table) {
+      const ControlTableItem *const table_item(
+          data_->control_table->find_item(item_name.c_str()));
+      if (table_item) {
+        const StagedItem item = {table_item->address, table_item->length, value};
+        data_->switch_writes.push_back(item);
+        return true;
+      }
+    }
     const char *log(NULL);
-    if (!data_->dxl_wb->goalPosition(data_->id, cmd, &log)) {
-      ROS_ERROR_STREAM("OperatingModeBase::writePositionCommand(): Failed to set goal position of '"
-                       << data_->name << "' (id: " << static_cast< int >(data_->id) << ") to "
-                       << cmd << ": "
-                       << (log ? log : "No log from DynamixelWorkbench::goalPosition()"));
+    const ControlItem *const info(data_->dxl_wb->getItemInfo(data_->id, item_name.c_str(), &log));
+    if (!info) {
+      ROS_ERROR_STREAM("OperatingModeBase::deferSwitchWrite(): Failed to find control table item '"
+                       << item_name << "' of '" << data_->name
+                       << "' (id: " << static_cast< int >(data_->id)
+                       << "): " << (log ? log : "No log from DynamixelWorkbench::getItemInfo()"));
       return false;
     }
+    const StagedItem item = {info->address, info->data_length, value};
+    data_->switch_writes.push_back(item);
     return true;
   }
 
-  bool writeVelocityCommand() {
-    const float cmd(static_cast< float >(data_->vel_cmd));
-    const char *log(NULL);
-    if (!data_->dxl_wb->goalVelocity(data_->id, cmd, &log)) {
-      ROS_ERROR_STREAM("OperatingModeBase::writeVelocityCommand(): Failed to set goal velocity of '"
-                       << data_->name << "' (id: " << static_cast< int >(data_->id) << ") to "
-                       << cmd << ": "
-                       << (log ? log : "No log from DynamixelWorkbench::goalVelocity()"));
-      return false;
+  // write commands only if their raw values have changed beyond the dead-bands since the last
+  // writes, or if forced. return true if written (or staged for the layer's group write).
+
+  bool updatePositionCommand(const bool force = false) {
+    return !std::isnan(data_->pos_cmd) &&
+           updateCommand(data_->goal_pos_item, &data_->goal_pos_cache,
+                         encodePosition(data_->pos_cmd), data_->pos_cmd, data_->pos_dead_band,
+                         force);
+  }
+
+  bool updateVelocityCommand(const bool force = false) {
+    return !std::isnan(data_->vel_cmd) &&
+           updateCommand(data_->goal_vel_item, &data_->goal_vel_cache,
+                         encodeVelocity(data_->vel_cmd), data_->vel_cmd, data_->vel_dead_band,
+                         force);
+  }
+
+  bool updateProfileVelocity(const bool force = false) {
+    return !std::isnan(data_->vel_cmd) &&
+           updateCommand(data_->profile_vel_item, &data_->profile_vel_cache,
+                         encodeVelocity(std::abs(data_->vel_cmd)), std::abs(data_->vel_cmd),
+                         data_->vel_dead_band, force);
+  }
+
+  bool updateEffortCommand(const bool force = false) {
+    return !std::isnan(data_->eff_cmd) &&
+           updateCommand(data_->goal_eff_item, &data_->goal_eff_cache,
+                         encodeEffort(data_->eff_cmd), data_->eff_cmd, data_->eff_dead_band,
+                         force);
+  }
+
+  bool updateAdditionalCommands() {
+    bool result(true);
+    for (std::size_t i = 0; i < data_->additional_cmds.size(); ++i) {
+      const Int32Item &cmd(data_->additional_cmds[i]);
+      CachedCommand &cache(data_->additional_cmd_caches[i]);
+      if (cache.needsWrite(cmd.value)) {
+        if (!writeCommandItem(cmd.info, cmd.value)) {
+          result = false;
+        }
+        cache.update(cmd.value);
+      }
     }
-    return true;
+    return result;
   }
 
-  bool writeProfileVelocity() {
-    const float cmd(static_cast< float >(std::abs(data_->vel_cmd)));
-    const std::int32_t cmd_value(data_->dxl_wb->convertVelocity2Value(data_->id, cmd));
-    return writeItem("Profile_Velocity", cmd_value);
+  // make the next updates write the core commands
+  void invalidateCommands() {
+    data_->goal_pos_cache.invalidate();
+    data_->goal_vel_cache.invalidate();
+    data_->goal_eff_cache.invalidate();
+    data_->profile_vel_cache.invalidate();
   }
 
-  bool writeEffortCommand() {
-    // N*m -> mA
-    const float cmd(data_->eff_cmd / data_->torque_constant * 1000.0);
-    const std::int16_t cmd_value(data_->dxl_wb->convertCurrent2Value(data_->id, cmd));
-    return writeItem("Goal_Current", cmd_value);
+  // read additional commands from the control table as the last written values
+  bool readAdditionalCommands() {
+    const bool result(readItems(&data_->additional_cmds));
+    for (std::size_t i = 0; i < data_->additional_cmds.size(); ++i) {
+      data_->additional_cmd_caches[i].update(data_->additional_cmds[i].value);
+    }
+    return result;
   }
 
   //
   // utility
   //
 
-  static bool areNotEqual(const double a, const double b) {
-    // does !(|a - b| < EPS) instead of (|a - b| >= EPS) to return True when a and/or b is NaN
-    return !(std::abs(a - b) < std::numeric_limits< double >::epsilon());
+  // report an error about the item to the layer's error log
+  void reportError(const char *const func, const char *const what, const ItemInfo &item,
+                   const char *const log = NULL) {
+    ErrorLog::report(data_->error_log, ErrorEntry(func, what, item.name.c_str(),
+                                                  data_->name.c_str(), data_->id, -1, log));
+  }
+
+  // count a failed transaction for the layer's stats if enabled
+  void countError() {
+    ++data_->n_errors;
+    if (data_->stats) {
+      data_->stats->countError();
+    }
+  }
+
+  // SI units -> raw values with the precomputed scales if available
+  std::int32_t encodePosition(const double pos) const {
+    return data_->uses_scales
+               ? data_->store->encodePosition(data_->index, pos)
+               : data_->dxl_wb->convertRadian2Value(data_->id, static_cast< float >(pos));
+  }
+
+  std::int32_t encodeVelocity(const double vel) const {
+    return data_->uses_scales
+               ? data_->store->encodeVelocity(data_->index, vel)
+               : data_->dxl_wb->convertVelocity2Value(data_->id, static_cast< float >(vel));
+  }
+
+  std::int16_t encodeEffort(const double eff) const {
+    // N*m -> mA
+    return data_->uses_scales ? data_->store->encodeEffort(data_->index, eff)
+                              : data_->dxl_wb->convertCurrent2Value(
+                                    data_->id, static_cast< float >(eff / data_->torque_constant *
+                                                                    1000.0));
+  }
+
+  // value of Operating_Mode on Protocol 2.0 which the function of DynamixelWorkbench sets
+  static bool operatingModeValueOf(bool (BusBackend::*const set_func)(std::uint8_t, const char **),
+                                   std::int32_t *const value) {
+    if (set_func == &BusBackend::setCurrentControlMode) {
+      *value = 0;
+    } else if (set_func == &BusBackend::setVelocityControlMode) {
+      *value = 1;
+    } else if (set_func == &BusBackend::setPositionControlMode) {
+      *value = 3;
+    } else if (set_func == &BusBackend::setExtendedPositionControlMode) {
+      *value = 4;
+    } else if (set_func == &BusBackend::setCurrentBasedPositionControlMode) {
+      *value = 5;
+    } else if (set_func == &BusBackend::setPWMControlMode) {
+      *value = 16;
+    } else {
+      return false;
+    }
+    return true;
   }
 
 protected:
   const std::string name_;
   const DynamixelActuatorDataPtr data_;
+  std::uint8_t read_mask_;
 };
 
 typedef std::shared_ptr< OperatingModeBase > OperatingModePtr;
@@ -0,0 +1,118 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_REALTIME_THREAD_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_REALTIME_THREAD_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <ros/console.h>
+
+namespace layered_hardware_dynamixel {
+
+// thread which calls a function periodically on its own schedule,
+// optionally with SCHED_FIFO priority and fixed CPU affinity
+class RealtimeThread {
+public:
+  RealtimeThread() : is_running_(false) {}
+
+  virtual ~RealtimeThread() { stop(); }
+
+  // priority <= 0 keeps the default scheduling policy. cpu < 0 keeps the default affinity.
+  bool start(const std::function< void() > &cycle, const double period, const int priority,
+             const int cpu) {
+    if (is_running_) {
+      ROS_ERROR("RealtimeThread::start(): Already running");
+      return false;
+    }
+    if (period <= 0.) {
+      ROS_ERROR_STREAM("RealtimeThread::start(): Invalid period " << period << " s");
+      return false;
+    }
+    cycle_ = cycle;
+    period_ns_ = static_cast< long >(period * 1e9);
+    is_running_ = true;
+    thread_ = std::thread(&RealtimeThread::run, this);
+
+    // real-time settings require privileges. continue with the defaults if not permitted.
+    if (priority > 0) {
+      sched_param param;
+      param.sched_priority = priority;
+      const int err(pthread_setschedparam(thread_.native_handle(), SCHED_FIFO, &param));
+      if (err != 0) {
+        ROS_WARN_STREAM("RealtimeThread::start(): Failed to set SCHED_FIFO priority "
+                        << priority << ": " << std::strerror(err));
+      }
+    }
+    if (cpu >= 0) {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(cpu, &cpus);
+      const int err(pthread_setaffinity_np(thread_.native_handle(), sizeof(cpus), &cpus));
+      if (err != 0) {
+        ROS_WARN_STREAM("RealtimeThread::start(): Failed to set affinity to CPU "
+                        << cpu << ": " << std::strerror(err));
+      }
+    }
+    return true;
+  }
+
+  void stop() {
+    if (!is_running_) {
+      return;
+    }
+    is_running_ = false;
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  bool isRunning() const { return is_running_; }
+
+private:
+  void run() {
+    timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (is_running_) {
+      cycle_();
+
+      // sleep until the next cycle begins on the absolute clock to avoid drifting.
+      // on overruns, restart the schedule from now instead of bursting to catch up.
+      addNanoseconds(&next, period_ns_);
+      timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      if (now.tv_sec > next.tv_sec || (now.tv_sec == next.tv_sec && now.tv_nsec > next.tv_nsec)) {
+        next = now;
+        continue;
+      }
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR) {
+      }
+    }
+  }
+
+  static void addNanoseconds(timespec *const t, const long ns) {
+    t->tv_nsec += ns;
+    while (t->tv_nsec >= 1000000000L) {
+      t->tv_nsec -= 1000000000L;
+      ++t->tv_sec;
+    }
+  }
+
+private:
+  std::function< void() > cycle_;
+  long period_ns_;
+  std::atomic< bool > is_running_;
+  std::thread thread_;
+};
+
+typedef std::shared_ptr< RealtimeThread > RealtimeThreadPtr;
+typedef std::shared_ptr< const RealtimeThread > RealtimeThreadConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
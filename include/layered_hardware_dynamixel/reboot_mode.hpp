@@ -3,6 +3,7 @@
 
 #include <layered_hardware_dynamixel/common_namespaces.hpp>
 #include <layered_hardware_dynamixel/dynamixel_actuator_data.hpp>
+#include <layered_hardware_dynamixel/indirect_mapper.hpp>
 #include <layered_hardware_dynamixel/operating_mode_base.hpp>
 #include <ros/console.h>
 #include <ros/duration.h>
@@ -10,18 +11,53 @@
 
 namespace layered_hardware_dynamixel {
 
+// reboots the actuator without blocking the bus.
+// the actuator is pinged at a bounded rate in read cycles to confirm recovery,
+// so other actuators on the bus keep streaming while it is rebooting.
 class RebootMode : public OperatingModeBase {
 public:
-  RebootMode(const DynamixelActuatorDataPtr &data) : OperatingModeBase("reboot", data) {}
+  RebootMode(const DynamixelActuatorDataPtr &data)
+      : OperatingModeBase("reboot", data, READ_NONE), ping_interval_(0.05), timeout_(0.5) {}
 
   virtual void starting() override {
-    reboot();
-    // confirm the actuator has been rebooted by ping for certain duration
-    pingFor(ros::Duration(0.5));
+    // the actuator does not respond until it boots up, and loses values in RAM
+    data_->is_available = false;
+    data_->forgetControlTable();
+    if (!reboot()) {
+      data_->reboot_status = REBOOT_FAILED;
+      return;
+    }
+    data_->reboot_status = REBOOTING;
+    reboot_time_ = ros::Time::now();
+    last_ping_time_ = reboot_time_;
   }
 
   virtual void read(const ros::Time &time, const ros::Duration &period) override {
-    // nothing to do
+    if (data_->reboot_status != REBOOTING || time - last_ping_time_ < ping_interval_) {
+      return;
+    }
+
+    // confirm the actuator has been rebooted by one ping per interval
+    last_ping_time_ = time;
+    if (data_->dxl_wb->ping(data_->id)) {
+      ROS_INFO_STREAM("RebootMode::read(): Rebooted '"
+                      << data_->name << "' (id: " << static_cast< int >(data_->id) << ") in "
+                      << (time - reboot_time_).toSec() << " s");
+      // rebooting clears the indirect address table
+      if (!IndirectMapper::program(data_.get())) {
+        data_->reboot_status = REBOOT_FAILED;
+        return;
+      }
+      data_->reboot_status = REBOOT_SUCCEEDED;
+      data_->is_available = true;
+      return;
+    }
+    if (time - reboot_time_ > timeout_) {
+      ROS_ERROR_STREAM("RebootMode::read(): No ping response from '"
+                       << data_->name << "' (id: " << static_cast< int >(data_->id) << ") for "
+                       << timeout_.toSec() << " s after reboot");
+      data_->reboot_status = REBOOT_FAILED;
+    }
   }
 
   virtual void write(const ros::Time &time, const ros::Duration &period) override {
@@ -29,8 +65,13 @@ public:
   }
 
   virtual void stopping() override {
-    // nothing to do
+    // let other modes try the actuator even if it has not been confirmed
+    data_->is_available = true;
   }
+
+private:
+  const ros::Duration ping_interval_, timeout_;
+  ros::Time reboot_time_, last_ping_time_;
 };
 } // namespace layered_hardware_dynamixel
 
@@ -0,0 +1,561 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_RECORDING_BACKEND_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_RECORDING_BACKEND_HPP
+
+#include <cstdint>
+#include <memory>
+
+#include <dynamixel_workbench_toolbox/dynamixel_workbench.h>
+#include <layered_hardware_dynamixel/bus_backend.hpp>
+#include <layered_hardware_dynamixel/bus_log.hpp>
+
+namespace layered_hardware_dynamixel {
+
+// forwards all calls to another backend and records them with their results into a bus log.
+// DynamixelWorkbench does not expose raw packets, so each instruction is recorded
+// as the call which sends it and each status packet as the results of the call.
+class RecordingBackend : public BusBackend {
+public:
+  RecordingBackend(const BusBackendPtr &backend, const BusLogWriterPtr &writer)
+      : backend_(backend), writer_(writer) {}
+
+  virtual ~RecordingBackend() {}
+
+  const BusBackendPtr &getBackend() const { return backend_; }
+
+  //
+  // the link & models
+  //
+
+  virtual bool init(const char *device_name, std::uint32_t baud_rate,
+                    const char **log = NULL) override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_INIT));
+    record->putString(device_name);
+    record->put(baud_rate);
+    record->endInput();
+    const char *call_log(NULL);
+    const bool result(backend_->init(device_name, baud_rate, &call_log));
+    return finish(record, result, call_log, log);
+  }
+
+  virtual float getProtocolVersion() override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_GET_PROTOCOL_VERSION));
+    record->endInput();
+    const float version(backend_->getProtocolVersion());
+    record->put(version);
+    finish(record);
+    return version;
+  }
+
+  virtual const char *getModelName(std::uint8_t id, const char **log = NULL) override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_GET_MODEL_NAME));
+    record->put(id);
+    record->endInput();
+    const char *call_log(NULL);
+    const char *const name(backend_->getModelName(id, &call_log));
+    if (name) {
+      record->putString(name);
+    }
+    finish(record, name != NULL, call_log, log);
+    return name;
+  }
+
+  virtual std::uint16_t getModelNumber(std::uint8_t id, const char **log = NULL) override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_GET_MODEL_NUMBER));
+    record->put(id);
+    record->endInput();
+    const char *call_log(NULL);
+    const std::uint16_t model_number(backend_->getModelNumber(id, &call_log));
+    if (model_number != 0) {
+      record->put(model_number);
+    }
+    finish(record, model_number != 0, call_log, log);
+    return model_number;
+  }
+
+  virtual const ControlItem *getItemInfo(std::uint8_t id, const char *item_name,
+                                         const char **log = NULL) override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_GET_ITEM_INFO));
+    record->put(id);
+    record->putString(item_name);
+    record->endInput();
+    const char *call_log(NULL);
+    const ControlItem *const item(backend_->getItemInfo(id, item_name, &call_log));
+    if (item) {
+      record->put(item->address);
+      record->put(item->data_length);
+    }
+    finish(record, item != NULL, call_log, log);
+    return item;
+  }
+
+  virtual const ModelInfo *getModelInfo(std::uint8_t id, const char **log = NULL) override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_GET_MODEL_INFO));
+    record->put(id);
+    record->endInput();
+    const char *call_log(NULL);
+    const ModelInfo *const info(backend_->getModelInfo(id, &call_log));
+    if (info) {
+      record->put(info->rpm);
+      record->put(info->value_of_min_radian_position);
+      record->put(info->value_of_zero_radian_position);
+      record->put(info->value_of_max_radian_position);
+      record->put(info->min_radian);
+      record->put(info->max_radian);
+    }
+    finish(record, info != NULL, call_log, log);
+    return info;
+  }
+
+  //
+  // unit conversions by the model
+  //
+
+  virtual std::int32_t convertRadian2Value(std::uint8_t id, float radian) override {
+    return convert(BUS_LOG_CONVERT_RADIAN_TO_VALUE, &BusBackend::convertRadian2Value, id, radian);
+  }
+
+  virtual float convertValue2Radian(std::uint8_t id, std::int32_t value) override {
+    return convert(BUS_LOG_CONVERT_VALUE_TO_RADIAN, &BusBackend::convertValue2Radian, id, value);
+  }
+
+  virtual std::int32_t convertVelocity2Value(std::uint8_t id, float velocity) override {
+    return convert(BUS_LOG_CONVERT_VELOCITY_TO_VALUE, &BusBackend::convertVelocity2Value, id,
+                   velocity);
+  }
+
+  virtual float convertValue2Velocity(std::uint8_t id, std::int32_t value) override {
+    return convert(BUS_LOG_CONVERT_VALUE_TO_VELOCITY, &BusBackend::convertValue2Velocity, id,
+                   value);
+  }
+
+  virtual std::int16_t convertCurrent2Value(std::uint8_t id, float current) override {
+    return convert(BUS_LOG_CONVERT_CURRENT_TO_VALUE, &BusBackend::convertCurrent2Value, id,
+                   current);
+  }
+
+  virtual float convertValue2Current(std::uint8_t id, std::int16_t value) override {
+    return convert(BUS_LOG_CONVERT_VALUE_TO_CURRENT, &BusBackend::convertValue2Current, id, value);
+  }
+
+  //
+  // instructions to an actuator
+  //
+
+  virtual bool ping(std::uint8_t id, std::uint16_t *get_model_number,
+                    const char **log = NULL) override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_PING));
+    record->put(id);
+    record->endInput();
+    const char *call_log(NULL);
+    std::uint16_t model_number(0);
+    const bool result(backend_->ping(id, &model_number, &call_log));
+    if (result) {
+      record->put(model_number);
+      if (get_model_number) {
+        *get_model_number = model_number;
+      }
+    }
+    return finish(record, result, call_log, log);
+  }
+
+  virtual bool ping(std::uint8_t id, const char **log = NULL) override {
+    return ping(id, NULL, log);
+  }
+
+  virtual bool scan(std::uint8_t *get_id, std::uint8_t *get_the_number_of_id,
+                    std::uint8_t range = 253, const char **log = NULL) override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_SCAN));
+    record->put(range);
+    record->endInput();
+    const char *call_log(NULL);
+    const bool result(backend_->scan(get_id, get_the_number_of_id, range, &call_log));
+    if (result) {
+      record->put(*get_the_number_of_id);
+      record->putBytes(get_id, *get_the_number_of_id);
+    }
+    return finish(record, result, call_log, log);
+  }
+
+  virtual bool reboot(std::uint8_t id, const char **log = NULL) override {
+    return instruct(BUS_LOG_REBOOT, &BusBackend::reboot, id, log);
+  }
+
+  virtual bool clearMultiTurn(std::uint8_t id, const char **log = NULL) override {
+    return instruct(BUS_LOG_CLEAR_MULTI_TURN, &BusBackend::clearMultiTurn, id, log);
+  }
+
+  virtual bool readRegister(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                            std::uint32_t *data, const char **log = NULL) override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_READ_REGISTER));
+    record->put(id);
+    record->put(address);
+    record->put(length);
+    record->endInput();
+    const char *call_log(NULL);
+    const bool result(backend_->readRegister(id, address, length, data, &call_log));
+    if (result) {
+      record->put(*data);
+    }
+    return finish(record, result, call_log, log);
+  }
+
+  virtual bool readRegister(std::uint8_t id, const char *item_name, std::int32_t *data,
+                            const char **log = NULL) override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_READ_ITEM_REGISTER));
+    record->put(id);
+    record->putString(item_name);
+    record->endInput();
+    const char *call_log(NULL);
+    const bool result(backend_->readRegister(id, item_name, data, &call_log));
+    if (result) {
+      record->put(*data);
+    }
+    return finish(record, result, call_log, log);
+  }
+
+  virtual bool writeRegister(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                             std::uint8_t *data, const char **log = NULL) override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_WRITE_REGISTER));
+    record->put(id);
+    record->put(address);
+    record->put(length);
+    record->putBytes(data, length);
+    record->endInput();
+    const char *call_log(NULL);
+    const bool result(backend_->writeRegister(id, address, length, data, &call_log));
+    return finish(record, result, call_log, log);
+  }
+
+  virtual bool itemRead(std::uint8_t id, const char *item_name, std::int32_t *data,
+                        const char **log = NULL) override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_ITEM_READ));
+    record->put(id);
+    record->putString(item_name);
+    record->endInput();
+    const char *call_log(NULL);
+    const bool result(backend_->itemRead(id, item_name, data, &call_log));
+    if (result) {
+      record->put(*data);
+    }
+    return finish(record, result, call_log, log);
+  }
+
+  virtual bool itemWrite(std::uint8_t id, const char *item_name, std::int32_t data,
+                         const char **log = NULL) override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_ITEM_WRITE));
+    record->put(id);
+    record->putString(item_name);
+    record->put(data);
+    record->endInput();
+    const char *call_log(NULL);
+    const bool result(backend_->itemWrite(id, item_name, data, &call_log));
+    return finish(record, result, call_log, log);
+  }
+
+  virtual bool torqueOn(std::uint8_t id, const char **log = NULL) override {
+    return instruct(BUS_LOG_TORQUE_ON, &BusBackend::torqueOn, id, log);
+  }
+
+  virtual bool torqueOff(std::uint8_t id, const char **log = NULL) override {
+    return instruct(BUS_LOG_TORQUE_OFF, &BusBackend::torqueOff, id, log);
+  }
+
+  virtual bool setCurrentControlMode(std::uint8_t id, const char **log = NULL) override {
+    return instruct(BUS_LOG_SET_CURRENT_CONTROL_MODE, &BusBackend::setCurrentControlMode, id, log);
+  }
+
+  virtual bool setVelocityControlMode(std::uint8_t id, const char **log = NULL) override {
+    return instruct(BUS_LOG_SET_VELOCITY_CONTROL_MODE, &BusBackend::setVelocityControlMode, id,
+                    log);
+  }
+
+  virtual bool setPositionControlMode(std::uint8_t id, const char **log = NULL) override {
+    return instruct(BUS_LOG_SET_POSITION_CONTROL_MODE, &BusBackend::setPositionControlMode, id,
+                    log);
+  }
+
+  virtual bool setExtendedPositionControlMode(std::uint8_t id, const char **log = NULL) override {
+    return instruct(BUS_LOG_SET_EXTENDED_POSITION_CONTROL_MODE,
+                    &BusBackend::setExtendedPositionControlMode, id, log);
+  }
+
+  virtual bool setCurrentBasedPositionControlMode(std::uint8_t id,
+                                                  const char **log = NULL) override {
+    return instruct(BUS_LOG_SET_CURRENT_BASED_POSITION_CONTROL_MODE,
+                    &BusBackend::setCurrentBasedPositionControlMode, id, log);
+  }
+
+  virtual bool setPWMControlMode(std::uint8_t id, const char **log = NULL) override {
+    return instruct(BUS_LOG_SET_PWM_CONTROL_MODE, &BusBackend::setPWMControlMode, id, log);
+  }
+
+  //
+  // group instructions
+  //
+
+  virtual std::uint8_t getTheNumberOfSyncWriteHandler() override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_GET_NUMBER_OF_SYNC_WRITE_HANDLERS));
+    record->endInput();
+    const std::uint8_t n_handlers(backend_->getTheNumberOfSyncWriteHandler());
+    record->put(n_handlers);
+    finish(record);
+    return n_handlers;
+  }
+
+  virtual bool addSyncWriteHandler(std::uint16_t address, std::uint16_t length,
+                                   const char **log = NULL) override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_ADD_SYNC_WRITE_HANDLER));
+    record->put(address);
+    record->put(length);
+    record->endInput();
+    const char *call_log(NULL);
+    const bool result(backend_->addSyncWriteHandler(address, length, &call_log));
+    return finish(record, result, call_log, log);
+  }
+
+  virtual bool syncWrite(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                         std::int32_t *data, std::uint8_t data_num_for_each_id,
+                         const char **log = NULL) override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_SYNC_WRITE));
+    record->put(index);
+    record->put(id_num);
+    record->putBytes(id, id_num);
+    record->put(data_num_for_each_id);
+    record->putBytes(data, sizeof(std::int32_t) * id_num * data_num_for_each_id);
+    record->endInput();
+    const char *call_log(NULL);
+    const bool result(
+        backend_->syncWrite(index, id, id_num, data, data_num_for_each_id, &call_log));
+    return finish(record, result, call_log, log);
+  }
+
+  virtual std::uint8_t getTheNumberOfSyncReadHandler() override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_GET_NUMBER_OF_SYNC_READ_HANDLERS));
+    record->endInput();
+    const std::uint8_t n_handlers(backend_->getTheNumberOfSyncReadHandler());
+    record->put(n_handlers);
+    finish(record);
+    return n_handlers;
+  }
+
+  virtual bool addSyncReadHandler(std::uint16_t address, std::uint16_t length,
+                                  const char **log = NULL) override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_ADD_SYNC_READ_HANDLER));
+    record->put(address);
+    record->put(length);
+    record->endInput();
+    const char *call_log(NULL);
+    const bool result(backend_->addSyncReadHandler(address, length, &call_log));
+    return finish(record, result, call_log, log);
+  }
+
+  virtual bool syncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                        const char **log = NULL) override {
+    return read(BUS_LOG_SYNC_READ, &BusBackend::syncRead, index, id, id_num, log);
+  }
+
+  virtual bool supportsFastSyncRead() override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_SUPPORTS_FAST_SYNC_READ));
+    record->endInput();
+    const bool result(backend_->supportsFastSyncRead());
+    return finish(record, result, NULL, NULL);
+  }
+
+  virtual bool fastSyncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                            const char **log = NULL) override {
+    return read(BUS_LOG_FAST_SYNC_READ, &BusBackend::fastSyncRead, index, id, id_num, log);
+  }
+
+  virtual bool supportsSplitSyncRead() override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_SUPPORTS_SPLIT_SYNC_READ));
+    record->endInput();
+    const bool result(backend_->supportsSplitSyncRead());
+    return finish(record, result, NULL, NULL);
+  }
+
+  virtual bool beginSyncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                             const char **log = NULL) override {
+    return read(BUS_LOG_BEGIN_SYNC_READ, &BusBackend::beginSyncRead, index, id, id_num, log);
+  }
+
+  virtual bool beginFastSyncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                                 const char **log = NULL) override {
+    return read(BUS_LOG_BEGIN_FAST_SYNC_READ, &BusBackend::beginFastSyncRead, index, id, id_num,
+                log);
+  }
+
+  virtual bool finishSyncRead(std::uint8_t index, const char **log = NULL) override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_FINISH_SYNC_READ));
+    record->put(index);
+    record->endInput();
+    const char *call_log(NULL);
+    const bool result(backend_->finishSyncRead(index, &call_log));
+    return finish(record, result, call_log, log);
+  }
+
+  virtual bool getSyncReadData(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                               std::uint16_t address, std::uint16_t length, std::int32_t *data,
+                               const char **log = NULL) override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_GET_SYNC_READ_DATA));
+    record->put(index);
+    record->put(id_num);
+    record->putBytes(id, id_num);
+    record->put(address);
+    record->put(length);
+    record->endInput();
+    const char *call_log(NULL);
+    const bool result(
+        backend_->getSyncReadData(index, id, id_num, address, length, data, &call_log));
+    if (result) {
+      record->putBytes(data, sizeof(std::int32_t) * id_num);
+    }
+    return finish(record, result, call_log, log);
+  }
+
+  virtual bool initBulkRead(const char **log = NULL) override {
+    return call(BUS_LOG_INIT_BULK_READ, &BusBackend::initBulkRead, log);
+  }
+
+  virtual bool addBulkReadParam(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                                const char **log = NULL) override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_ADD_BULK_READ_PARAM));
+    record->put(id);
+    record->put(address);
+    record->put(length);
+    record->endInput();
+    const char *call_log(NULL);
+    const bool result(backend_->addBulkReadParam(id, address, length, &call_log));
+    return finish(record, result, call_log, log);
+  }
+
+  virtual bool bulkRead(const char **log = NULL) override {
+    return call(BUS_LOG_BULK_READ, &BusBackend::bulkRead, log);
+  }
+
+  virtual bool getBulkReadData(std::uint8_t *id, std::uint8_t id_num, std::uint16_t *address,
+                               std::uint16_t *length, std::int32_t *data,
+                               const char **log = NULL) override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_GET_BULK_READ_DATA));
+    record->put(id_num);
+    record->putBytes(id, id_num);
+    record->putBytes(address, sizeof(std::uint16_t) * id_num);
+    record->putBytes(length, sizeof(std::uint16_t) * id_num);
+    record->endInput();
+    const char *call_log(NULL);
+    const bool result(backend_->getBulkReadData(id, id_num, address, length, data, &call_log));
+    if (result) {
+      record->putBytes(data, sizeof(std::int32_t) * id_num);
+    }
+    return finish(record, result, call_log, log);
+  }
+
+  virtual bool clearBulkReadParam() override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_CLEAR_BULK_READ_PARAM));
+    record->endInput();
+    const bool result(backend_->clearBulkReadParam());
+    return finish(record, result, NULL, NULL);
+  }
+
+  virtual bool initBulkWrite(const char **log = NULL) override {
+    return call(BUS_LOG_INIT_BULK_WRITE, &BusBackend::initBulkWrite, log);
+  }
+
+  virtual bool addBulkWriteParam(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                                 std::int32_t data, const char **log = NULL) override {
+    BusLogRecord *const record(writer_->take(BUS_LOG_ADD_BULK_WRITE_PARAM));
+    record->put(id);
+    record->put(address);
+    record->put(length);
+    record->put(data);
+    record->endInput();
+    const char *call_log(NULL);
+    const bool result(backend_->addBulkWriteParam(id, address, length, data, &call_log));
+    return finish(record, result, call_log, log);
+  }
+
+  virtual bool bulkWrite(const char **log = NULL) override {
+    return call(BUS_LOG_BULK_WRITE, &BusBackend::bulkWrite, log);
+  }
+
+private:
+  // calls with no input & output other than the result
+  bool call(const std::uint8_t op, bool (BusBackend::*const func)(const char **),
+            const char **const log) {
+    BusLogRecord *const record(writer_->take(op));
+    record->endInput();
+    const char *call_log(NULL);
+    const bool result(((*backend_).*func)(&call_log));
+    return finish(record, result, call_log, log);
+  }
+
+  // instructions with an id only
+  bool instruct(const std::uint8_t op, bool (BusBackend::*const func)(std::uint8_t, const char **),
+                const std::uint8_t id, const char **const log) {
+    BusLogRecord *const record(writer_->take(op));
+    record->put(id);
+    record->endInput();
+    const char *call_log(NULL);
+    const bool result(((*backend_).*func)(id, &call_log));
+    return finish(record, result, call_log, log);
+  }
+
+  // group reads to a handler
+  bool read(const std::uint8_t op,
+            bool (BusBackend::*const func)(std::uint8_t, std::uint8_t *, std::uint8_t,
+                                           const char **),
+            const std::uint8_t index, std::uint8_t *const id, const std::uint8_t id_num,
+            const char **const log) {
+    BusLogRecord *const record(writer_->take(op));
+    record->put(index);
+    record->put(id_num);
+    record->putBytes(id, id_num);
+    record->endInput();
+    const char *call_log(NULL);
+    const bool result(((*backend_).*func)(index, id, id_num, &call_log));
+    return finish(record, result, call_log, log);
+  }
+
+  template < typename Output, typename Input >
+  Output convert(const std::uint8_t op,
+                 Output (BusBackend::*const func)(std::uint8_t, Input), const std::uint8_t id,
+                 const Input input) {
+    BusLogRecord *const record(writer_->take(op));
+    record->put(id);
+    record->put(input);
+    record->endInput();
+    const Output output(((*backend_).*func)(id, input));
+    record->put(output);
+    finish(record);
+    return output;
+  }
+
+  // commit the record of the call which returns a value
+  void finish(BusLogRecord *const record) {
+    record->setSucceeded(true);
+    writer_->commit(record);
+  }
+
+  // commit the record of the call with the log of the backend as the output on failure
+  bool finish(BusLogRecord *const record, const bool result, const char *const call_log,
+              const char **const log) {
+    if (!result) {
+      record->putString(call_log);
+    }
+    record->setSucceeded(result);
+    writer_->commit(record);
+    if (log) {
+      *log = call_log;
+    }
+    return result;
+  }
+
+private:
+  const BusBackendPtr backend_;
+  const BusLogWriterPtr writer_;
+};
+
+typedef std::shared_ptr< RecordingBackend > RecordingBackendPtr;
+typedef std::shared_ptr< const RecordingBackend > RecordingBackendConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
@@ -0,0 +1,542 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_REPLAY_BACKEND_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_REPLAY_BACKEND_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <dynamixel_workbench_toolbox/dynamixel_workbench.h>
+#include <layered_hardware_dynamixel/bus_backend.hpp>
+#include <layered_hardware_dynamixel/bus_log.hpp>
+#include <ros/console.h>
+
+namespace layered_hardware_dynamixel {
+
+// answers calls with results in a bus log recorded by RecordingBackend,
+// so that the layer can be profiled & debugged offline without actuators.
+// each call must be the same as the next one in the log (the same arguments in the same order).
+// a call which differs fails without consuming the log, which usually means
+// the configuration of the layer differs from the recorded one.
+// if waits is true, each call takes its recorded duration.
+class ReplayBackend : public BusBackend {
+public:
+  ReplayBackend(const std::string &path, const bool waits = false)
+      : path_(path), waits_(waits), pos_(0), has_diverged_(false) {}
+
+  virtual ~ReplayBackend() {}
+
+  // the number of replayed calls
+  std::size_t getPosition() const { return pos_; }
+
+  bool isFinished() const { return pos_ >= log_.getEntries().size(); }
+
+  //
+  // the link & models
+  //
+
+  virtual bool init(const char *device_name, std::uint32_t baud_rate,
+                    const char **log = NULL) override {
+    if (!log_.load(path_)) {
+      if (log) {
+        *log = "[ReplayBackend] Failed to load the bus log";
+      }
+      return false;
+    }
+    pos_ = 0;
+    has_diverged_ = false;
+    BusLogRecord call(BUS_LOG_INIT);
+    call.putString(device_name);
+    call.put(baud_rate);
+    BusLogReader output;
+    return replay(call, &output, log);
+  }
+
+  virtual float getProtocolVersion() override {
+    BusLogRecord call(BUS_LOG_GET_PROTOCOL_VERSION);
+    return value< float >(call);
+  }
+
+  virtual const char *getModelName(std::uint8_t id, const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_GET_MODEL_NAME);
+    call.put(id);
+    BusLogReader output;
+    if (!replay(call, &output, log)) {
+      return NULL;
+    }
+    std::string &name(model_names_[id]);
+    output.getString(&name);
+    return name.c_str();
+  }
+
+  virtual std::uint16_t getModelNumber(std::uint8_t id, const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_GET_MODEL_NUMBER);
+    call.put(id);
+    BusLogReader output;
+    std::uint16_t model_number(0);
+    if (replay(call, &output, log)) {
+      output.get(&model_number);
+    }
+    return model_number;
+  }
+
+  virtual const ControlItem *getItemInfo(std::uint8_t id, const char *item_name,
+                                         const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_GET_ITEM_INFO);
+    call.put(id);
+    call.putString(item_name);
+    BusLogReader output;
+    if (!replay(call, &output, log)) {
+      return NULL;
+    }
+    // keep the item and its name as long as the backend like DynamixelWorkbench does
+    Item &item(items_[std::make_pair(id, std::string(item_name))]);
+    item.name = item_name;
+    item.item.item_name = item.name.c_str();
+    item.item.item_name_length = item.name.size();
+    output.get(&item.item.address);
+    output.get(&item.item.data_length);
+    return &item.item;
+  }
+
+  virtual const ModelInfo *getModelInfo(std::uint8_t id, const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_GET_MODEL_INFO);
+    call.put(id);
+    BusLogReader output;
+    if (!replay(call, &output, log)) {
+      return NULL;
+    }
+    ModelInfo &info(model_infos_[id]);
+    output.get(&info.rpm);
+    output.get(&info.value_of_min_radian_position);
+    output.get(&info.value_of_zero_radian_position);
+    output.get(&info.value_of_max_radian_position);
+    output.get(&info.min_radian);
+    output.get(&info.max_radian);
+    return &info;
+  }
+
+  //
+  // unit conversions by the model
+  //
+
+  virtual std::int32_t convertRadian2Value(std::uint8_t id, float radian) override {
+    return convert< std::int32_t >(BUS_LOG_CONVERT_RADIAN_TO_VALUE, id, radian);
+  }
+
+  virtual float convertValue2Radian(std::uint8_t id, std::int32_t value) override {
+    return convert< float >(BUS_LOG_CONVERT_VALUE_TO_RADIAN, id, value);
+  }
+
+  virtual std::int32_t convertVelocity2Value(std::uint8_t id, float velocity) override {
+    return convert< std::int32_t >(BUS_LOG_CONVERT_VELOCITY_TO_VALUE, id, velocity);
+  }
+
+  virtual float convertValue2Velocity(std::uint8_t id, std::int32_t value) override {
+    return convert< float >(BUS_LOG_CONVERT_VALUE_TO_VELOCITY, id, value);
+  }
+
+  virtual std::int16_t convertCurrent2Value(std::uint8_t id, float current) override {
+    return convert< std::int16_t >(BUS_LOG_CONVERT_CURRENT_TO_VALUE, id, current);
+  }
+
+  virtual float convertValue2Current(std::uint8_t id, std::int16_t value) override {
+    return convert< float >(BUS_LOG_CONVERT_VALUE_TO_CURRENT, id, value);
+  }
+
+  //
+  // instructions to an actuator
+  //
+
+  virtual bool ping(std::uint8_t id, std::uint16_t *get_model_number,
+                    const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_PING);
+    call.put(id);
+    BusLogReader output;
+    if (!replay(call, &output, log)) {
+      return false;
+    }
+    if (get_model_number) {
+      output.get(get_model_number);
+    }
+    return true;
+  }
+
+  virtual bool ping(std::uint8_t id, const char **log = NULL) override {
+    return ping(id, NULL, log);
+  }
+
+  virtual bool scan(std::uint8_t *get_id, std::uint8_t *get_the_number_of_id,
+                    std::uint8_t range = 253, const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_SCAN);
+    call.put(range);
+    BusLogReader output;
+    return replay(call, &output, log) && output.get(get_the_number_of_id) &&
+           output.getBytes(get_id, *get_the_number_of_id);
+  }
+
+  virtual bool reboot(std::uint8_t id, const char **log = NULL) override {
+    return instruct(BUS_LOG_REBOOT, id, log);
+  }
+
+  virtual bool clearMultiTurn(std::uint8_t id, const char **log = NULL) override {
+    return instruct(BUS_LOG_CLEAR_MULTI_TURN, id, log);
+  }
+
+  virtual bool readRegister(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                            std::uint32_t *data, const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_READ_REGISTER);
+    call.put(id);
+    call.put(address);
+    call.put(length);
+    BusLogReader output;
+    return replay(call, &output, log) && output.get(data);
+  }
+
+  virtual bool readRegister(std::uint8_t id, const char *item_name, std::int32_t *data,
+                            const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_READ_ITEM_REGISTER);
+    call.put(id);
+    call.putString(item_name);
+    BusLogReader output;
+    return replay(call, &output, log) && output.get(data);
+  }
+
+  virtual bool writeRegister(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                             std::uint8_t *data, const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_WRITE_REGISTER);
+    call.put(id);
+    call.put(address);
+    call.put(length);
+    call.putBytes(data, length);
+    BusLogReader output;
+    return replay(call, &output, log);
+  }
+
+  virtual bool itemRead(std::uint8_t id, const char *item_name, std::int32_t *data,
+                        const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_ITEM_READ);
+    call.put(id);
+    call.putString(item_name);
+    BusLogReader output;
+    return replay(call, &output, log) && output.get(data);
+  }
+
+  virtual bool itemWrite(std::uint8_t id, const char *item_name, std::int32_t data,
+                         const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_ITEM_WRITE);
+    call.put(id);
+    call.putString(item_name);
+    call.put(data);
+    BusLogReader output;
+    return replay(call, &output, log);
+  }
+
+  virtual bool torqueOn(std::uint8_t id, const char **log = NULL) override {
+    return instruct(BUS_LOG_TORQUE_ON, id, log);
+  }
+
+  virtual bool torqueOff(std::uint8_t id, const char **log = NULL) override {
+    return instruct(BUS_LOG_TORQUE_OFF, id, log);
+  }
+
+  virtual bool setCurrentControlMode(std::uint8_t id, const char **log = NULL) override {
+    return instruct(BUS_LOG_SET_CURRENT_CONTROL_MODE, id, log);
+  }
+
+  virtual bool setVelocityControlMode(std::uint8_t id, const char **log = NULL) override {
+    return instruct(BUS_LOG_SET_VELOCITY_CONTROL_MODE, id, log);
+  }
+
+  virtual bool setPositionControlMode(std::uint8_t id, const char **log = NULL) override {
+    return instruct(BUS_LOG_SET_POSITION_CONTROL_MODE, id, log);
+  }
+
+  virtual bool setExtendedPositionControlMode(std::uint8_t id, const char **log = NULL) override {
+    return instruct(BUS_LOG_SET_EXTENDED_POSITION_CONTROL_MODE, id, log);
+  }
+
+  virtual bool setCurrentBasedPositionControlMode(std::uint8_t id,
+                                                  const char **log = NULL) override {
+    return instruct(BUS_LOG_SET_CURRENT_BASED_POSITION_CONTROL_MODE, id, log);
+  }
+
+  virtual bool setPWMControlMode(std::uint8_t id, const char **log = NULL) override {
+    return instruct(BUS_LOG_SET_PWM_CONTROL_MODE, id, log);
+  }
+
+  //
+  // group instructions
+  //
+
+  virtual std::uint8_t getTheNumberOfSyncWriteHandler() override {
+    BusLogRecord call(BUS_LOG_GET_NUMBER_OF_SYNC_WRITE_HANDLERS);
+    return value< std::uint8_t >(call);
+  }
+
+  virtual bool addSyncWriteHandler(std::uint16_t address, std::uint16_t length,
+                                   const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_ADD_SYNC_WRITE_HANDLER);
+    call.put(address);
+    call.put(length);
+    BusLogReader output;
+    return replay(call, &output, log);
+  }
+
+  virtual bool syncWrite(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                         std::int32_t *data, std::uint8_t data_num_for_each_id,
+                         const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_SYNC_WRITE);
+    call.put(index);
+    call.put(id_num);
+    call.putBytes(id, id_num);
+    call.put(data_num_for_each_id);
+    call.putBytes(data, sizeof(std::int32_t) * id_num * data_num_for_each_id);
+    BusLogReader output;
+    return replay(call, &output, log);
+  }
+
+  virtual std::uint8_t getTheNumberOfSyncReadHandler() override {
+    BusLogRecord call(BUS_LOG_GET_NUMBER_OF_SYNC_READ_HANDLERS);
+    return value< std::uint8_t >(call);
+  }
+
+  virtual bool addSyncReadHandler(std::uint16_t address, std::uint16_t length,
+                                  const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_ADD_SYNC_READ_HANDLER);
+    call.put(address);
+    call.put(length);
+    BusLogReader output;
+    return replay(call, &output, log);
+  }
+
+  virtual bool syncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                        const char **log = NULL) override {
+    return read(BUS_LOG_SYNC_READ, index, id, id_num, log);
+  }
+
+  virtual bool supportsFastSyncRead() override {
+    BusLogRecord call(BUS_LOG_SUPPORTS_FAST_SYNC_READ);
+    BusLogReader output;
+    return replay(call, &output, NULL);
+  }
+
+  virtual bool fastSyncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                            const char **log = NULL) override {
+    return read(BUS_LOG_FAST_SYNC_READ, index, id, id_num, log);
+  }
+
+  virtual bool supportsSplitSyncRead() override {
+    BusLogRecord call(BUS_LOG_SUPPORTS_SPLIT_SYNC_READ);
+    BusLogReader output;
+    return replay(call, &output, NULL);
+  }
+
+  virtual bool beginSyncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                             const char **log = NULL) override {
+    return read(BUS_LOG_BEGIN_SYNC_READ, index, id, id_num, log);
+  }
+
+  virtual bool beginFastSyncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                                 const char **log = NULL) override {
+    return read(BUS_LOG_BEGIN_FAST_SYNC_READ, index, id, id_num, log);
+  }
+
+  virtual bool finishSyncRead(std::uint8_t index, const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_FINISH_SYNC_READ);
+    call.put(index);
+    BusLogReader output;
+    return replay(call, &output, log);
+  }
+
+  virtual bool getSyncReadData(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                               std::uint16_t address, std::uint16_t length, std::int32_t *data,
+                               const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_GET_SYNC_READ_DATA);
+    call.put(index);
+    call.put(id_num);
+    call.putBytes(id, id_num);
+    call.put(address);
+    call.put(length);
+    BusLogReader output;
+    return replay(call, &output, log) &&
+           output.getBytes(data, sizeof(std::int32_t) * id_num);
+  }
+
+  virtual bool initBulkRead(const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_INIT_BULK_READ);
+    BusLogReader output;
+    return replay(call, &output, log);
+  }
+
+  virtual bool addBulkReadParam(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                                const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_ADD_BULK_READ_PARAM);
+    call.put(id);
+    call.put(address);
+    call.put(length);
+    BusLogReader output;
+    return replay(call, &output, log);
+  }
+
+  virtual bool bulkRead(const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_BULK_READ);
+    BusLogReader output;
+    return replay(call, &output, log);
+  }
+
+  virtual bool getBulkReadData(std::uint8_t *id, std::uint8_t id_num, std::uint16_t *address,
+                               std::uint16_t *length, std::int32_t *data,
+                               const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_GET_BULK_READ_DATA);
+    call.put(id_num);
+    call.putBytes(id, id_num);
+    call.putBytes(address, sizeof(std::uint16_t) * id_num);
+    call.putBytes(length, sizeof(std::uint16_t) * id_num);
+    BusLogReader output;
+    return replay(call, &output, log) &&
+           output.getBytes(data, sizeof(std::int32_t) * id_num);
+  }
+
+  virtual bool clearBulkReadParam() override {
+    BusLogRecord call(BUS_LOG_CLEAR_BULK_READ_PARAM);
+    BusLogReader output;
+    return replay(call, &output, NULL);
+  }
+
+  virtual bool initBulkWrite(const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_INIT_BULK_WRITE);
+    BusLogReader output;
+    return replay(call, &output, log);
+  }
+
+  virtual bool addBulkWriteParam(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                                 std::int32_t data, const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_ADD_BULK_WRITE_PARAM);
+    call.put(id);
+    call.put(address);
+    call.put(length);
+    call.put(data);
+    BusLogReader output;
+    return replay(call, &output, log);
+  }
+
+  virtual bool bulkWrite(const char **log = NULL) override {
+    BusLogRecord call(BUS_LOG_BULK_WRITE);
+    BusLogReader output;
+    return replay(call, &output, log);
+  }
+
+private:
+  // an item returned by getItemInfo() and the storage of its name
+  struct Item {
+    ControlItem item;
+    std::string name;
+  };
+
+  bool instruct(const std::uint8_t op, const std::uint8_t id, const char **const log) {
+    BusLogRecord call(op);
+    call.put(id);
+    BusLogReader output;
+    return replay(call, &output, log);
+  }
+
+  bool read(const std::uint8_t op, const std::uint8_t index, std::uint8_t *const id,
+            const std::uint8_t id_num, const char **const log) {
+    BusLogRecord call(op);
+    call.put(index);
+    call.put(id_num);
+    call.putBytes(id, id_num);
+    BusLogReader output;
+    return replay(call, &output, log);
+  }
+
+  template < typename Output, typename Input >
+  Output convert(const std::uint8_t op, const std::uint8_t id, const Input input) {
+    BusLogRecord call(op);
+    call.put(id);
+    call.put(input);
+    return value< Output >(call);
+  }
+
+  // the recorded value returned by the call, or 0 if the call differs from the log
+  template < typename T > T value(const BusLogRecord &call) {
+    BusLogReader output;
+    T result(0);
+    if (replay(call, &output, NULL)) {
+      output.get(&result);
+    }
+    return result;
+  }
+
+  // consume the next recorded call if it is the same as the given call.
+  // returns the recorded result with the output, or the recorded log on failure.
+  bool replay(const BusLogRecord &call, BusLogReader *const output, const char **const log) {
+    const std::vector< BusLogFile::Entry > &entries(log_.getEntries());
+    // calls missing due to drops on recording cannot be replayed. just skip the gaps.
+    while (pos_ < entries.size() && entries[pos_].op == BUS_LOG_DROPPED) {
+      ++pos_;
+    }
+    if (pos_ >= entries.size()) {
+      return diverge("[ReplayBackend] Reached the end of the bus log", log);
+    }
+    if (!log_.hasSameInput(pos_, call)) {
+      return diverge("[ReplayBackend] The call differs from the bus log", log);
+    }
+    const BusLogFile::Entry &entry(entries[pos_]);
+    if (waits_) {
+      const std::chrono::steady_clock::time_point end(std::chrono::steady_clock::now() +
+                                                      std::chrono::nanoseconds(entry.duration));
+      while (std::chrono::steady_clock::now() < end) {
+      }
+    }
+    *output = log_.getOutput(pos_);
+    ++pos_;
+    if (!(entry.flags & BUS_LOG_SUCCEEDED)) {
+      // keep the recorded log until the next failure like DynamixelWorkbench does
+      output->getString(&last_log_);
+      if (log) {
+        *log = last_log_.c_str();
+      }
+      return false;
+    }
+    return true;
+  }
+
+  bool diverge(const char *const what, const char **const log) {
+    // report only the first divergence because following calls likely diverge too
+    if (!has_diverged_) {
+      ROS_ERROR_STREAM("ReplayBackend::replay(): " << what << " at the record " << pos_
+                                                   << " of '" << path_ << "'");
+      has_diverged_ = true;
+    }
+    if (log) {
+      *log = what;
+    }
+    return false;
+  }
+
+private:
+  const std::string path_;
+  const bool waits_;
+  BusLogFile log_;
+  // the next record to be replayed
+  std::size_t pos_;
+  bool has_diverged_;
+
+  // storage of results which are returned as pointers
+  std::map< std::uint8_t, std::string > model_names_;
+  std::map< std::pair< std::uint8_t, std::string >, Item > items_;
+  std::map< std::uint8_t, ModelInfo > model_infos_;
+  std::string last_log_;
+};
+
+typedef std::shared_ptr< ReplayBackend > ReplayBackendPtr;
+typedef std::shared_ptr< const ReplayBackend > ReplayBackendConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
@@ -0,0 +1,982 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_SIMULATED_BACKEND_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_SIMULATED_BACKEND_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <dynamixel_workbench_toolbox/dynamixel_workbench.h>
+#include <layered_hardware_dynamixel/bus_backend.hpp>
+#include <layered_hardware_dynamixel/bus_timing.hpp>
+
+namespace layered_hardware_dynamixel {
+
+// a simulated bus of XM430-W350 actuators on Protocol 2.0 to benchmark & test the layer
+// without hardware. every id responds unless it is made unresponsive.
+// the control table of each actuator is modeled byte by byte, including the lock of
+// the EEPROM area & the indirect address table while the torque is enabled.
+// present values follow goal values of the operating mode instantly.
+// each transaction takes the airtime of its packets at the baudrate, Return_Delay_Time of
+// each responding actuator & the latency timer of the USB serial converter, which is spent
+// by waiting on the calling thread if enabled and accumulated as the bus time anyway.
+// status packets of a split SyncRead stay in flight until finishSyncRead() waits for the rest.
+class SimulatedBackend : public BusBackend {
+public:
+  SimulatedBackend(const double latency_timer = 0.001, const bool waits = true)
+      : latency_timer_(latency_timer), waits_(waits), return_delay_time_(0),
+        firmware_version_(45), time_(0.), bus_time_(0.), n_transactions_(0) {}
+
+  virtual ~SimulatedBackend() {}
+
+  //
+  // configuration of the simulation. call before init().
+  //
+
+  // the initial Return_Delay_Time of actuators in units of 2 us
+  void setReturnDelayTime(const std::uint8_t value) { return_delay_time_ = value; }
+
+  // the Firmware_Version of actuators (45 or later supports Fast Sync Read)
+  void setFirmwareVersion(const std::uint8_t value) { firmware_version_ = value; }
+
+  // make the actuator stop (or restart) answering instructions to simulate a disconnection
+  void setResponsive(const std::uint8_t id, const bool is_responsive) {
+    deviceOf(id).is_responsive = is_responsive;
+  }
+
+  // total time the bus has been busy in seconds
+  double getBusTime() const { return bus_time_; }
+
+  std::uint64_t getTransactions() const { return n_transactions_; }
+
+  //
+  // the link & models
+  //
+
+  virtual bool init(const char *device_name, std::uint32_t baud_rate,
+                    const char **log = NULL) override {
+    if (baud_rate == 0) {
+      setLog(log, "[SimulatedBackend] Invalid baudrate");
+      return false;
+    }
+    timing_ = BusTiming(baud_rate, true, 0.);
+    return true;
+  }
+
+  virtual float getProtocolVersion() override { return 2.0; }
+
+  virtual const char *getModelName(std::uint8_t id, const char **log = NULL) override {
+    return findModel(id, log) ? "XM430-W350" : NULL;
+  }
+
+  virtual std::uint16_t getModelNumber(std::uint8_t id, const char **log = NULL) override {
+    return findModel(id, log) ? MODEL_NUMBER : 0;
+  }
+
+  virtual const ControlItem *getItemInfo(std::uint8_t id, const char *item_name,
+                                         const char **log = NULL) override {
+    if (!findModel(id, log)) {
+      return NULL;
+    }
+    std::size_t n_items;
+    const ControlItem *const items(controlTable(&n_items));
+    for (std::size_t i = 0; i < n_items; ++i) {
+      if (std::strcmp(items[i].item_name, item_name) == 0) {
+        return &items[i];
+      }
+    }
+    setLog(log, "[SimulatedBackend] Failed to find the control table item");
+    return NULL;
+  }
+
+  virtual const ModelInfo *getModelInfo(std::uint8_t id, const char **log = NULL) override {
+    return findModel(id, log) ? &modelInfo() : NULL;
+  }
+
+  //
+  // unit conversions in the same way as DynamixelWorkbench
+  //
+
+  virtual std::int32_t convertRadian2Value(std::uint8_t id, float radian) override {
+    const ModelInfo &info(modelInfo());
+    if (radian > 0) {
+      return radian * (info.value_of_max_radian_position - info.value_of_zero_radian_position) /
+                 info.max_radian +
+             info.value_of_zero_radian_position;
+    } else if (radian < 0) {
+      return radian * (info.value_of_min_radian_position - info.value_of_zero_radian_position) /
+                 info.min_radian +
+             info.value_of_zero_radian_position;
+    }
+    return info.value_of_zero_radian_position;
+  }
+
+  virtual float convertValue2Radian(std::uint8_t id, std::int32_t value) override {
+    const ModelInfo &info(modelInfo());
+    if (value > info.value_of_zero_radian_position) {
+      return (value - info.value_of_zero_radian_position) * info.max_radian /
+             (info.value_of_max_radian_position - info.value_of_zero_radian_position);
+    } else if (value < info.value_of_zero_radian_position) {
+      return (value - info.value_of_zero_radian_position) * info.min_radian /
+             (info.value_of_min_radian_position - info.value_of_zero_radian_position);
+    }
+    return 0.;
+  }
+
+  virtual std::int32_t convertVelocity2Value(std::uint8_t id, float velocity) override {
+    return velocity / (modelInfo().rpm * 2. * M_PI / 60.);
+  }
+
+  virtual float convertValue2Velocity(std::uint8_t id, std::int32_t value) override {
+    return value * modelInfo().rpm * 2. * M_PI / 60.;
+  }
+
+  virtual std::int16_t convertCurrent2Value(std::uint8_t id, float current) override {
+    return current / currentUnit();
+  }
+
+  virtual float convertValue2Current(std::uint8_t id, std::int16_t value) override {
+    return value * currentUnit();
+  }
+
+  //
+  // instructions to an actuator
+  //
+
+  virtual bool ping(std::uint8_t id, std::uint16_t *get_model_number,
+                    const char **log = NULL) override {
+    Device *const device(respond(id, timing_.instruction(0), log));
+    if (!device) {
+      return false;
+    }
+    spend(timing_.status(3) + returnDelayOf(*device) + latency_timer_);
+    device->is_known = true;
+    if (get_model_number) {
+      *get_model_number = MODEL_NUMBER;
+    }
+    return true;
+  }
+
+  virtual bool ping(std::uint8_t id, const char **log = NULL) override {
+    return ping(id, NULL, log);
+  }
+
+  // one broadcast ping answered by every responsive id up to range.
+  // DynamixelSDK waits for status packets of all 252 ids plus 3 ms per id and 16 ms,
+  // regardless of the range & the answers.
+  virtual bool scan(std::uint8_t *get_id, std::uint8_t *get_the_number_of_id,
+                    std::uint8_t range = 253, const char **log = NULL) override {
+    transact(timing_.instruction(0) + timing_.bytes(14 * MAX_ID) + 0.003 * MAX_ID + 0.016);
+    *get_the_number_of_id = 0;
+    for (int id = 1; id <= range && id <= MAX_ID; ++id) {
+      Device &device(deviceOf(id));
+      if (device.is_responsive) {
+        device.is_known = true;
+        get_id[(*get_the_number_of_id)++] = id;
+      }
+    }
+    if (*get_the_number_of_id == 0) {
+      setLog(log, "[SimulatedBackend] Failed to find any actuator");
+      return false;
+    }
+    return true;
+  }
+
+  virtual bool reboot(std::uint8_t id, const char **log = NULL) override {
+    Device *const device(respond(id, timing_.instruction(0), log));
+    if (!device) {
+      return false;
+    }
+    spend(timing_.status(0) + returnDelayOf(*device) + latency_timer_);
+    device->table[TORQUE_ENABLE] = 0;
+    device->table[HARDWARE_ERROR_STATUS] = 0;
+    return true;
+  }
+
+  virtual bool clearMultiTurn(std::uint8_t id, const char **log = NULL) override {
+    Device *const device(respond(id, timing_.instruction(0), log));
+    if (!device) {
+      return false;
+    }
+    spend(timing_.status(0) + returnDelayOf(*device) + latency_timer_);
+    // shift the goal together so that the position mode keeps the present position
+    const std::int32_t offset(4096 *
+                              static_cast< std::int32_t >(std::floor(device->position / 4096.)));
+    device->position -= offset;
+    setValue(device, GOAL_POSITION, 4,
+             static_cast< std::int32_t >(getValue(*device, GOAL_POSITION, 4)) - offset);
+    step(device, 0.);
+    return true;
+  }
+
+  virtual bool readRegister(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                            std::uint32_t *data, const char **log = NULL) override {
+    Device *const device(respond(id, timing_.instruction(4), log));
+    if (!device) {
+      return false;
+    }
+    spend(timing_.status(length) + returnDelayOf(*device) + latency_timer_);
+    if (!isInTable(address, length, log)) {
+      return false;
+    }
+    *data = getValue(*device, address, length);
+    return true;
+  }
+
+  virtual bool readRegister(std::uint8_t id, const char *item_name, std::int32_t *data,
+                            const char **log = NULL) override {
+    return itemRead(id, item_name, data, log);
+  }
+
+  virtual bool writeRegister(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                             std::uint8_t *data, const char **log = NULL) override {
+    Device *const device(respond(id, timing_.instruction(2 + length), log));
+    if (!device) {
+      return false;
+    }
+    spend(timing_.status(0) + returnDelayOf(*device) + latency_timer_);
+    return write(device, address, length, data, log);
+  }
+
+  virtual bool itemRead(std::uint8_t id, const char *item_name, std::int32_t *data,
+                        const char **log = NULL) override {
+    const ControlItem *const item(getItemInfo(id, item_name, log));
+    std::uint32_t raw_value;
+    if (!item || !readRegister(id, item->address, item->data_length, &raw_value, log)) {
+      return false;
+    }
+    // restore the sign as DynamixelWorkbench::itemRead()
+    switch (item->data_length) {
+    case 1:
+      *data = static_cast< std::uint8_t >(raw_value);
+      break;
+    case 2:
+      *data = static_cast< std::int16_t >(raw_value);
+      break;
+    default:
+      *data = static_cast< std::int32_t >(raw_value);
+      break;
+    }
+    return true;
+  }
+
+  virtual bool itemWrite(std::uint8_t id, const char *item_name, std::int32_t data,
+                         const char **log = NULL) override {
+    const ControlItem *const item(getItemInfo(id, item_name, log));
+    if (!item) {
+      return false;
+    }
+    std::uint8_t bytes[4];
+    toBytes(data, bytes);
+    return writeRegister(id, item->address, item->data_length, bytes, log);
+  }
+
+  virtual bool torqueOn(std::uint8_t id, const char **log = NULL) override {
+    return itemWrite(id, "Torque_Enable", 1, log);
+  }
+
+  virtual bool torqueOff(std::uint8_t id, const char **log = NULL) override {
+    return itemWrite(id, "Torque_Enable", 0, log);
+  }
+
+  virtual bool setCurrentControlMode(std::uint8_t id, const char **log = NULL) override {
+    return itemWrite(id, "Operating_Mode", 0, log);
+  }
+
+  virtual bool setVelocityControlMode(std::uint8_t id, const char **log = NULL) override {
+    return itemWrite(id, "Operating_Mode", 1, log);
+  }
+
+  virtual bool setPositionControlMode(std::uint8_t id, const char **log = NULL) override {
+    return itemWrite(id, "Operating_Mode", 3, log);
+  }
+
+  virtual bool setExtendedPositionControlMode(std::uint8_t id, const char **log = NULL) override {
+    return itemWrite(id, "Operating_Mode", 4, log);
+  }
+
+  virtual bool setCurrentBasedPositionControlMode(std::uint8_t id,
+                                                  const char **log = NULL) override {
+    return itemWrite(id, "Operating_Mode", 5, log);
+  }
+
+  virtual bool setPWMControlMode(std::uint8_t id, const char **log = NULL) override {
+    return itemWrite(id, "Operating_Mode", 16, log);
+  }
+
+  //
+  // group instructions
+  //
+
+  virtual std::uint8_t getTheNumberOfSyncWriteHandler() override {
+    return sync_write_handlers_.size();
+  }
+
+  virtual bool addSyncWriteHandler(std::uint16_t address, std::uint16_t length,
+                                   const char **log = NULL) override {
+    if (!isInTable(address, length, log)) {
+      return false;
+    }
+    sync_write_handlers_.push_back(Block(address, length));
+    return true;
+  }
+
+  virtual bool syncWrite(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                         std::int32_t *data, std::uint8_t data_num_for_each_id,
+                         const char **log = NULL) override {
+    if (index >= sync_write_handlers_.size()) {
+      setLog(log, "[SimulatedBackend] Invalid sync write handler");
+      return false;
+    }
+    const Block &handler(sync_write_handlers_[index]);
+    // no status packets are returned
+    transact(timing_.syncWrite(id_num, handler.length));
+    bool result(true);
+    for (std::uint8_t i = 0; i < id_num; ++i) {
+      // values of an actuator are packed in 4 bytes each, then the handler's length is written
+      std::uint8_t bytes[4 * 256];
+      for (std::uint8_t j = 0; j < data_num_for_each_id; ++j) {
+        toBytes(data[i * data_num_for_each_id + j], &bytes[4 * j]);
+      }
+      Device *const device(findDevice(id[i]));
+      if (device && !write(device, handler.address, handler.length, bytes, log)) {
+        result = false;
+      }
+    }
+    return result;
+  }
+
+  virtual std::uint8_t getTheNumberOfSyncReadHandler() override {
+    return sync_read_handlers_.size();
+  }
+
+  virtual bool addSyncReadHandler(std::uint16_t address, std::uint16_t length,
+                                  const char **log = NULL) override {
+    if (!isInTable(address, length, log)) {
+      return false;
+    }
+    sync_read_handlers_.push_back(SyncReadHandler(address, length));
+    return true;
+  }
+
+  virtual bool syncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                        const char **log = NULL) override {
+    return groupSyncRead(index, id, id_num, false, false, log);
+  }
+
+  virtual bool supportsFastSyncRead() override { return true; }
+
+  virtual bool fastSyncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                            const char **log = NULL) override {
+    return groupSyncRead(index, id, id_num, true, false, log);
+  }
+
+  virtual bool supportsSplitSyncRead() override { return true; }
+
+  virtual bool beginSyncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                             const char **log = NULL) override {
+    return groupSyncRead(index, id, id_num, false, true, log);
+  }
+
+  virtual bool beginFastSyncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                                 const char **log = NULL) override {
+    return groupSyncRead(index, id, id_num, true, true, log);
+  }
+
+  // the bus stays busy while status packets arrive,
+  // but the caller waits only for the rest of them after its own work
+  virtual bool finishSyncRead(std::uint8_t index, const char **log = NULL) override {
+    if (!pending_read_.is_active || pending_read_.index != index) {
+      setLog(log, "[SimulatedBackend] No split SyncRead is in flight for the handler");
+      return false;
+    }
+    pending_read_.is_active = false;
+    advance(pending_read_.status_time);
+    if (waits_) {
+      spinUntil(pending_read_.end);
+    }
+    if (!pending_read_.is_answered) {
+      setLog(log, "[TxRxResult] There is no status packet!");
+      return false;
+    }
+    return true;
+  }
+
+  virtual bool getSyncReadData(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                               std::uint16_t address, std::uint16_t length, std::int32_t *data,
+                               const char **log = NULL) override {
+    if (index >= sync_read_handlers_.size()) {
+      setLog(log, "[SimulatedBackend] Invalid sync read handler");
+      return false;
+    }
+    const SyncReadHandler &handler(sync_read_handlers_[index]);
+    for (std::uint8_t i = 0; i < id_num; ++i) {
+      const std::map< std::uint8_t, std::vector< std::uint8_t > >::const_iterator received(
+          handler.received.find(id[i]));
+      if (received == handler.received.end() ||
+          !extract(handler.block, received->second, address, length, &data[i], log)) {
+        setLog(log, "[SimulatedBackend] No sync read data of the actuator");
+        return false;
+      }
+    }
+    return true;
+  }
+
+  virtual bool initBulkRead(const char **log = NULL) override {
+    bulk_read_params_.clear();
+    return true;
+  }
+
+  virtual bool addBulkReadParam(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                                const char **log = NULL) override {
+    if (!isInTable(address, length, log)) {
+      return false;
+    }
+    for (const BulkReadParam &param : bulk_read_params_) {
+      if (param.id == id) {
+        setLog(log, "[SimulatedBackend] The actuator already has a bulk read param");
+        return false;
+      }
+    }
+    bulk_read_params_.push_back(BulkReadParam(id, address, length));
+    return true;
+  }
+
+  virtual bool bulkRead(const char **log = NULL) override {
+    if (bulk_read_params_.empty()) {
+      setLog(log, "[SimulatedBackend] No bulk read params");
+      return false;
+    }
+    for (BulkReadParam &param : bulk_read_params_) {
+      param.is_received = false;
+    }
+    double status_time(latency_timer_);
+    bool result(true);
+    for (BulkReadParam &param : bulk_read_params_) {
+      Device *const device(findDevice(param.id));
+      if (!device || !device->is_responsive) {
+        result = false;
+        break;
+      }
+      readBytes(*device, param.block.address, param.block.length, &param.data);
+      param.is_received = true;
+      status_time += timing_.status(param.block.length) + returnDelayOf(*device);
+    }
+    const double instruction_time(timing_.instruction(5 * bulk_read_params_.size()));
+    if (!result) {
+      transact(instruction_time + status_time + timeout());
+      setLog(log, "[TxRxResult] There is no status packet!");
+      return false;
+    }
+    transact(instruction_time + status_time);
+    return true;
+  }
+
+  virtual bool getBulkReadData(std::uint8_t *id, std::uint8_t id_num, std::uint16_t *address,
+                               std::uint16_t *length, std::int32_t *data,
+                               const char **log = NULL) override {
+    for (std::uint8_t i = 0; i < id_num; ++i) {
+      const BulkReadParam *found(NULL);
+      for (const BulkReadParam &param : bulk_read_params_) {
+        if (param.id == id[i] && param.is_received) {
+          found = &param;
+          break;
+        }
+      }
+      if (!found || !extract(found->block, found->data, address[i], length[i], &data[i], log)) {
+        setLog(log, "[SimulatedBackend] No bulk read data of the actuator");
+        return false;
+      }
+    }
+    return true;
+  }
+
+  virtual bool clearBulkReadParam() override {
+    bulk_read_params_.clear();
+    return true;
+  }
+
+  virtual bool initBulkWrite(const char **log = NULL) override {
+    bulk_write_params_.clear();
+    return true;
+  }
+
+  virtual bool addBulkWriteParam(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                                 std::int32_t data, const char **log = NULL) override {
+    if (!isInTable(address, length, log) || length > 4) {
+      setLog(log, "[SimulatedBackend] Invalid bulk write param");
+      return false;
+    }
+    for (const BulkWriteParam &param : bulk_write_params_) {
+      if (param.id == id) {
+        setLog(log, "[SimulatedBackend] The actuator already has a bulk write param");
+        return false;
+      }
+    }
+    bulk_write_params_.push_back(BulkWriteParam(id, address, length, data));
+    return true;
+  }
+
+  virtual bool bulkWrite(const char **log = NULL) override {
+    std::size_t n_params(0);
+    for (const BulkWriteParam &param : bulk_write_params_) {
+      n_params += 5 + param.block.length;
+    }
+    // no status packets are returned
+    transact(timing_.instruction(n_params));
+    bool result(true);
+    for (const BulkWriteParam &param : bulk_write_params_) {
+      std::uint8_t bytes[4];
+      toBytes(param.value, bytes);
+      Device *const device(findDevice(param.id));
+      if (device && !write(device, param.block.address, param.block.length, bytes, log)) {
+        result = false;
+      }
+    }
+    bulk_write_params_.clear();
+    return result;
+  }
+
+private:
+  // addresses of the control table used by the simulation
+  enum Address {
+    MODEL_NUMBER_ADDRESS = 0,
+    FIRMWARE_VERSION = 6,
+    ID = 7,
+    BAUD_RATE = 8,
+    RETURN_DELAY_TIME = 9,
+    OPERATING_MODE = 11,
+    CURRENT_LIMIT = 38,
+    VELOCITY_LIMIT = 44,
+    MAX_POSITION_LIMIT = 48,
+    MIN_POSITION_LIMIT = 52,
+    TORQUE_ENABLE = 64,
+    STATUS_RETURN_LEVEL = 68,
+    HARDWARE_ERROR_STATUS = 70,
+    GOAL_CURRENT = 102,
+    GOAL_VELOCITY = 104,
+    GOAL_POSITION = 116,
+    REALTIME_TICK = 120,
+    PRESENT_CURRENT = 126,
+    PRESENT_VELOCITY = 128,
+    PRESENT_POSITION = 132,
+    PRESENT_INPUT_VOLTAGE = 144,
+    PRESENT_TEMPERATURE = 146,
+    INDIRECT_ADDRESS_1 = 168,
+    INDIRECT_DATA_1 = 224,
+    TABLE_SIZE = 252
+  };
+
+  static const std::uint16_t MODEL_NUMBER = 1020;
+  // the max id of actuators (0xFC)
+  static const int MAX_ID = 252;
+
+  struct Device {
+    Device() : table(TABLE_SIZE, 0), position(0.), is_responsive(true), is_known(false) {}
+
+    std::vector< std::uint8_t > table;
+    // present position in raw units integrated on the velocity mode
+    double position;
+    bool is_responsive;
+    // true once pinged, so that the model is known as in DynamixelWorkbench
+    bool is_known;
+  };
+
+  struct Block {
+    Block(const std::uint16_t _address = 0, const std::uint16_t _length = 0)
+        : address(_address), length(_length) {}
+
+    std::uint16_t address, length;
+  };
+
+  struct SyncReadHandler {
+    SyncReadHandler(const std::uint16_t address, const std::uint16_t length)
+        : block(address, length) {}
+
+    Block block;
+    std::map< std::uint8_t, std::vector< std::uint8_t > > received;
+  };
+
+  // status packets of the split SyncRead which the caller has not received yet
+  struct PendingRead {
+    PendingRead() : is_active(false), index(0), is_answered(false), status_time(0.) {}
+
+    bool is_active;
+    std::uint8_t index;
+    bool is_answered;
+    double status_time;
+    // the wall time when the last packet arrives
+    std::chrono::steady_clock::time_point end;
+  };
+
+  // the buffer is sized on registration like GroupBulkRead so that reads allocate nothing
+  struct BulkReadParam {
+    BulkReadParam(const std::uint8_t _id, const std::uint16_t address, const std::uint16_t length)
+        : id(_id), block(address, length), data(length), is_received(false) {}
+
+    std::uint8_t id;
+    Block block;
+    std::vector< std::uint8_t > data;
+    bool is_received;
+  };
+
+  struct BulkWriteParam {
+    BulkWriteParam(const std::uint8_t _id, const std::uint16_t address, const std::uint16_t length,
+                   const std::int32_t _value)
+        : id(_id), block(address, length), value(_value) {}
+
+    std::uint8_t id;
+    Block block;
+    std::int32_t value;
+  };
+
+  // items of XM430-W350 up to the first indirect data region
+  static const ControlItem *controlTable(std::size_t *const n_items) {
+    static const ControlItem items[] = {
+        {0, "Model_Number", 12, 2},         {2, "Model_Information", 17, 4},
+        {6, "Firmware_Version", 16, 1},     {7, "ID", 2, 1},
+        {8, "Baud_Rate", 9, 1},             {9, "Return_Delay_Time", 17, 1},
+        {10, "Drive_Mode", 10, 1},          {11, "Operating_Mode", 14, 1},
+        {12, "Secondary_ID", 12, 1},        {13, "Protocol_Type", 13, 1},
+        {20, "Homing_Offset", 13, 4},       {24, "Moving_Threshold", 16, 4},
+        {31, "Temperature_Limit", 17, 1},   {32, "Max_Voltage_Limit", 17, 2},
+        {34, "Min_Voltage_Limit", 17, 2},   {36, "PWM_Limit", 9, 2},
+        {38, "Current_Limit", 13, 2},       {44, "Velocity_Limit", 14, 4},
+        {48, "Max_Position_Limit", 18, 4},  {52, "Min_Position_Limit", 18, 4},
+        {63, "Shutdown", 8, 1},             {64, "Torque_Enable", 13, 1},
+        {65, "LED", 3, 1},                  {68, "Status_Return_Level", 19, 1},
+        {69, "Registered_Instruction", 22, 1}, {70, "Hardware_Error_Status", 21, 1},
+        {76, "Velocity_I_Gain", 15, 2},     {78, "Velocity_P_Gain", 15, 2},
+        {80, "Position_D_Gain", 15, 2},     {82, "Position_I_Gain", 15, 2},
+        {84, "Position_P_Gain", 15, 2},     {88, "Feedforward_2nd_Gain", 20, 2},
+        {90, "Feedforward_1st_Gain", 20, 2}, {98, "Bus_Watchdog", 12, 1},
+        {100, "Goal_PWM", 8, 2},            {102, "Goal_Current", 12, 2},
+        {104, "Goal_Velocity", 13, 4},      {108, "Profile_Acceleration", 20, 4},
+        {112, "Profile_Velocity", 16, 4},   {116, "Goal_Position", 13, 4},
+        {120, "Realtime_Tick", 13, 2},      {122, "Moving", 6, 1},
+        {123, "Moving_Status", 13, 1},      {124, "Present_PWM", 11, 2},
+        {126, "Present_Current", 15, 2},    {128, "Present_Velocity", 16, 4},
+        {132, "Present_Position", 16, 4},   {136, "Velocity_Trajectory", 19, 4},
+        {140, "Position_Trajectory", 19, 4}, {144, "Present_Input_Voltage", 21, 2},
+        {146, "Present_Temperature", 19, 1}, {168, "Indirect_Address_1", 18, 2},
+        {224, "Indirect_Data_1", 15, 1}};
+    *n_items = sizeof(items) / sizeof(items[0]);
+    return items;
+  }
+
+  static const ModelInfo &modelInfo() {
+    static const ModelInfo info = {0.229f, 0, 2048, 4095, -3.14159265f, 3.14159265f};
+    return info;
+  }
+
+  // mA per unit of current items
+  static double currentUnit() { return 2.69; }
+
+  static void setLog(const char **const log, const char *const what) {
+    if (log) {
+      *log = what;
+    }
+  }
+
+  static void toBytes(const std::int32_t value, std::uint8_t *const bytes) {
+    for (int i = 0; i < 4; ++i) {
+      bytes[i] = static_cast< std::uint8_t >((value >> (8 * i)) & 0xFF);
+    }
+  }
+
+  static bool isInTable(const std::uint16_t address, const std::uint16_t length,
+                        const char **const log) {
+    if (length == 0 || address + length > TABLE_SIZE) {
+      setLog(log, "[SimulatedBackend] The block is out of the control table");
+      return false;
+    }
+    return true;
+  }
+
+  // the value of up to 4 bytes in the received block
+  static bool extract(const Block &block, const std::vector< std::uint8_t > &bytes,
+                      const std::uint16_t address, const std::uint16_t length,
+                      std::int32_t *const value, const char **const log) {
+    if (address < block.address || address + length > block.address + block.length ||
+        length > 4) {
+      setLog(log, "[SimulatedBackend] The item is out of the received block");
+      return false;
+    }
+    std::uint32_t raw_value(0);
+    for (std::uint16_t i = 0; i < length; ++i) {
+      raw_value |= static_cast< std::uint32_t >(bytes[address - block.address + i]) << (8 * i);
+    }
+    *value = static_cast< std::int32_t >(raw_value);
+    return true;
+  }
+
+  //
+  // actuators
+  //
+
+  Device &deviceOf(const std::uint8_t id) {
+    const std::map< std::uint8_t, Device >::iterator it(devices_.find(id));
+    if (it != devices_.end()) {
+      return it->second;
+    }
+    Device &device(devices_[id]);
+    std::vector< std::uint8_t > &table(device.table);
+    setValue(&device, MODEL_NUMBER_ADDRESS, 2, MODEL_NUMBER);
+    table[FIRMWARE_VERSION] = firmware_version_;
+    table[ID] = id;
+    table[BAUD_RATE] = 3;
+    table[RETURN_DELAY_TIME] = return_delay_time_;
+    table[OPERATING_MODE] = 3;
+    setValue(&device, CURRENT_LIMIT, 2, 1193);
+    setValue(&device, VELOCITY_LIMIT, 4, 200);
+    setValue(&device, MAX_POSITION_LIMIT, 4, 4095);
+    setValue(&device, MIN_POSITION_LIMIT, 4, 0);
+    table[STATUS_RETURN_LEVEL] = 2;
+    device.position = 2048.;
+    setValue(&device, GOAL_POSITION, 4, 2048);
+    setValue(&device, PRESENT_POSITION, 4, 2048);
+    setValue(&device, PRESENT_INPUT_VOLTAGE, 2, 120);
+    table[PRESENT_TEMPERATURE] = 30;
+    // each indirect address points its own data by default
+    for (std::uint16_t i = 0; INDIRECT_ADDRESS_1 + 2 * i < INDIRECT_DATA_1; ++i) {
+      setValue(&device, INDIRECT_ADDRESS_1 + 2 * i, 2, INDIRECT_DATA_1 + i);
+    }
+    return device;
+  }
+
+  Device *findDevice(const std::uint8_t id) {
+    const std::map< std::uint8_t, Device >::iterator it(devices_.find(id));
+    return it != devices_.end() && it->second.is_responsive ? &it->second : NULL;
+  }
+
+  // the model is known only for actuators once pinged
+  bool findModel(const std::uint8_t id, const char **const log) {
+    const std::map< std::uint8_t, Device >::const_iterator it(devices_.find(id));
+    if (it == devices_.end() || !it->second.is_known) {
+      setLog(log, "[SimulatedBackend] Unknown model of the actuator. Ping it first");
+      return false;
+    }
+    return true;
+  }
+
+  // send an instruction to the actuator and find it if it responds
+  Device *respond(const std::uint8_t id, const double instruction_time, const char **const log) {
+    Device &device(deviceOf(id));
+    if (!device.is_responsive) {
+      transact(instruction_time + timeout());
+      setLog(log, "[TxRxResult] There is no status packet!");
+      return NULL;
+    }
+    transact(instruction_time);
+    return &device;
+  }
+
+  double returnDelayOf(const Device &device) const {
+    return device.table[RETURN_DELAY_TIME] * 2e-6;
+  }
+
+  // the packet timeout of DynamixelSDK
+  double timeout() const { return 2. * latency_timer_ + 0.002; }
+
+  // the split one spends only the instruction time here and leaves status packets in flight
+  bool groupSyncRead(const std::uint8_t index, const std::uint8_t *const id,
+                     const std::uint8_t id_num, const bool is_fast, const bool is_split,
+                     const char **const log) {
+    if (index >= sync_read_handlers_.size()) {
+      setLog(log, "[SimulatedBackend] Invalid sync read handler");
+      return false;
+    }
+    if (pending_read_.is_active) {
+      setLog(log, "[SimulatedBackend] A split SyncRead is still in flight");
+      return false;
+    }
+    SyncReadHandler &handler(sync_read_handlers_[index]);
+    const std::uint16_t length(handler.block.length);
+    for (std::map< std::uint8_t, std::vector< std::uint8_t > >::value_type &received :
+         handler.received) {
+      received.second.clear();
+    }
+    // SyncRead returns a status packet from each actuator.
+    // Fast Sync Read returns one packet with id, error & crc for each actuator.
+    double status_time(latency_timer_ + (is_fast ? timing_.status(0) : 0.));
+    bool result(true);
+    for (std::uint8_t i = 0; i < id_num; ++i) {
+      Device *const device(findDevice(id[i]));
+      if (!device) {
+        result = false;
+        break;
+      }
+      readBytes(*device, handler.block.address, length, &handler.received[id[i]]);
+      status_time += is_fast ? timing_.bytes(4 + length) + (i == 0 ? returnDelayOf(*device) : 0.)
+                             : timing_.status(length) + returnDelayOf(*device);
+    }
+    const double instruction_time(timing_.instruction(4 + id_num));
+    if (is_split) {
+      transact(instruction_time);
+      pending_read_.is_active = true;
+      pending_read_.index = index;
+      pending_read_.is_answered = result;
+      pending_read_.status_time = result ? status_time : status_time + timeout();
+      pending_read_.end = std::chrono::steady_clock::now() + toDuration(pending_read_.status_time);
+      return true;
+    }
+    if (!result) {
+      transact(instruction_time + status_time + timeout());
+      setLog(log, "[TxRxResult] There is no status packet!");
+      return false;
+    }
+    transact(instruction_time + status_time);
+    return true;
+  }
+
+  //
+  // the control table
+  //
+
+  // a byte at the address, which is redirected by the indirect address table if needed
+  std::uint16_t resolve(const Device &device, const std::uint16_t address) const {
+    if (address < INDIRECT_DATA_1 || address >= TABLE_SIZE) {
+      return address;
+    }
+    const std::uint16_t entry(INDIRECT_ADDRESS_1 + 2 * (address - INDIRECT_DATA_1));
+    const std::uint16_t target(device.table[entry] | (device.table[entry + 1] << 8));
+    return target < INDIRECT_ADDRESS_1 ? target : address;
+  }
+
+  void readBytes(const Device &device, const std::uint16_t address, const std::uint16_t length,
+                 std::vector< std::uint8_t > *const bytes) const {
+    bytes->resize(length);
+    for (std::uint16_t i = 0; i < length; ++i) {
+      (*bytes)[i] = device.table[resolve(device, address + i)];
+    }
+  }
+
+  std::uint32_t getValue(const Device &device, const std::uint16_t address,
+                         const std::uint16_t length) const {
+    std::uint32_t value(0);
+    for (std::uint16_t i = 0; i < length && i < 4; ++i) {
+      value |= static_cast< std::uint32_t >(device.table[resolve(device, address + i)]) << (8 * i);
+    }
+    return value;
+  }
+
+  static void setValue(Device *const device, const std::uint16_t address,
+                       const std::uint16_t length, const std::int32_t value) {
+    for (std::uint16_t i = 0; i < length; ++i) {
+      device->table[address + i] = static_cast< std::uint8_t >((value >> (8 * i)) & 0xFF);
+    }
+  }
+
+  // write bytes as the actuator does. the EEPROM area & the indirect address table are
+  // locked while the torque is enabled.
+  bool write(Device *const device, const std::uint16_t address, const std::uint16_t length,
+             const std::uint8_t *const bytes, const char **const log) {
+    if (!isInTable(address, length, log)) {
+      return false;
+    }
+    for (std::uint16_t i = 0; i < length; ++i) {
+      const std::uint16_t target(resolve(*device, address + i));
+      if (device->table[TORQUE_ENABLE] != 0 &&
+          (target < TORQUE_ENABLE || (target >= INDIRECT_ADDRESS_1 && target < INDIRECT_DATA_1))) {
+        setLog(log, "[RxPacketError] Writing or Reading is not available to target address!");
+        return false;
+      }
+    }
+    for (std::uint16_t i = 0; i < length; ++i) {
+      device->table[resolve(*device, address + i)] = bytes[i];
+    }
+    step(device, 0.);
+    return true;
+  }
+
+  //
+  // time
+  //
+
+  // let the bus be busy for the duration
+  void transact(const double duration) {
+    ++n_transactions_;
+    spend(duration);
+  }
+
+  void spend(const double duration) {
+    const std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+    advance(duration);
+    if (waits_) {
+      spinUntil(start + toDuration(duration));
+    }
+  }
+
+  // advance the simulated time without waiting
+  void advance(const double duration) {
+    time_ += duration;
+    bus_time_ += duration;
+    for (std::map< std::uint8_t, Device >::value_type &device : devices_) {
+      step(&device.second, duration);
+    }
+  }
+
+  // spin because sleeping is too coarse for the airtime of packets
+  static void spinUntil(const std::chrono::steady_clock::time_point &end) {
+    while (std::chrono::steady_clock::now() < end) {
+    }
+  }
+
+  static std::chrono::steady_clock::duration toDuration(const double seconds) {
+    return std::chrono::duration_cast< std::chrono::steady_clock::duration >(
+        std::chrono::duration< double >(seconds));
+  }
+
+  // update present values by the operating mode
+  void step(Device *const device, const double dt) const {
+    std::int32_t current(0), velocity(0);
+    if (device->table[TORQUE_ENABLE] != 0) {
+      switch (device->table[OPERATING_MODE]) {
+      case 0: // current
+        current = static_cast< std::int16_t >(getValue(*device, GOAL_CURRENT, 2));
+        break;
+      case 1: // velocity
+        velocity = static_cast< std::int32_t >(getValue(*device, GOAL_VELOCITY, 4));
+        device->position += velocity * modelInfo().rpm / 60. * 4096. * dt;
+        break;
+      case 3: // position
+      case 4: // extended position
+      case 5: // current-based position
+        device->position = static_cast< std::int32_t >(getValue(*device, GOAL_POSITION, 4));
+        break;
+      default:
+        break;
+      }
+    }
+    setValue(device, PRESENT_CURRENT, 2, current);
+    setValue(device, PRESENT_VELOCITY, 4, velocity);
+    setValue(device, PRESENT_POSITION, 4, std::lround(device->position));
+    setValue(device, REALTIME_TICK, 2, static_cast< std::int64_t >(time_ * 1000.) % 32768);
+  }
+
+private:
+  const double latency_timer_;
+  const bool waits_;
+  std::uint8_t return_delay_time_, firmware_version_;
+  BusTiming timing_;
+  std::map< std::uint8_t, Device > devices_;
+  std::vector< Block > sync_write_handlers_;
+  std::vector< SyncReadHandler > sync_read_handlers_;
+  std::vector< BulkReadParam > bulk_read_params_;
+  PendingRead pending_read_;
+  std::vector< BulkWriteParam > bulk_write_params_;
+  // simulated time & the time the bus was busy in seconds
+  double time_, bus_time_;
+  std::uint64_t n_transactions_;
+};
+
+typedef std::shared_ptr< SimulatedBackend > SimulatedBackendPtr;
+typedef std::shared_ptr< const SimulatedBackend > SimulatedBackendConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
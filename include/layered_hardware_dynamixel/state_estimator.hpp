@@ -0,0 +1,63 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_STATE_ESTIMATOR_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_STATE_ESTIMATOR_HPP
+
+#include <memory>
+
+#include <layered_hardware_dynamixel/dynamixel_actuator_data.hpp>
+#include <ros/duration.h>
+
+namespace layered_hardware_dynamixel {
+
+// keeps the position state smooth over cycles where it is not read
+// (failed reads, or reads deferred by the bus scheduler).
+// the position is extrapolated from the last velocity while readings are missing,
+// and fused with the next reading by the correction gain so that controllers see no step.
+class StateEstimator {
+public:
+  StateEstimator(const int max_stale_cycles = 10, const double correction_gain = 1.)
+      : max_stale_cycles_(max_stale_cycles), correction_gain_(correction_gain),
+        has_estimate_(false), pos_(0.), vel_(0.) {}
+
+  virtual ~StateEstimator() {}
+
+  // forget the estimate, e.g. on switching operating modes
+  void reset() { has_estimate_ = false; }
+
+  // update the position state by fresh readings in the present cycle if any
+  void update(DynamixelActuatorData *const data, const ros::Duration &period) {
+    if (!has_estimate_) {
+      if (!data->has_fresh_pos) {
+        return;
+      }
+      pos_ = data->pos;
+      vel_ = data->has_fresh_vel ? data->vel : 0.;
+      has_estimate_ = true;
+      return;
+    }
+
+    // extrapolate without readings up to the max number of cycles, then hold
+    const double predicted_pos((data->has_fresh_pos || data->stale_cycles < max_stale_cycles_)
+                                   ? pos_ + vel_ * period.toSec()
+                                   : pos_);
+    pos_ = data->has_fresh_pos ? predicted_pos + correction_gain_ * (data->pos - predicted_pos)
+                               : predicted_pos;
+    if (data->has_fresh_vel) {
+      vel_ = data->vel;
+    }
+    data->pos = pos_;
+  }
+
+private:
+  const int max_stale_cycles_;
+  // 1 to take readings as they are, or less to spread corrections over cycles
+  const double correction_gain_;
+
+  bool has_estimate_;
+  double pos_, vel_;
+};
+
+typedef std::shared_ptr< StateEstimator > StateEstimatorPtr;
+typedef std::shared_ptr< const StateEstimator > StateEstimatorConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
@@ -0,0 +1,295 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_STATE_EXPORTER_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_STATE_EXPORTER_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <ros/console.h>
+
+namespace layered_hardware_dynamixel {
+
+// the layout of the shared memory segment exported by StateExporter.
+// the segment starts with the header, followed by the names of actuators & additional states
+// (NAME_LENGTH bytes each, null-terminated) and n_slots slots of slot_size bytes.
+// each slot is a SharedStateSlot followed by
+//   double pos[n_actuators], vel[n_actuators], eff[n_actuators],
+//   std::int32_t health_status[n_actuators], stale_cycles[n_actuators],
+//   std::int32_t additional_states[n_additional_states]
+// where positions are in rad (or m), velocities in rad/s and efforts in N*m,
+// and additional states are raw values in the order of actuators & their params.
+struct SharedStateHeader {
+  static const std::uint32_t MAGIC = 0x4c484458; // "LHDX"
+  static const std::uint32_t VERSION = 1;
+  static const std::size_t NAME_LENGTH = 64;
+
+  std::uint32_t magic, version;
+  std::uint32_t n_actuators, n_additional_states, n_slots;
+  std::uint32_t slot_size;
+  std::uint64_t names_offset, slots_offset;
+  // the number of cycles published. the latest one is in the slot (n_published - 1) % n_slots
+  std::atomic< std::uint64_t > n_published;
+};
+
+// the head of a slot. seq is odd while the slot is being written, and 2 * (cycle + 1)
+// once the cycle is complete, so that readers can tell a torn or overwritten copy.
+struct SharedStateSlot {
+  std::atomic< std::uint64_t > seq;
+  std::uint64_t cycle;
+  // the time & period given to the read cycle, and how long reading the buses took
+  std::int64_t stamp_ns, period_ns, read_ns;
+};
+
+// processes share the segment, so the atomics must work without locks
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "SharedStateHeader: 64-bit atomics must be lock-free to be shared");
+
+// publishes states of all actuators in every cycle into a ring of slots in POSIX shared memory,
+// so that co-located processes (loggers, safety monitors) read them at the cycle rate
+// without ROS serialization or transport. each slot is guarded by a sequence lock,
+// so the writer never waits for readers and readers retry a copy torn by the writer.
+// the writer allocates nothing after init and is safe to run on the bus thread.
+class StateExporter {
+public:
+  StateExporter() : fd_(-1), size_(0), base_(NULL), header_(NULL), n_actuators_(0) {}
+
+  virtual ~StateExporter() {
+    if (base_) {
+      munmap(base_, size_);
+    }
+    if (fd_ >= 0) {
+      close(fd_);
+      // readers keep their mappings, and find a new segment after the layer restarts
+      shm_unlink(name_.c_str());
+    }
+  }
+
+  // create the segment named like "/layered_hardware_dynamixel" for the actuators
+  // & additional states with the given names
+  bool init(const std::string &name, const std::size_t n_slots,
+            const std::vector< std::string > &actuator_names,
+            const std::vector< std::string > &state_names) {
+    name_ = name;
+    n_actuators_ = actuator_names.size();
+    const std::size_t n_states(state_names.size());
+    const std::size_t slot_size(roundUp(sizeof(SharedStateSlot) +
+                                        n_actuators_ * (3 * sizeof(double) +
+                                                        2 * sizeof(std::int32_t)) +
+                                        n_states * sizeof(std::int32_t)));
+    const std::size_t names_offset(roundUp(sizeof(SharedStateHeader))),
+        slots_offset(roundUp(names_offset +
+                             (n_actuators_ + n_states) * SharedStateHeader::NAME_LENGTH));
+    size_ = slots_offset + n_slots * slot_size;
+
+    fd_ = shm_open(name_.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd_ < 0) {
+      ROS_ERROR_STREAM("StateExporter::init(): Failed to open the shared memory '"
+                       << name_ << "': " << std::strerror(errno));
+      return false;
+    }
+    if (ftruncate(fd_, size_) != 0) {
+      ROS_ERROR_STREAM("StateExporter::init(): Failed to size the shared memory '"
+                       << name_ << "' to " << size_ << " bytes: " << std::strerror(errno));
+      return false;
+    }
+    void *const base(mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0));
+    if (base == MAP_FAILED) {
+      ROS_ERROR_STREAM("StateExporter::init(): Failed to map the shared memory '"
+                       << name_ << "': " << std::strerror(errno));
+      return false;
+    }
+    base_ = static_cast< std::uint8_t * >(base);
+
+    // the new segment is zero-filled, so every slot starts as never written
+    header_ = new (base_) SharedStateHeader();
+    header_->n_actuators = n_actuators_;
+    header_->n_additional_states = n_states;
+    header_->n_slots = n_slots;
+    header_->slot_size = slot_size;
+    header_->names_offset = names_offset;
+    header_->slots_offset = slots_offset;
+    header_->n_published.store(0, std::memory_order_relaxed);
+    char *names(reinterpret_cast< char * >(base_ + names_offset));
+    for (const std::string &actuator_name : actuator_names) {
+      std::strncpy(names, actuator_name.c_str(), SharedStateHeader::NAME_LENGTH - 1);
+      names += SharedStateHeader::NAME_LENGTH;
+    }
+    for (const std::string &state_name : state_names) {
+      std::strncpy(names, state_name.c_str(), SharedStateHeader::NAME_LENGTH - 1);
+      names += SharedStateHeader::NAME_LENGTH;
+    }
+    for (std::size_t i = 0; i < n_slots; ++i) {
+      new (base_ + slots_offset + i * slot_size) SharedStateSlot();
+      slotAt(i)->seq.store(0, std::memory_order_relaxed);
+    }
+    // readers check the magic last so that they never see a half-made header
+    header_->version = SharedStateHeader::VERSION;
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = SharedStateHeader::MAGIC;
+    return true;
+  }
+
+  //
+  // writing side (the thread running read cycles).
+  // call begin(), then fill the arrays, then publish().
+  //
+
+  SharedStateSlot *begin(const std::int64_t stamp_ns, const std::int64_t period_ns,
+                         const std::int64_t read_ns) {
+    const std::uint64_t cycle(header_->n_published.load(std::memory_order_relaxed));
+    SharedStateSlot *const slot(slotAt(cycle % header_->n_slots));
+    slot->seq.store(2 * cycle + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->cycle = cycle;
+    slot->stamp_ns = stamp_ns;
+    slot->period_ns = period_ns;
+    slot->read_ns = read_ns;
+    return slot;
+  }
+
+  double *positions(SharedStateSlot *const slot) const {
+    return reinterpret_cast< double * >(slot + 1);
+  }
+
+  double *velocities(SharedStateSlot *const slot) const {
+    return positions(slot) + n_actuators_;
+  }
+
+  double *efforts(SharedStateSlot *const slot) const { return velocities(slot) + n_actuators_; }
+
+  std::int32_t *healthStatuses(SharedStateSlot *const slot) const {
+    return reinterpret_cast< std::int32_t * >(efforts(slot) + n_actuators_);
+  }
+
+  std::int32_t *staleCycles(SharedStateSlot *const slot) const {
+    return healthStatuses(slot) + n_actuators_;
+  }
+
+  std::int32_t *additionalStates(SharedStateSlot *const slot) const {
+    return staleCycles(slot) + n_actuators_;
+  }
+
+  void publish(SharedStateSlot *const slot) {
+    slot->seq.store(2 * (slot->cycle + 1), std::memory_order_release);
+    header_->n_published.store(slot->cycle + 1, std::memory_order_release);
+  }
+
+private:
+  // keep slots aligned to cache lines so that they never share one
+  static std::size_t roundUp(const std::size_t size) { return (size + 63) / 64 * 64; }
+
+  SharedStateSlot *slotAt(const std::size_t i) const {
+    return reinterpret_cast< SharedStateSlot * >(base_ + header_->slots_offset +
+                                                 i * header_->slot_size);
+  }
+
+private:
+  std::string name_;
+  int fd_;
+  std::size_t size_;
+  std::uint8_t *base_;
+  SharedStateHeader *header_;
+  std::size_t n_actuators_;
+};
+
+// reads a segment exported by StateExporter from another process.
+// copy() is wait-free for the writer and retries only while the slot is being overwritten.
+class StateImporter {
+public:
+  StateImporter() : size_(0), base_(NULL), header_(NULL) {}
+
+  virtual ~StateImporter() {
+    if (base_) {
+      munmap(const_cast< std::uint8_t * >(base_), size_);
+    }
+  }
+
+  bool init(const std::string &name) {
+    const int fd(shm_open(name.c_str(), O_RDONLY, 0));
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast< off_t >(sizeof(SharedStateHeader))) {
+      close(fd);
+      return false;
+    }
+    size_ = st.st_size;
+    void *const base(mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0));
+    close(fd);
+    if (base == MAP_FAILED) {
+      return false;
+    }
+    base_ = static_cast< const std::uint8_t * >(base);
+    header_ = reinterpret_cast< const SharedStateHeader * >(base_);
+    if (header_->magic != SharedStateHeader::MAGIC) {
+      return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return header_->version == SharedStateHeader::VERSION;
+  }
+
+  const SharedStateHeader &header() const { return *header_; }
+
+  // the name of the i-th actuator, or the (i - n_actuators)-th additional state
+  const char *nameAt(const std::size_t i) const {
+    return reinterpret_cast< const char * >(base_ + header_->names_offset +
+                                            i * SharedStateHeader::NAME_LENGTH);
+  }
+
+  // copy the slot of the cycle into buffer (slot_size bytes, laid out as SharedStateHeader
+  // tells). returns false if the cycle has not been published or has been overwritten.
+  bool copy(const std::uint64_t cycle, void *const buffer) const {
+    const SharedStateSlot *const slot(reinterpret_cast< const SharedStateSlot * >(
+        base_ + header_->slots_offset + (cycle % header_->n_slots) * header_->slot_size));
+    while (true) {
+      const std::uint64_t seq(slot->seq.load(std::memory_order_acquire));
+      if (seq != 2 * (cycle + 1)) {
+        // being written now, or holding another cycle
+        if (seq == 2 * cycle + 1) {
+          continue;
+        }
+        return false;
+      }
+      std::memcpy(buffer, slot, header_->slot_size);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot->seq.load(std::memory_order_relaxed) == seq) {
+        return true;
+      }
+    }
+  }
+
+  // the latest cycle published, or false if none
+  bool latest(std::uint64_t *const cycle) const {
+    const std::uint64_t n_published(header_->n_published.load(std::memory_order_acquire));
+    if (n_published == 0) {
+      return false;
+    }
+    *cycle = n_published - 1;
+    return true;
+  }
+
+private:
+  std::size_t size_;
+  const std::uint8_t *base_;
+  const SharedStateHeader *header_;
+};
+
+typedef std::shared_ptr< StateExporter > StateExporterPtr;
+typedef std::shared_ptr< const StateExporter > StateExporterConstPtr;
+typedef std::shared_ptr< StateImporter > StateImporterPtr;
+typedef std::shared_ptr< const StateImporter > StateImporterConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_SWITCH_WRITER_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_SWITCH_WRITER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <layered_hardware_dynamixel/bus_backend.hpp>
+#include <layered_hardware_dynamixel/common_namespaces.hpp>
+#include <layered_hardware_dynamixel/dynamixel_actuator_data.hpp>
+#include <ros/console.h>
+
+namespace layered_hardware_dynamixel {
+
+// writes the mode-enable sequences & item maps of all actuators switching modes on a bus at once.
+// operating modes defer the writes on switching, then the writer sends the n-th deferred write
+// of every actuator in the n-th BulkWrite so that each actuator receives its writes in order.
+// this requires Protocol 2.0.
+class SwitchWriter {
+public:
+  SwitchWriter() : dxl_wb_(NULL) {}
+
+  virtual ~SwitchWriter() {}
+
+  bool init(BusBackend *const dxl_wb, const std::vector< DynamixelActuatorDataPtr > &data_list) {
+    dxl_wb_ = dxl_wb;
+    data_list_ = data_list;
+
+    if (dxl_wb_->getProtocolVersion() != 2.0) {
+      ROS_ERROR("SwitchWriter::init(): BulkWrite requires Protocol 2.0");
+      return false;
+    }
+    const char *log(NULL);
+    if (!dxl_wb_->initBulkWrite(&log)) {
+      ROS_ERROR_STREAM("SwitchWriter::init(): Failed to init bulk write: "
+                       << (log ? log : "No log from DynamixelWorkbench::initBulkWrite()"));
+      return false;
+    }
+    return true;
+  }
+
+  // let operating modes defer writes on switching
+  void begin() {
+    for (const DynamixelActuatorDataPtr &data : data_list_) {
+      data->defers_switch_writes = true;
+      data->switch_writes.clear();
+    }
+  }
+
+  // send deferred writes and let operating modes write immediately again
+  bool flush() {
+    std::size_t n_rounds(0);
+    for (const DynamixelActuatorDataPtr &data : data_list_) {
+      data->defers_switch_writes = false;
+      n_rounds = std::max(n_rounds, data->switch_writes.size());
+    }
+
+    bool result(true);
+    for (std::size_t round = 0; round < n_rounds; ++round) {
+      if (!writeRound(round)) {
+        result = false;
+      }
+    }
+
+    for (const DynamixelActuatorDataPtr &data : data_list_) {
+      // operating modes have assumed the writes succeed
+      if (!result && !data->switch_writes.empty()) {
+        data->forgetControlTable();
+      }
+      data->switch_writes.clear();
+    }
+    return result;
+  }
+
+private:
+  bool writeRound(const std::size_t round) {
+    // try one BulkWrite for the round
+    bool has_params(false), is_added(true);
+    for (const DynamixelActuatorDataPtr &data : data_list_) {
+      if (round >= data->switch_writes.size()) {
+        continue;
+      }
+      const StagedItem &item(data->switch_writes[round]);
+      const char *log(NULL);
+      if (!dxl_wb_->addBulkWriteParam(data->id, item.address, item.length, item.value, &log)) {
+        ROS_WARN_STREAM("SwitchWriter::writeRound(): Failed to add a bulk write param for '"
+                        << data->name << "' (id: " << static_cast< int >(data->id)
+                        << "). Falling back to individual writes: "
+                        << (log ? log : "No log from DynamixelWorkbench::addBulkWriteParam()"));
+        is_added = false;
+        break;
+      }
+      has_params = true;
+    }
+    if (is_added) {
+      if (!has_params) {
+        return true;
+      }
+      const char *log(NULL);
+      if (dxl_wb_->bulkWrite(&log)) {
+        return true;
+      }
+      ROS_WARN_STREAM("SwitchWriter::writeRound(): Failed to bulk write. "
+                      "Falling back to individual writes: "
+                      << (log ? log : "No log from DynamixelWorkbench::bulkWrite()"));
+    }
+
+    // discard params remaining in DynamixelWorkbench
+    dxl_wb_->initBulkWrite();
+
+    // fall back to individual writes
+    bool result(true);
+    for (const DynamixelActuatorDataPtr &data : data_list_) {
+      if (round >= data->switch_writes.size()) {
+        continue;
+      }
+      const StagedItem &item(data->switch_writes[round]);
+      ItemInfo info;
+      info.length = item.length;
+      std::uint8_t bytes[4];
+      info.encode(item.value, bytes);
+      const char *log(NULL);
+      if (!dxl_wb_->writeRegister(data->id, item.address, item.length, bytes, &log)) {
+        ROS_ERROR_STREAM("SwitchWriter::writeRound(): Failed to write to address "
+                         << item.address << " of '" << data->name
+                         << "' (id: " << static_cast< int >(data->id) << "): "
+                         << (log ? log : "No log from DynamixelWorkbench::writeRegister()"));
+        if (data->stats) {
+          data->stats->countError();
+        }
+        result = false;
+      }
+    }
+    return result;
+  }
+
+private:
+  BusBackend *dxl_wb_;
+  std::vector< DynamixelActuatorDataPtr > data_list_;
+};
+
+typedef std::shared_ptr< SwitchWriter > SwitchWriterPtr;
+typedef std::shared_ptr< const SwitchWriter > SwitchWriterConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
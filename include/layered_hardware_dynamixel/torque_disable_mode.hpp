@@ -17,8 +17,8 @@ public:
   virtual void starting() override { torqueOff(); }
 
   virtual void read(const ros::Time &time, const ros::Duration &period) override {
-    // read pos, vel, eff, etc
-    readAllStates();
+    // read pos, vel, eff, etc as specified by the read mask
+    readStates();
   }
 
   virtual void write(const ros::Time &time, const ros::Duration &period) override {
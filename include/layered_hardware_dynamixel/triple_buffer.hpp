@@ -0,0 +1,62 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_TRIPLE_BUFFER_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_TRIPLE_BUFFER_HPP
+
+#include <atomic>
+
+namespace layered_hardware_dynamixel {
+
+// lock-free single-producer single-consumer buffer which always gives the latest value.
+// the producer writes back() and publish()es it, then the consumer update()s and reads front().
+// neither side waits for the other.
+template < typename T > class TripleBuffer {
+public:
+  TripleBuffer() : back_(0), middle_(1), front_(2) {}
+
+  // not thread-safe. call before the producer & consumer start.
+  void reset(const T &value) {
+    for (T &buffer : buffers_) {
+      buffer = value;
+    }
+    back_ = 0;
+    middle_.store(1);
+    front_ = 2;
+  }
+
+  //
+  // producer side
+  //
+
+  T &back() { return buffers_[back_]; }
+
+  void publish() { back_ = middle_.exchange(back_ | FRESH_BIT) & INDEX_MASK; }
+
+  //
+  // consumer side
+  //
+
+  // swap to the latest published value. returns false if nothing has been published since the last.
+  bool update() {
+    if (!(middle_.load() & FRESH_BIT)) {
+      return false;
+    }
+    front_ = middle_.exchange(front_) & INDEX_MASK;
+    return true;
+  }
+
+  const T &front() const { return buffers_[front_]; }
+
+private:
+  static const int INDEX_MASK = 0x3;
+  static const int FRESH_BIT = 0x4;
+
+  T buffers_[3];
+  // index of the buffer owned by the producer
+  int back_;
+  // index of the buffer being exchanged, with the flag if it has been published
+  std::atomic< int > middle_;
+  // index of the buffer owned by the consumer
+  int front_;
+};
+} // namespace layered_hardware_dynamixel
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_WORKBENCH_BACKEND_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_WORKBENCH_BACKEND_HPP
+
+#include <cstdint>
+#include <memory>
+
+#include <dynamixel_workbench_toolbox/dynamixel_workbench.h>
+#include <layered_hardware_dynamixel/bus_backend.hpp>
+
+namespace layered_hardware_dynamixel {
+
+// the real bus on a USB serial device via DynamixelWorkbench.
+// Fast Sync Read & split SyncRead are unavailable because DynamixelWorkbench offers no access
+// to its packet handler.
+class WorkbenchBackend : public BusBackend {
+public:
+  WorkbenchBackend() {}
+
+  virtual ~WorkbenchBackend() {}
+
+  virtual bool init(const char *device_name, std::uint32_t baud_rate,
+                    const char **log = NULL) override {
+    return dxl_wb_.init(device_name, baud_rate, log);
+  }
+
+  virtual float getProtocolVersion() override { return dxl_wb_.getProtocolVersion(); }
+
+  virtual const char *getModelName(std::uint8_t id, const char **log = NULL) override {
+    return dxl_wb_.getModelName(id, log);
+  }
+
+  virtual std::uint16_t getModelNumber(std::uint8_t id, const char **log = NULL) override {
+    return dxl_wb_.getModelNumber(id, log);
+  }
+
+  virtual const ControlItem *getItemInfo(std::uint8_t id, const char *item_name,
+                                         const char **log = NULL) override {
+    return dxl_wb_.getItemInfo(id, item_name, log);
+  }
+
+  virtual const ModelInfo *getModelInfo(std::uint8_t id, const char **log = NULL) override {
+    return dxl_wb_.getModelInfo(id, log);
+  }
+
+  virtual std::int32_t convertRadian2Value(std::uint8_t id, float radian) override {
+    return dxl_wb_.convertRadian2Value(id, radian);
+  }
+
+  virtual float convertValue2Radian(std::uint8_t id, std::int32_t value) override {
+    return dxl_wb_.convertValue2Radian(id, value);
+  }
+
+  virtual std::int32_t convertVelocity2Value(std::uint8_t id, float velocity) override {
+    return dxl_wb_.convertVelocity2Value(id, velocity);
+  }
+
+  virtual float convertValue2Velocity(std::uint8_t id, std::int32_t value) override {
+    return dxl_wb_.convertValue2Velocity(id, value);
+  }
+
+  virtual std::int16_t convertCurrent2Value(std::uint8_t id, float current) override {
+    return dxl_wb_.convertCurrent2Value(id, current);
+  }
+
+  virtual float convertValue2Current(std::uint8_t id, std::int16_t value) override {
+    return dxl_wb_.convertValue2Current(id, value);
+  }
+
+  virtual bool ping(std::uint8_t id, std::uint16_t *get_model_number,
+                    const char **log = NULL) override {
+    return dxl_wb_.ping(id, get_model_number, log);
+  }
+
+  virtual bool ping(std::uint8_t id, const char **log = NULL) override {
+    return dxl_wb_.ping(id, log);
+  }
+
+  virtual bool scan(std::uint8_t *get_id, std::uint8_t *get_the_number_of_id,
+                    std::uint8_t range = 253, const char **log = NULL) override {
+    return dxl_wb_.scan(get_id, get_the_number_of_id, range, log);
+  }
+
+  virtual bool reboot(std::uint8_t id, const char **log = NULL) override {
+    return dxl_wb_.reboot(id, log);
+  }
+
+  virtual bool clearMultiTurn(std::uint8_t id, const char **log = NULL) override {
+    return dxl_wb_.clearMultiTurn(id, log);
+  }
+
+  virtual bool readRegister(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                            std::uint32_t *data, const char **log = NULL) override {
+    return dxl_wb_.readRegister(id, address, length, data, log);
+  }
+
+  virtual bool readRegister(std::uint8_t id, const char *item_name, std::int32_t *data,
+                            const char **log = NULL) override {
+    return dxl_wb_.readRegister(id, item_name, data, log);
+  }
+
+  virtual bool writeRegister(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                             std::uint8_t *data, const char **log = NULL) override {
+    return dxl_wb_.writeRegister(id, address, length, data, log);
+  }
+
+  virtual bool itemRead(std::uint8_t id, const char *item_name, std::int32_t *data,
+                        const char **log = NULL) override {
+    return dxl_wb_.itemRead(id, item_name, data, log);
+  }
+
+  virtual bool itemWrite(std::uint8_t id, const char *item_name, std::int32_t data,
+                         const char **log = NULL) override {
+    return dxl_wb_.itemWrite(id, item_name, data, log);
+  }
+
+  virtual bool torqueOn(std::uint8_t id, const char **log = NULL) override {
+    return dxl_wb_.torqueOn(id, log);
+  }
+
+  virtual bool torqueOff(std::uint8_t id, const char **log = NULL) override {
+    return dxl_wb_.torqueOff(id, log);
+  }
+
+  virtual bool setCurrentControlMode(std::uint8_t id, const char **log = NULL) override {
+    return dxl_wb_.setCurrentControlMode(id, log);
+  }
+
+  virtual bool setVelocityControlMode(std::uint8_t id, const char **log = NULL) override {
+    return dxl_wb_.setVelocityControlMode(id, log);
+  }
+
+  virtual bool setPositionControlMode(std::uint8_t id, const char **log = NULL) override {
+    return dxl_wb_.setPositionControlMode(id, log);
+  }
+
+  virtual bool setExtendedPositionControlMode(std::uint8_t id, const char **log = NULL) override {
+    return dxl_wb_.setExtendedPositionControlMode(id, log);
+  }
+
+  virtual bool setCurrentBasedPositionControlMode(std::uint8_t id,
+                                                  const char **log = NULL) override {
+    return dxl_wb_.setCurrentBasedPositionControlMode(id, log);
+  }
+
+  virtual bool setPWMControlMode(std::uint8_t id, const char **log = NULL) override {
+    return dxl_wb_.setPWMControlMode(id, log);
+  }
+
+  virtual std::uint8_t getTheNumberOfSyncWriteHandler() override {
+    return dxl_wb_.getTheNumberOfSyncWriteHandler();
+  }
+
+  virtual bool addSyncWriteHandler(std::uint16_t address, std::uint16_t length,
+                                   const char **log = NULL) override {
+    return dxl_wb_.addSyncWriteHandler(address, length, log);
+  }
+
+  virtual bool syncWrite(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                         std::int32_t *data, std::uint8_t data_num_for_each_id,
+                         const char **log = NULL) override {
+    return dxl_wb_.syncWrite(index, id, id_num, data, data_num_for_each_id, log);
+  }
+
+  virtual std::uint8_t getTheNumberOfSyncReadHandler() override {
+    return dxl_wb_.getTheNumberOfSyncReadHandler();
+  }
+
+  virtual bool addSyncReadHandler(std::uint16_t address, std::uint16_t length,
+                                  const char **log = NULL) override {
+    return dxl_wb_.addSyncReadHandler(address, length, log);
+  }
+
+  virtual bool syncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                        const char **log = NULL) override {
+    return dxl_wb_.syncRead(index, id, id_num, log);
+  }
+
+  virtual bool getSyncReadData(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                               std::uint16_t address, std::uint16_t length, std::int32_t *data,
+                               const char **log = NULL) override {
+    return dxl_wb_.getSyncReadData(index, id, id_num, address, length, data, log);
+  }
+
+  virtual bool initBulkRead(const char **log = NULL) override { return dxl_wb_.initBulkRead(log); }
+
+  virtual bool addBulkReadParam(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                                const char **log = NULL) override {
+    return dxl_wb_.addBulkReadParam(id, address, length, log);
+  }
+
+  virtual bool bulkRead(const char **log = NULL) override { return dxl_wb_.bulkRead(log); }
+
+  virtual bool getBulkReadData(std::uint8_t *id, std::uint8_t id_num, std::uint16_t *address,
+                               std::uint16_t *length, std::int32_t *data,
+                               const char **log = NULL) override {
+    return dxl_wb_.getBulkReadData(id, id_num, address, length, data, log);
+  }
+
+  virtual bool clearBulkReadParam() override { return dxl_wb_.clearBulkReadParam(); }
+
+  virtual bool initBulkWrite(const char **log = NULL) override {
+    return dxl_wb_.initBulkWrite(log);
+  }
+
+  virtual bool addBulkWriteParam(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                                 std::int32_t data, const char **log = NULL) override {
+    return dxl_wb_.addBulkWriteParam(id, address, length, data, log);
+  }
+
+  virtual bool bulkWrite(const char **log = NULL) override { return dxl_wb_.bulkWrite(log); }
+
+private:
+  DynamixelWorkbench dxl_wb_;
+};
+
+typedef std::shared_ptr< WorkbenchBackend > WorkbenchBackendPtr;
+typedef std::shared_ptr< const WorkbenchBackend > WorkbenchBackendConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
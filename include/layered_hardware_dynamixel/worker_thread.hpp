@@ -0,0 +1,85 @@
+#ifndef LAYERED_HARDWARE_DYNAMIXEL_WORKER_THREAD_HPP
+#define LAYERED_HARDWARE_DYNAMIXEL_WORKER_THREAD_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace layered_hardware_dynamixel {
+
+// thread which runs a fixed job once each time it is triggered.
+// trigger() & wait() allow the fork-join execution of jobs on multiple workers.
+class WorkerThread {
+public:
+  WorkerThread() : is_triggered_(false), is_stopping_(false) {}
+
+  virtual ~WorkerThread() { stop(); }
+
+  void start(const std::function< void() > &job) {
+    stop();
+    job_ = job;
+    is_triggered_ = is_stopping_ = false;
+    thread_ = std::thread(&WorkerThread::run, this);
+  }
+
+  // run the job once asynchronously
+  void trigger() {
+    {
+      std::lock_guard< std::mutex > lock(mutex_);
+      is_triggered_ = true;
+    }
+    cond_.notify_all();
+  }
+
+  // wait until the triggered job finishes
+  void wait() {
+    std::unique_lock< std::mutex > lock(mutex_);
+    cond_.wait(lock, [this]() { return !is_triggered_; });
+  }
+
+  void stop() {
+    if (!thread_.joinable()) {
+      return;
+    }
+    {
+      std::lock_guard< std::mutex > lock(mutex_);
+      is_stopping_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+  }
+
+private:
+  void run() {
+    std::unique_lock< std::mutex > lock(mutex_);
+    while (true) {
+      cond_.wait(lock, [this]() { return is_triggered_ || is_stopping_; });
+      if (is_stopping_) {
+        // release waiters for a job which will never run
+        is_triggered_ = false;
+        cond_.notify_all();
+        return;
+      }
+      lock.unlock();
+      job_();
+      lock.lock();
+      is_triggered_ = false;
+      cond_.notify_all();
+    }
+  }
+
+private:
+  std::function< void() > job_;
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool is_triggered_, is_stopping_;
+};
+
+typedef std::shared_ptr< WorkerThread > WorkerThreadPtr;
+typedef std::shared_ptr< const WorkerThread > WorkerThreadConstPtr;
+} // namespace layered_hardware_dynamixel
+
+#endif
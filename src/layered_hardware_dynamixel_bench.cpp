@@ -0,0 +1,238 @@
+// benchmark of read & write cycles of DynamixelActuatorLayer on a simulated bus.
+// for each I/O strategy, with & without additional states, and 1 to max_actuators actuators,
+// the layer is initialized on a fresh simulated bus and runs the given number of cycles.
+// results are printed to stdout as CSV, one line per configuration.
+//
+// usage: rosrun layered_hardware_dynamixel layered_hardware_dynamixel_bench
+//          [_cycles:=1000] [_max_actuators:=64] [_baudrate:=1000000]
+//          [_latency_timer:=0.001] [_return_delay_time:=0] [_waits:=false]
+//
+// strategies are 'individual' (a packet per item), 'group' (SyncRead & SyncWrite, or BulkRead
+// when additional states are due), 'group_fast_read' (Fast Sync Read instead of SyncRead) &
+// 'group_pipelined' (SyncRead sent at the end of write() and received in the next read()).
+// actuator counts are powers of 2.
+//
+// columns are:
+//   strategy, additional_states, actuators, cycles,
+//   read_us, write_us: mean wall time of read() & write() per cycle in microseconds.
+//                      this is the software overhead unless _waits:=true
+//   cpu_us: mean CPU time of the process per cycle in microseconds
+//   packets: mean number of transactions on the bus per cycle
+//   bus_us: mean simulated airtime & latency of the bus per cycle in microseconds
+//   cycle_us, max_hz: bus_us plus read_us & write_us, and its reciprocal. with _waits:=true,
+//                     where read_us & write_us already include the bus time, bus_us is not added
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <hardware_interface/actuator_command_interface.h>
+#include <hardware_interface/controller_info.h>
+#include <hardware_interface/robot_hw.h>
+#include <layered_hardware_dynamixel/bus_backend.hpp>
+#include <layered_hardware_dynamixel/dynamixel_actuator_layer.hpp>
+#include <layered_hardware_dynamixel/simulated_backend.hpp>
+#include <ros/console.h>
+#include <ros/duration.h>
+#include <ros/init.h>
+#include <ros/node_handle.h>
+#include <ros/param.h>
+#include <ros/time.h>
+#include <xmlrpcpp/XmlRpcValue.h>
+
+namespace hi = hardware_interface;
+namespace lhd = layered_hardware_dynamixel;
+
+// the layer which keeps simulated backends it made to count their transactions
+class BenchLayer : public lhd::DynamixelActuatorLayer {
+public:
+  lhd::SimulatedBackendPtr getBackend() const { return backend_; }
+
+protected:
+  virtual lhd::BusBackendPtr makeBackend(const ros::NodeHandle &bus_param_nh) const override {
+    const lhd::BusBackendPtr backend(lhd::DynamixelActuatorLayer::makeBackend(bus_param_nh));
+    backend_ = std::dynamic_pointer_cast< lhd::SimulatedBackend >(backend);
+    return backend;
+  }
+
+private:
+  mutable lhd::SimulatedBackendPtr backend_;
+};
+
+struct Strategy {
+  const char *name;
+  bool group_read, group_write, fast_read, pipelined_read;
+};
+
+struct Result {
+  Result() : read_time(0.), write_time(0.), cpu_time(0.), n_packets(0), bus_time(0.) {}
+
+  double read_time, write_time, cpu_time;
+  std::uint64_t n_packets;
+  double bus_time;
+};
+
+static double cpuTime() {
+  timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double wallTime() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static std::string actuatorName(const int i) {
+  std::ostringstream os;
+  os << "actuator" << i;
+  return os.str();
+}
+
+// params of the layer for the configuration under the namespace
+static void setParams(const ros::NodeHandle &nh, const Strategy &strategy,
+                      const bool has_additional_states, const int n_actuators, const int baudrate,
+                      const double latency_timer, const int return_delay_time, const bool waits) {
+  nh.setParam("baudrate", baudrate);
+  nh.setParam("simulation/latency_timer", latency_timer);
+  nh.setParam("simulation/return_delay_time", return_delay_time);
+  nh.setParam("simulation/waits", waits);
+  nh.setParam("group_read", strategy.group_read);
+  nh.setParam("group_write", strategy.group_write);
+  nh.setParam("fast_read", strategy.fast_read);
+  nh.setParam("pipelined_read", strategy.pipelined_read);
+  for (int i = 0; i < n_actuators; ++i) {
+    ros::NodeHandle ator_nh(nh, "actuators/" + actuatorName(i));
+    ator_nh.setParam("id", i + 1);
+    ator_nh.setParam("torque_constant", 1.);
+    XmlRpc::XmlRpcValue mode_map;
+    mode_map["bench"] = std::string("extended_position");
+    ator_nh.setParam("operating_mode_map", mode_map);
+    if (has_additional_states) {
+      XmlRpc::XmlRpcValue states, every;
+      every["every"] = 10;
+      states[0] = std::string("Hardware_Error_Status");
+      states[1]["Present_Temperature"] = every;
+      states[2]["Present_Input_Voltage"] = every;
+      ator_nh.setParam("additional_states", states);
+    }
+  }
+}
+
+static bool run(const ros::NodeHandle &nh, const int n_actuators, const int n_cycles,
+                Result *const result) {
+  hi::RobotHW hw;
+  BenchLayer layer;
+  if (!layer.init(&hw, nh, "")) {
+    return false;
+  }
+
+  // start the mode & move all actuators on a sinusoid so that every cycle writes commands
+  std::list< hi::ControllerInfo > start_list(1), stop_list;
+  start_list.front().name = "bench";
+  if (!layer.prepareSwitch(start_list, stop_list)) {
+    return false;
+  }
+  layer.doSwitch(start_list, stop_list);
+  hi::PositionActuatorInterface *const iface(hw.get< hi::PositionActuatorInterface >());
+  std::vector< hi::ActuatorHandle > handles;
+  for (int i = 0; i < n_actuators; ++i) {
+    handles.push_back(iface->getHandle(actuatorName(i)));
+  }
+
+  const lhd::SimulatedBackendPtr backend(layer.getBackend());
+  const std::uint64_t start_packets(backend->getTransactions());
+  const double start_bus_time(backend->getBusTime()), start_cpu_time(cpuTime());
+  const ros::Duration period(0.01);
+  ros::Time time(ros::Time::now());
+  for (int cycle = 0; cycle < n_cycles; ++cycle) {
+    time += period;
+    const double read_start(wallTime());
+    layer.read(time, period);
+    const double write_start(wallTime());
+    result->read_time += write_start - read_start;
+    for (hi::ActuatorHandle &handle : handles) {
+      handle.setCommand(std::sin(cycle * 0.01));
+    }
+    layer.write(time, period);
+    result->write_time += wallTime() - write_start;
+  }
+  result->cpu_time = cpuTime() - start_cpu_time;
+  result->n_packets = backend->getTransactions() - start_packets;
+  result->bus_time = backend->getBusTime() - start_bus_time;
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  ros::init(argc, argv, "layered_hardware_dynamixel_bench");
+  ros::NodeHandle pnh("~");
+
+  const int n_cycles(pnh.param("cycles", 1000)), max_actuators(pnh.param("max_actuators", 64)),
+      baudrate(pnh.param("baudrate", 1000000)),
+      return_delay_time(pnh.param("return_delay_time", 0));
+  const double latency_timer(pnh.param("latency_timer", 0.001));
+  const bool waits(pnh.param("waits", false));
+  if (n_cycles <= 0 || max_actuators <= 0 || max_actuators > 252) {
+    ROS_ERROR("main(): Param '~cycles' must be positive and '~max_actuators' must be in [1, 252]");
+    return 1;
+  }
+
+  // keep stdout for the results
+  if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME, ros::console::levels::Warn)) {
+    ros::console::notifyLoggerLevelsChanged();
+  }
+
+  const Strategy strategies[] = {{"individual", false, false, false, false},
+                                 {"group", true, true, false, false},
+                                 {"group_fast_read", true, true, true, false},
+                                 {"group_pipelined", true, true, false, true}};
+  // declare the controller which operating_mode_map maps to a mode, as controller_manager does.
+  // the layer resolves controller names by "<node_ns>/<controller_name>/type"
+  ros::param::set("bench/type", std::string("position_controllers/JointGroupPositionController"));
+
+  std::printf("strategy,additional_states,actuators,cycles,read_us,write_us,cpu_us,packets,"
+              "bus_us,cycle_us,max_hz\n");
+  int n_configs(0);
+  for (const Strategy &strategy : strategies) {
+    for (int has_additional_states = 0; has_additional_states < 2; ++has_additional_states) {
+      for (int n_actuators = 1; n_actuators <= max_actuators; n_actuators *= 2) {
+        // a fresh namespace for each configuration so that no params remain from others
+        std::ostringstream ns;
+        ns << "config" << n_configs++;
+        const ros::NodeHandle nh(pnh, ns.str());
+        setParams(nh, strategy, has_additional_states, n_actuators, baudrate, latency_timer,
+                  return_delay_time, waits);
+        Result result;
+        if (!run(nh, n_actuators, n_cycles, &result)) {
+          ROS_ERROR_STREAM("main(): Failed to run the configuration '"
+                           << nh.getNamespace() << "'");
+          pnh.deleteParam(ns.str());
+          ros::param::del("bench");
+          return 1;
+        }
+        pnh.deleteParam(ns.str());
+
+        const double read_us(result.read_time / n_cycles * 1e6),
+            write_us(result.write_time / n_cycles * 1e6),
+            bus_us(result.bus_time / n_cycles * 1e6),
+            cycle_us(read_us + write_us + (waits ? 0. : bus_us));
+        std::printf("%s,%d,%d,%d,%.1f,%.1f,%.1f,%.2f,%.1f,%.1f,%.1f\n", strategy.name,
+                    has_additional_states, n_actuators, n_cycles, read_us, write_us,
+                    result.cpu_time / n_cycles * 1e6,
+                    static_cast< double >(result.n_packets) / n_cycles, bus_us, cycle_us,
+                    1e6 / cycle_us);
+        std::fflush(stdout);
+      }
+    }
+  }
+  ros::param::del("bench");
+  return 0;
+}
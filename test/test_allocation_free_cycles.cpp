@@ -0,0 +1,301 @@
+// tests that read & write cycles of DynamixelActuatorLayer on simulated buses
+// allocate no memory after switching while commands keep changing
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <hardware_interface/actuator_command_interface.h>
+#include <hardware_interface/controller_info.h>
+#include <hardware_interface/robot_hw.h>
+#include <layered_hardware_dynamixel/dynamixel_actuator_layer.hpp>
+#include <layered_hardware_dynamixel/simulated_backend.hpp>
+#include <ros/duration.h>
+#include <ros/init.h>
+#include <ros/node_handle.h>
+#include <ros/param.h>
+#include <ros/time.h>
+#include <xmlrpcpp/XmlRpcValue.h>
+
+namespace hi = hardware_interface;
+namespace lhd = layered_hardware_dynamixel;
+
+// the number of allocations while counting is enabled, made on threads running cycles.
+// other threads (e.g. the error log's or ROS's) may allocate as they like.
+static std::atomic< bool > is_counting(false);
+static std::atomic< std::size_t > n_allocations(0);
+static thread_local bool is_cycle_thread(false);
+
+static void countAllocation() {
+  if (is_cycle_thread && is_counting.load(std::memory_order_relaxed)) {
+    n_allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+// interpose malloc & its family so that allocations in C code (e.g. DynamixelSDK's packets)
+// are counted as well as operator new, which calls malloc. they forward to glibc's own
+// allocator, so free() is left as is. this does not work with sanitizers replacing malloc.
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t n, std::size_t size);
+void *__libc_realloc(void *ptr, std::size_t size);
+void *__libc_memalign(std::size_t alignment, std::size_t size);
+
+void *malloc(std::size_t size) {
+  countAllocation();
+  return __libc_malloc(size);
+}
+
+void *calloc(std::size_t n, std::size_t size) {
+  countAllocation();
+  return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, std::size_t size) {
+  countAllocation();
+  return __libc_realloc(ptr, size);
+}
+
+void *memalign(std::size_t alignment, std::size_t size) {
+  countAllocation();
+  return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(std::size_t alignment, std::size_t size) {
+  countAllocation();
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, std::size_t alignment, std::size_t size) {
+  countAllocation();
+  *ptr = __libc_memalign(alignment, size);
+  return *ptr ? 0 : ENOMEM;
+}
+}
+
+// a simulated bus which marks threads sending reads & writes as ones running cycles
+// (bus workers or the I/O thread), and counts writes to show commands reach the bus
+class MarkingBackend : public lhd::SimulatedBackend {
+public:
+  MarkingBackend() : lhd::SimulatedBackend(0.001, false), n_writes_(0) {}
+
+  std::size_t getWrites() const { return n_writes_; }
+
+  virtual bool readRegister(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                            std::uint32_t *data, const char **log = NULL) override {
+    is_cycle_thread = true;
+    return lhd::SimulatedBackend::readRegister(id, address, length, data, log);
+  }
+
+  virtual bool syncRead(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                        const char **log = NULL) override {
+    is_cycle_thread = true;
+    return lhd::SimulatedBackend::syncRead(index, id, id_num, log);
+  }
+
+  virtual bool bulkRead(const char **log = NULL) override {
+    is_cycle_thread = true;
+    return lhd::SimulatedBackend::bulkRead(log);
+  }
+
+  virtual bool writeRegister(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                             std::uint8_t *data, const char **log = NULL) override {
+    is_cycle_thread = true;
+    ++n_writes_;
+    return lhd::SimulatedBackend::writeRegister(id, address, length, data, log);
+  }
+
+  virtual bool syncWrite(std::uint8_t index, std::uint8_t *id, std::uint8_t id_num,
+                         std::int32_t *data, std::uint8_t data_num_for_each_id,
+                         const char **log = NULL) override {
+    is_cycle_thread = true;
+    ++n_writes_;
+    return lhd::SimulatedBackend::syncWrite(index, id, id_num, data, data_num_for_each_id, log);
+  }
+
+private:
+  std::atomic< std::size_t > n_writes_;
+};
+
+typedef std::shared_ptr< MarkingBackend > MarkingBackendPtr;
+
+class MarkingLayer : public lhd::DynamixelActuatorLayer {
+public:
+  // the total writes on all buses
+  std::size_t getWrites() const {
+    std::size_t n_writes(0);
+    for (const MarkingBackendPtr &backend : backends_) {
+      n_writes += backend->getWrites();
+    }
+    return n_writes;
+  }
+
+protected:
+  virtual lhd::BusBackendPtr makeBackend(const ros::NodeHandle &bus_param_nh) const override {
+    backends_.push_back(std::make_shared< MarkingBackend >());
+    return backends_.back();
+  }
+
+private:
+  mutable std::vector< MarkingBackendPtr > backends_;
+};
+
+// the number of actuators on each bus, and cycles whose allocations are counted
+static const int N_ACTUATORS(4);
+static const int N_CYCLES(200);
+
+static std::string busName(const int i) {
+  std::ostringstream os;
+  os << "bus" << i;
+  return os.str();
+}
+
+static std::string actuatorName(const int i, const int j) {
+  std::ostringstream os;
+  os << busName(i) << "_actuator" << j;
+  return os.str();
+}
+
+// params of a layer on simulated buses whose actuators read additional states
+// at different intervals & phases
+static void setParams(const ros::NodeHandle &nh, const int n_buses) {
+  for (int i = 0; i < n_buses; ++i) {
+    ros::NodeHandle bus_nh(nh, "buses/" + busName(i));
+    bus_nh.setParam("baudrate", 1000000);
+    bus_nh.setParam("simulation/waits", false);
+    for (int j = 0; j < N_ACTUATORS; ++j) {
+      ros::NodeHandle ator_nh(nh, "actuators/" + actuatorName(i, j));
+      ator_nh.setParam("bus", busName(i));
+      ator_nh.setParam("id", j + 1);
+      ator_nh.setParam("torque_constant", 1.);
+      XmlRpc::XmlRpcValue mode_map;
+      mode_map["test_controller"] = std::string("extended_position");
+      ator_nh.setParam("operating_mode_map", mode_map);
+      XmlRpc::XmlRpcValue states;
+      states[0] = std::string("Hardware_Error_Status");
+      states[1]["Present_Temperature"]["every"] = 5;
+      states[2]["Present_Input_Voltage"]["every"] = 7;
+      ator_nh.setParam("additional_states", states);
+    }
+  }
+  ros::param::set("test_controller/type",
+                  std::string("position_controllers/JointGroupPositionController"));
+}
+
+// init the layer, start the controller and count allocations in the following cycles
+// while the position command of every actuator changes in each cycle.
+// cycles take a wall-clock period if waits so that the I/O thread cycles between them.
+static std::size_t countAllocations(const ros::NodeHandle &nh, const int n_buses,
+                                    const bool waits = false) {
+  hi::RobotHW hw;
+  MarkingLayer layer;
+  EXPECT_TRUE(layer.init(&hw, nh, ""));
+
+  std::list< hi::ControllerInfo > start_list(1), stop_list;
+  start_list.front().name = "test_controller";
+  EXPECT_TRUE(layer.prepareSwitch(start_list, stop_list));
+  layer.doSwitch(start_list, stop_list);
+
+  // a non-zero profile velocity not to let the mode freeze the position
+  std::vector< hi::ActuatorHandle > pos_handles;
+  hi::PositionActuatorInterface *const pos_iface(hw.get< hi::PositionActuatorInterface >());
+  hi::VelocityActuatorInterface *const vel_iface(hw.get< hi::VelocityActuatorInterface >());
+  EXPECT_TRUE(pos_iface != NULL && vel_iface != NULL);
+  if (pos_iface && vel_iface) {
+    for (int i = 0; i < n_buses; ++i) {
+      for (int j = 0; j < N_ACTUATORS; ++j) {
+        pos_handles.push_back(pos_iface->getHandle(actuatorName(i, j)));
+        vel_iface->getHandle(actuatorName(i, j)).setCommand(1.);
+      }
+    }
+  }
+
+  // this thread runs cycles of the layer, and the backends mark bus workers & the I/O thread.
+  // a few cycles before counting let buffers made on the first cycles settle.
+  is_cycle_thread = true;
+  const ros::Duration period(0.01);
+  ros::Time time(1.);
+  std::size_t n_writes(0);
+  for (int i = 0; i < 10 + N_CYCLES; ++i) {
+    if (i == 10) {
+      n_writes = layer.getWrites();
+      n_allocations = 0;
+      is_counting = true;
+    }
+    time += period;
+    layer.read(time, period);
+    // a sawtooth in [0, 0.5) rad changes raw values in every cycle
+    for (hi::ActuatorHandle &handle : pos_handles) {
+      handle.setCommand(0.01 * (i % 50));
+    }
+    layer.write(time, period);
+    if (waits) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  is_counting = false;
+  is_cycle_thread = false;
+
+  // the commands have actually been written in the counted cycles
+  EXPECT_GT(layer.getWrites(), n_writes);
+  return n_allocations;
+}
+
+TEST(AllocationFreeCycles, IndividualReadWrite) {
+  const ros::NodeHandle nh("~individual_read_write");
+  setParams(nh, 2);
+
+  EXPECT_EQ(countAllocations(nh, 2), 0u);
+
+  nh.deleteParam("");
+}
+
+TEST(AllocationFreeCycles, IndividualReadMergedWrite) {
+  const ros::NodeHandle nh("~individual_read_merged_write");
+  setParams(nh, 2);
+  nh.setParam("merge_writes", true);
+
+  EXPECT_EQ(countAllocations(nh, 2), 0u);
+
+  nh.deleteParam("");
+}
+
+TEST(AllocationFreeCycles, GroupReadWrite) {
+  const ros::NodeHandle nh("~group_read_write");
+  setParams(nh, 2);
+  nh.setParam("group_read", true);
+  nh.setParam("group_write", true);
+
+  EXPECT_EQ(countAllocations(nh, 2), 0u);
+
+  nh.deleteParam("");
+}
+
+TEST(AllocationFreeCycles, GroupReadWriteOnThread) {
+  const ros::NodeHandle nh("~group_read_write_on_thread");
+  setParams(nh, 1);
+  nh.setParam("group_read", true);
+  nh.setParam("group_write", true);
+  nh.setParam("merge_writes", true);
+  nh.setParam("io_thread/frequency", 1000.);
+  nh.setParam("budget/time", 0.0005);
+
+  EXPECT_EQ(countAllocations(nh, 1, true), 0u);
+
+  nh.deleteParam("");
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "test_allocation_free_cycles");
+  return RUN_ALL_TESTS();
+}
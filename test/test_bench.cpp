@@ -0,0 +1,79 @@
+// smoke test of layered_hardware_dynamixel_bench: runs the executable with a few cycles
+// & actuators, and checks that every configuration prints a sane CSV line
+
+#include <cstdio>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+
+#include <gtest/gtest.h>
+
+// the path to the bench, given by the build
+#ifndef BENCH_EXECUTABLE
+#error "BENCH_EXECUTABLE must be defined as the path to layered_hardware_dynamixel_bench"
+#endif
+
+static std::vector< std::string > splitLine(const std::string &line) {
+  std::vector< std::string > fields;
+  std::istringstream is(line);
+  std::string field;
+  while (std::getline(is, field, ',')) {
+    fields.push_back(field);
+  }
+  return fields;
+}
+
+TEST(Bench, PrintAllConfigurations) {
+  // the bench is a node reading private params, so it takes another name than this node
+  FILE *const pipe(popen(BENCH_EXECUTABLE " __name:=test_bench_child _cycles:=10"
+                                          " _max_actuators:=4",
+                         "r"));
+  ASSERT_TRUE(pipe != NULL);
+  std::vector< std::string > lines;
+  char buffer[256];
+  while (std::fgets(buffer, sizeof(buffer), pipe)) {
+    std::string line(buffer);
+    if (!line.empty() && line[line.size() - 1] == '\n') {
+      line.erase(line.size() - 1);
+    }
+    lines.push_back(line);
+  }
+  const int status(pclose(pipe));
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+
+  // the header & 4 strategies x with/without additional states x 1, 2 & 4 actuators
+  ASSERT_EQ(lines.size(), 1u + 4 * 2 * 3);
+  EXPECT_EQ(lines[0], "strategy,additional_states,actuators,cycles,read_us,write_us,cpu_us,"
+                      "packets,bus_us,cycle_us,max_hz");
+
+  // packets per cycle by strategy for 4 actuators without additional states
+  std::map< std::string, double > packets;
+  for (std::size_t i = 1; i < lines.size(); ++i) {
+    const std::vector< std::string > fields(splitLine(lines[i]));
+    ASSERT_EQ(fields.size(), 11u) << lines[i];
+    EXPECT_EQ(fields[3], "10") << lines[i];
+    // "nan" & "inf" fail the comparisons
+    EXPECT_GT(std::stod(fields[7]), 0.) << lines[i];
+    EXPECT_GT(std::stod(fields[8]), 0.) << lines[i];
+    EXPECT_GT(std::stod(fields[10]), 0.) << lines[i];
+    EXPECT_LT(std::stod(fields[10]), 1e6) << lines[i];
+    if (fields[1] == "0" && fields[2] == "4") {
+      packets[fields[0]] = std::stod(fields[7]);
+    }
+  }
+
+  // group instructions send fewer packets than one per item
+  ASSERT_EQ(packets.size(), 4u);
+  EXPECT_LT(packets["group"], packets["individual"]);
+  EXPECT_LT(packets["group_fast_read"], packets["individual"]);
+  EXPECT_LT(packets["group_pipelined"], packets["individual"]);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,119 @@
+// tests of CapabilityCache's round trip through the file, and of discarding malformed files
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+#include <layered_hardware_dynamixel/capability_cache.hpp>
+
+namespace lhd = layered_hardware_dynamixel;
+
+static const std::string PATH("/tmp/test_capability_cache.txt");
+
+TEST(CapabilityCache, RoundTrip) {
+  std::remove(PATH.c_str());
+
+  // a missing file is an empty cache
+  {
+    lhd::CapabilityCache cache;
+    EXPECT_TRUE(cache.load(PATH));
+
+    bool is_cached(true);
+    lhd::CapabilityCache::Capability *const with_scales(
+        cache.get("/dev/ttyUSB0", 1, 1060, 45, &is_cached));
+    ASSERT_TRUE(with_scales != NULL);
+    EXPECT_FALSE(is_cached);
+    with_scales->items["Goal_Position"] = std::make_pair(116, 4);
+    with_scales->items["Goal_PWM"] = std::make_pair(0, 0);
+    with_scales->has_scales = with_scales->uses_scales = true;
+    with_scales->scales.pos_zero_value = 2048.;
+    with_scales->scales.pos_scale_plus = 3.14159265358979 / 2048.;
+    with_scales->scales.pos_scale_minus = 3.14159265358979 / 2048.;
+    with_scales->scales.vel_scale = 0.229 * 2. * 3.14159265358979 / 60.;
+    with_scales->scales.current_scale = 2.69;
+
+    lhd::CapabilityCache::Capability *const without_scales(
+        cache.get("/dev/ttyUSB0", 2, 1020, 44, &is_cached));
+    ASSERT_TRUE(without_scales != NULL);
+    EXPECT_FALSE(is_cached);
+    without_scales->items["Goal_Position"] = std::make_pair(116, 4);
+    without_scales->has_scales = true;
+    without_scales->uses_scales = false;
+
+    EXPECT_TRUE(cache.save());
+  }
+
+  // entries come back as saved, and are no longer modified
+  {
+    lhd::CapabilityCache cache;
+    EXPECT_TRUE(cache.load(PATH));
+
+    bool is_cached(false);
+    const lhd::CapabilityCache::Capability *const with_scales(
+        cache.get("/dev/ttyUSB0", 1, 1060, 45, &is_cached));
+    ASSERT_TRUE(with_scales != NULL);
+    EXPECT_TRUE(is_cached);
+    EXPECT_FALSE(with_scales->is_modified);
+    ASSERT_EQ(with_scales->items.size(), 2u);
+    EXPECT_EQ(with_scales->items.at("Goal_Position").first, 116);
+    EXPECT_EQ(with_scales->items.at("Goal_Position").second, 4);
+    EXPECT_EQ(with_scales->items.at("Goal_PWM").second, 0);
+    EXPECT_TRUE(with_scales->has_scales);
+    EXPECT_TRUE(with_scales->uses_scales);
+    // scales are written with enough digits to be restored exactly
+    EXPECT_EQ(with_scales->scales.pos_zero_value, 2048.);
+    EXPECT_EQ(with_scales->scales.pos_scale_plus, 3.14159265358979 / 2048.);
+    EXPECT_EQ(with_scales->scales.vel_scale, 0.229 * 2. * 3.14159265358979 / 60.);
+    EXPECT_EQ(with_scales->scales.current_scale, 2.69);
+
+    const lhd::CapabilityCache::Capability *const without_scales(
+        cache.get("/dev/ttyUSB0", 2, 1020, 44, &is_cached));
+    ASSERT_TRUE(without_scales != NULL);
+    EXPECT_TRUE(is_cached);
+    EXPECT_TRUE(without_scales->has_scales);
+    EXPECT_FALSE(without_scales->uses_scales);
+
+    // another firmware of the same model is resolved again
+    cache.get("/dev/ttyUSB0", 1, 1060, 46, &is_cached);
+    EXPECT_FALSE(is_cached);
+  }
+
+  std::remove(PATH.c_str());
+}
+
+TEST(CapabilityCache, MalformedFileIsDiscarded) {
+  {
+    std::ofstream file(PATH.c_str());
+    file << "# a valid entry followed by a truncated one\n"
+         << "actuator /dev/ttyUSB0 1 1060 45\n"
+         << "item Goal_Position 116 4\n"
+         << "actuator /dev/ttyUSB0 2 1020\n";
+  }
+
+  lhd::CapabilityCache cache;
+  EXPECT_FALSE(cache.load(PATH));
+
+  // the valid entry before the malformed line is discarded as well
+  bool is_cached(true);
+  lhd::CapabilityCache::Capability *const capability(
+      cache.get("/dev/ttyUSB0", 1, 1060, 45, &is_cached));
+  ASSERT_TRUE(capability != NULL);
+  EXPECT_FALSE(is_cached);
+
+  // the resolved capability replaces the malformed file
+  capability->items["Goal_Position"] = std::make_pair(116, 4);
+  EXPECT_TRUE(cache.save());
+
+  lhd::CapabilityCache reloaded;
+  EXPECT_TRUE(reloaded.load(PATH));
+  reloaded.get("/dev/ttyUSB0", 1, 1060, 45, &is_cached);
+  EXPECT_TRUE(is_cached);
+
+  std::remove(PATH.c_str());
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,113 @@
+// tests of DiagnosingBackend's classification of failed transactions on a simulated bus
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+#include <hardware_interface_extensions/integer_interface.hpp>
+#include <layered_hardware_dynamixel/diagnosing_backend.hpp>
+#include <layered_hardware_dynamixel/simulated_backend.hpp>
+
+namespace hie = hardware_interface_extensions;
+namespace lhd = layered_hardware_dynamixel;
+
+// a simulated bus whose register reads from the given id arrive corrupted like CRC errors
+class CorruptingBackend : public lhd::SimulatedBackend {
+public:
+  CorruptingBackend(const std::uint8_t corrupt_id)
+      : lhd::SimulatedBackend(0.001, false), corrupt_id_(corrupt_id) {}
+
+  virtual bool readRegister(std::uint8_t id, std::uint16_t address, std::uint16_t length,
+                            std::uint32_t *data, const char **log = NULL) override {
+    if (id == corrupt_id_) {
+      if (log) {
+        *log = "[TxRxResult] Incorrect status packet!";
+      }
+      return false;
+    }
+    return lhd::SimulatedBackend::readRegister(id, address, length, data, log);
+  }
+
+private:
+  const std::uint8_t corrupt_id_;
+};
+
+static std::int32_t valueOf(hie::Int32StateInterface *const iface, const std::string &name) {
+  return iface->getHandle(name).getValue();
+}
+
+TEST(DiagnosingBackend, ClassifyErrors) {
+  // the actuator 1 replies, 2 never replies, and 3 replies corrupted packets
+  const std::shared_ptr< CorruptingBackend > sim(std::make_shared< CorruptingBackend >(3));
+  sim->setResponsive(2, false);
+  lhd::DiagnosingBackend backend(sim, 0.004, 0.01);
+  ASSERT_TRUE(backend.init("/dev/null", 1000000));
+
+  hie::Int32StateInterface iface;
+  backend.registerTo(&iface, "bus");
+  backend.registerTo(&iface, "replying", 1);
+  backend.registerTo(&iface, "silent", 2);
+  backend.registerTo(&iface, "noisy", 3);
+
+  std::uint32_t data;
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_TRUE(backend.readRegister(1, 132, 4, &data));
+  }
+  for (int i = 0; i < 2; ++i) {
+    const char *log(NULL);
+    EXPECT_FALSE(backend.readRegister(2, 132, 4, &data, &log));
+    // the log of the wrapped backend is passed through
+    ASSERT_TRUE(log != NULL);
+    EXPECT_EQ(std::string(log), "[TxRxResult] There is no status packet!");
+  }
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_FALSE(backend.readRegister(3, 132, 4, &data));
+  }
+  // a failure other than timeouts & corrupt packets is an error of neither kind
+  EXPECT_FALSE(backend.readRegister(1, 0xFFFF, 4, &data));
+
+  backend.summarize(NULL);
+
+  EXPECT_EQ(valueOf(&iface, "replying/diagnostics/transactions"), 9);
+  EXPECT_EQ(valueOf(&iface, "replying/diagnostics/timeouts"), 0);
+  EXPECT_EQ(valueOf(&iface, "replying/diagnostics/corrupt_packets"), 0);
+  EXPECT_EQ(valueOf(&iface, "replying/diagnostics/error_permille"), 111);
+  EXPECT_EQ(valueOf(&iface, "replying/diagnostics/error_warning"), 1);
+
+  EXPECT_EQ(valueOf(&iface, "silent/diagnostics/transactions"), 2);
+  EXPECT_EQ(valueOf(&iface, "silent/diagnostics/timeouts"), 2);
+  EXPECT_EQ(valueOf(&iface, "silent/diagnostics/corrupt_packets"), 0);
+  EXPECT_EQ(valueOf(&iface, "silent/diagnostics/error_permille"), 1000);
+
+  EXPECT_EQ(valueOf(&iface, "noisy/diagnostics/transactions"), 3);
+  EXPECT_EQ(valueOf(&iface, "noisy/diagnostics/timeouts"), 0);
+  EXPECT_EQ(valueOf(&iface, "noisy/diagnostics/corrupt_packets"), 3);
+
+  // the bus counts transactions to all actuators
+  EXPECT_EQ(valueOf(&iface, "bus/transactions"), 14);
+  EXPECT_EQ(valueOf(&iface, "bus/timeouts"), 2);
+  EXPECT_EQ(valueOf(&iface, "bus/corrupt_packets"), 3);
+  EXPECT_EQ(valueOf(&iface, "bus/error_permille"), 428);
+  EXPECT_EQ(valueOf(&iface, "bus/error_warning"), 1);
+
+  // the error rate is of transactions since the last summary while counts accumulate
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_TRUE(backend.readRegister(1, 132, 4, &data));
+  }
+  backend.summarize(NULL);
+
+  EXPECT_EQ(valueOf(&iface, "replying/diagnostics/transactions"), 19);
+  EXPECT_EQ(valueOf(&iface, "replying/diagnostics/error_permille"), 0);
+  EXPECT_EQ(valueOf(&iface, "replying/diagnostics/error_warning"), 0);
+  EXPECT_EQ(valueOf(&iface, "bus/transactions"), 24);
+  EXPECT_EQ(valueOf(&iface, "bus/timeouts"), 2);
+  EXPECT_EQ(valueOf(&iface, "bus/error_permille"), 0);
+  // the actuator without new transactions keeps the last rate
+  EXPECT_EQ(valueOf(&iface, "silent/diagnostics/error_permille"), 1000);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,176 @@
+// tests of DynamixelActuatorLayer's lifecycle on simulated & replayed buses
+
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+#include <hardware_interface/controller_info.h>
+#include <hardware_interface/robot_hw.h>
+#include <layered_hardware_dynamixel/bus_backend.hpp>
+#include <layered_hardware_dynamixel/dynamixel_actuator_layer.hpp>
+#include <layered_hardware_dynamixel/replay_backend.hpp>
+#include <layered_hardware_dynamixel/simulated_backend.hpp>
+#include <ros/duration.h>
+#include <ros/init.h>
+#include <ros/node_handle.h>
+#include <ros/param.h>
+#include <ros/time.h>
+#include <xmlrpcpp/XmlRpcValue.h>
+
+namespace hi = hardware_interface;
+namespace lhd = layered_hardware_dynamixel;
+
+// the number of actuators on each bus
+static const int N_ACTUATORS(3);
+
+// a simulated backend which counts actuators still holding their torques when destroyed.
+// actuators disable their torques on finalization, which must precede the destruction.
+class FinalizationBackend : public lhd::SimulatedBackend {
+public:
+  FinalizationBackend(int *const n_unfinalized)
+      : lhd::SimulatedBackend(0.001, false), n_unfinalized_(n_unfinalized) {}
+
+  virtual ~FinalizationBackend() {
+    for (int id = 1; id <= N_ACTUATORS; ++id) {
+      std::int32_t torque_enable(0);
+      if (lhd::SimulatedBackend::itemRead(id, "Torque_Enable", &torque_enable) &&
+          torque_enable != 0) {
+        ++*n_unfinalized_;
+      }
+    }
+  }
+
+private:
+  int *const n_unfinalized_;
+};
+
+// a replay backend which counts a log not replayed to the end when destroyed.
+// the end of a log is the finalization of actuators, which must precede the destruction.
+class FinalizationReplayBackend : public lhd::ReplayBackend {
+public:
+  FinalizationReplayBackend(const std::string &path, int *const n_unfinalized)
+      : lhd::ReplayBackend(path), n_unfinalized_(n_unfinalized) {}
+
+  virtual ~FinalizationReplayBackend() {
+    if (!isFinished()) {
+      ++*n_unfinalized_;
+    }
+  }
+
+private:
+  int *const n_unfinalized_;
+};
+
+class FinalizationLayer : public lhd::DynamixelActuatorLayer {
+public:
+  FinalizationLayer(int *const n_unfinalized) : n_unfinalized_(n_unfinalized) {}
+
+protected:
+  virtual lhd::BusBackendPtr makeBackend(const ros::NodeHandle &bus_param_nh) const override {
+    if (bus_param_nh.hasParam("replay")) {
+      return std::make_shared< FinalizationReplayBackend >(
+          param< std::string >(bus_param_nh, "replay/file", ""), n_unfinalized_);
+    }
+    return std::make_shared< FinalizationBackend >(n_unfinalized_);
+  }
+
+private:
+  int *const n_unfinalized_;
+};
+
+static std::string busName(const int i) {
+  std::ostringstream os;
+  os << "bus" << i;
+  return os.str();
+}
+
+// params of a layer with N_ACTUATORS actuators on each of the given number of buses
+static void setParams(const ros::NodeHandle &nh, const int n_buses) {
+  for (int i = 0; i < n_buses; ++i) {
+    ros::NodeHandle bus_nh(nh, "buses/" + busName(i));
+    bus_nh.setParam("baudrate", 1000000);
+    bus_nh.setParam("simulation/waits", false);
+    for (int j = 0; j < N_ACTUATORS; ++j) {
+      std::ostringstream ator_name;
+      ator_name << busName(i) << "_actuator" << j;
+      ros::NodeHandle ator_nh(nh, "actuators/" + ator_name.str());
+      ator_nh.setParam("bus", busName(i));
+      ator_nh.setParam("id", j + 1);
+      ator_nh.setParam("torque_constant", 1.);
+      XmlRpc::XmlRpcValue mode_map;
+      mode_map["test_controller"] = std::string("extended_position");
+      ator_nh.setParam("operating_mode_map", mode_map);
+    }
+  }
+  ros::param::set("test_controller/type",
+                  std::string("position_controllers/JointGroupPositionController"));
+}
+
+// init the layer, start the controller, run cycles and destroy the layer.
+// every drive is the same so that a recorded drive can be replayed.
+static void drive(const ros::NodeHandle &nh, int *const n_unfinalized) {
+  hi::RobotHW hw;
+  FinalizationLayer layer(n_unfinalized);
+  ASSERT_TRUE(layer.init(&hw, nh, ""));
+
+  std::list< hi::ControllerInfo > start_list(1), stop_list;
+  start_list.front().name = "test_controller";
+  ASSERT_TRUE(layer.prepareSwitch(start_list, stop_list));
+  layer.doSwitch(start_list, stop_list);
+  const ros::Duration period(0.01);
+  ros::Time time(1.);
+  for (int i = 0; i < 10; ++i) {
+    time += period;
+    layer.read(time, period);
+    layer.write(time, period);
+  }
+}
+
+TEST(DynamixelActuatorLayer, InitAndDestroy) {
+  const ros::NodeHandle nh("~init_and_destroy");
+  setParams(nh, 2);
+
+  int n_unfinalized(0);
+  drive(nh, &n_unfinalized);
+  // every actuator on each bus has disabled its torque through the live backend
+  EXPECT_EQ(n_unfinalized, 0);
+
+  nh.deleteParam("");
+}
+
+TEST(DynamixelActuatorLayer, InitAndDestroyReplayed) {
+  // record a drive on simulated buses
+  const ros::NodeHandle nh("~init_and_destroy_replayed");
+  const std::string prefix("/tmp/test_dynamixel_actuator_layer_");
+  setParams(nh, 2);
+  nh.setParam("record/prefix", prefix);
+  int n_unfinalized(0);
+  drive(nh, &n_unfinalized);
+  ASSERT_EQ(n_unfinalized, 0);
+
+  // replay the drive. nothing but the layer's list refers to replayed buses
+  nh.deleteParam("record");
+  for (int i = 0; i < 2; ++i) {
+    ros::NodeHandle bus_nh(nh, "buses/" + busName(i));
+    bus_nh.deleteParam("simulation");
+    bus_nh.setParam("replay/file", prefix + busName(i) + ".bus");
+  }
+  drive(nh, &n_unfinalized);
+  // the logs have been replayed up to the finalization of actuators
+  EXPECT_EQ(n_unfinalized, 0);
+
+  for (int i = 0; i < 2; ++i) {
+    std::remove((prefix + busName(i) + ".bus").c_str());
+  }
+  nh.deleteParam("");
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "test_dynamixel_actuator_layer");
+  return RUN_ALL_TESTS();
+}
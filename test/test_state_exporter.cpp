@@ -0,0 +1,186 @@
+// tests of copying states exported by StateExporter through shared memory,
+// and of detecting cycles overwritten by the writer
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <layered_hardware_dynamixel/state_exporter.hpp>
+
+namespace lhd = layered_hardware_dynamixel;
+
+static const std::string NAME("/test_state_exporter");
+
+// a slot copied by StateImporter, laid out as the header tells
+class CopiedSlot {
+public:
+  CopiedSlot(const lhd::SharedStateHeader &header)
+      : n_actuators_(header.n_actuators), buffer_(header.slot_size / sizeof(std::uint64_t)) {}
+
+  void *data() { return buffer_.data(); }
+
+  const lhd::SharedStateSlot &slot() const {
+    return *reinterpret_cast< const lhd::SharedStateSlot * >(buffer_.data());
+  }
+
+  const double *positions() const { return reinterpret_cast< const double * >(&slot() + 1); }
+
+  const double *efforts() const { return positions() + 2 * n_actuators_; }
+
+  const std::int32_t *healthStatuses() const {
+    return reinterpret_cast< const std::int32_t * >(efforts() + n_actuators_);
+  }
+
+  const std::int32_t *additionalStates() const { return healthStatuses() + 2 * n_actuators_; }
+
+private:
+  const std::size_t n_actuators_;
+  // slot sizes are multiples of cache lines, so of 8 bytes
+  std::vector< std::uint64_t > buffer_;
+};
+
+// fill the slot of the cycle with values telling the cycle
+static void publishCycle(lhd::StateExporter *const exporter, const std::uint64_t cycle,
+                         const std::size_t n_actuators, const std::size_t n_states) {
+  lhd::SharedStateSlot *const slot(exporter->begin(1000 * cycle, 1000, 10));
+  for (std::size_t i = 0; i < n_actuators; ++i) {
+    exporter->positions(slot)[i] = cycle + 0.1 * i;
+    exporter->velocities(slot)[i] = -1. * cycle;
+    exporter->efforts(slot)[i] = 0.5 * cycle;
+    exporter->healthStatuses(slot)[i] = static_cast< std::int32_t >(cycle % 3);
+    exporter->staleCycles(slot)[i] = 0;
+  }
+  for (std::size_t i = 0; i < n_states; ++i) {
+    exporter->additionalStates(slot)[i] = static_cast< std::int32_t >(cycle + i);
+  }
+  exporter->publish(slot);
+}
+
+TEST(StateExporter, CopyPublished) {
+  std::vector< std::string > actuator_names, state_names;
+  actuator_names.push_back("actuator0");
+  actuator_names.push_back("actuator1");
+  state_names.push_back("actuator1/Present_Temperature");
+  {
+    lhd::StateExporter exporter;
+    ASSERT_TRUE(exporter.init(NAME, 4, actuator_names, state_names));
+
+    lhd::StateImporter importer;
+    ASSERT_TRUE(importer.init(NAME));
+    const lhd::SharedStateHeader &header(importer.header());
+    EXPECT_EQ(header.n_actuators, 2u);
+    EXPECT_EQ(header.n_additional_states, 1u);
+    EXPECT_EQ(header.n_slots, 4u);
+    EXPECT_EQ(header.slot_size % 64, 0u);
+    EXPECT_STREQ(importer.nameAt(0), "actuator0");
+    EXPECT_STREQ(importer.nameAt(1), "actuator1");
+    EXPECT_STREQ(importer.nameAt(2), "actuator1/Present_Temperature");
+
+    // nothing to copy before the first cycle
+    std::uint64_t cycle;
+    CopiedSlot copied(header);
+    EXPECT_FALSE(importer.latest(&cycle));
+    EXPECT_FALSE(importer.copy(0, copied.data()));
+
+    publishCycle(&exporter, 0, 2, 1);
+    ASSERT_TRUE(importer.latest(&cycle));
+    EXPECT_EQ(cycle, 0u);
+    publishCycle(&exporter, 1, 2, 1);
+    ASSERT_TRUE(importer.latest(&cycle));
+    EXPECT_EQ(cycle, 1u);
+
+    ASSERT_TRUE(importer.copy(1, copied.data()));
+    EXPECT_EQ(copied.slot().cycle, 1u);
+    EXPECT_EQ(copied.slot().stamp_ns, 1000);
+    EXPECT_EQ(copied.slot().period_ns, 1000);
+    EXPECT_EQ(copied.slot().read_ns, 10);
+    EXPECT_EQ(copied.positions()[0], 1.);
+    EXPECT_EQ(copied.positions()[1], 1.1);
+    EXPECT_EQ(copied.efforts()[1], 0.5);
+    EXPECT_EQ(copied.healthStatuses()[1], 1);
+    EXPECT_EQ(copied.additionalStates()[0], 1);
+
+    // an earlier cycle stays readable until its slot is reused
+    ASSERT_TRUE(importer.copy(0, copied.data()));
+    EXPECT_EQ(copied.slot().cycle, 0u);
+    EXPECT_EQ(copied.positions()[1], 0.1);
+  }
+
+  // the segment is removed with the exporter
+  lhd::StateImporter importer;
+  EXPECT_FALSE(importer.init(NAME));
+}
+
+TEST(StateExporter, DetectOverwrite) {
+  std::vector< std::string > actuator_names(3, "actuator"), state_names;
+  lhd::StateExporter exporter;
+  ASSERT_TRUE(exporter.init(NAME, 4, actuator_names, state_names));
+  lhd::StateImporter importer;
+  ASSERT_TRUE(importer.init(NAME));
+  CopiedSlot copied(importer.header());
+
+  // the 5th cycle reuses the slot of the 1st one
+  for (std::uint64_t cycle = 0; cycle < 5; ++cycle) {
+    publishCycle(&exporter, cycle, 3, 0);
+  }
+  EXPECT_FALSE(importer.copy(0, copied.data()));
+  for (std::uint64_t cycle = 1; cycle < 5; ++cycle) {
+    ASSERT_TRUE(importer.copy(cycle, copied.data()));
+    EXPECT_EQ(copied.slot().cycle, cycle);
+  }
+
+  // the slot being written for the 6th cycle no longer holds the 2nd one
+  lhd::SharedStateSlot *const slot(exporter.begin(0, 0, 0));
+  EXPECT_FALSE(importer.copy(1, copied.data()));
+  EXPECT_TRUE(importer.copy(2, copied.data()));
+  exporter.publish(slot);
+}
+
+TEST(StateExporter, NeverCopyTorn) {
+  const std::size_t n_actuators(8);
+  const std::uint64_t n_cycles(100000);
+  std::vector< std::string > actuator_names(n_actuators, "actuator"), state_names;
+  lhd::StateExporter exporter;
+  ASSERT_TRUE(exporter.init(NAME, 2, actuator_names, state_names));
+  lhd::StateImporter importer;
+  ASSERT_TRUE(importer.init(NAME));
+
+  // the writer laps the reader on a small ring so that copies race with writes
+  std::thread writer([&exporter, n_actuators, n_cycles]() {
+    for (std::uint64_t cycle = 0; cycle < n_cycles; ++cycle) {
+      publishCycle(&exporter, cycle, n_actuators, 0);
+    }
+  });
+
+  CopiedSlot copied(importer.header());
+  std::uint64_t n_copies(0), n_torn(0), latest(0);
+  while (latest + 1 < n_cycles) {
+    if (!importer.latest(&latest) || !importer.copy(latest, copied.data())) {
+      continue;
+    }
+    ++n_copies;
+    // every value of a successful copy comes from the same cycle
+    bool is_consistent(copied.slot().cycle == latest);
+    for (std::size_t i = 0; i < n_actuators; ++i) {
+      is_consistent = is_consistent && copied.positions()[i] == latest + 0.1 * i &&
+                      copied.efforts()[i] == 0.5 * latest;
+    }
+    if (!is_consistent) {
+      ++n_torn;
+    }
+  }
+  writer.join();
+
+  EXPECT_GT(n_copies, 0u);
+  EXPECT_EQ(n_torn, 0u);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}